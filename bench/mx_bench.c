@@ -0,0 +1,502 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+// Required for `clock_gettime` in strict C99 mode
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <mathex.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Microbenchmarks of the library. Every benchmark prints a single JSON object per line:
+//
+//     {"benchmark": "lookup", "size": 1000, "iterations": 65536, "ns_per_op": 812.4, "allocs_per_op": 0.00, "items_per_op": 64, "items_per_sec": 78779173.2}
+//
+// `size` is the parameter of the benchmark (number of tokens, registered names, etc.), and `items_per_op`
+// is the number of processed units (tokens, lookups or calls) used to compute the throughput.
+// Pass a substring of benchmark names as the first argument to run only matching ones.
+
+// Minimum time spent measuring each benchmark.
+#define MIN_TIME_NS 200000000.0
+
+// Number of lookups or calls in a single expression.
+#define N_REFERENCES 64
+
+#ifdef COUNT_ALLOCATIONS
+// Linked with `--wrap` option, so that calls from the library end up here.
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+static size_t allocations = 0;
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+#endif
+
+static double now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+}
+
+// Single operation that is measured, returns false if it failed.
+typedef bool (*bench_op)(void *context);
+
+static const char *filter = NULL;
+
+// Runs the operation until it takes at least `MIN_TIME_NS` and prints the results.
+static void run(const char *name, size_t size, size_t items_per_op, bench_op op, void *context) {
+    if (filter != NULL && strstr(name, filter) == NULL) {
+        return;
+    }
+
+    // Warm up caches and lazily created structures
+    if (!op(context)) {
+        fprintf(stderr, "%s/%zu: operation failed\n", name, size);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t iterations = 1;
+    double elapsed = 0;
+    size_t allocs = 0;
+
+    while (true) {
+#ifdef COUNT_ALLOCATIONS
+        size_t start_allocs = allocations;
+#endif
+        double start = now_ns();
+
+        for (size_t i = 0; i < iterations; i++) {
+            op(context);
+        }
+
+        elapsed = now_ns() - start;
+#ifdef COUNT_ALLOCATIONS
+        allocs = allocations - start_allocs;
+#endif
+
+        if (elapsed >= MIN_TIME_NS) {
+            break;
+        }
+
+        // Aim a bit past the minimum time, but never grow more than 100 times at once
+        double factor = elapsed > 0 ? 1.2 * MIN_TIME_NS / elapsed : 100;
+        iterations = (size_t)((double)iterations * (factor < 100 ? (factor > 2 ? factor : 2) : 100));
+    }
+
+    double ns_per_op = elapsed / (double)iterations;
+
+    printf("{\"benchmark\": \"%s\", \"size\": %zu, \"iterations\": %zu, \"ns_per_op\": %.1f, ", name, size, iterations, ns_per_op);
+
+#ifdef COUNT_ALLOCATIONS
+    printf("\"allocs_per_op\": %.2f, ", (double)allocs / (double)iterations);
+#else
+    (void)allocs;
+    printf("\"allocs_per_op\": null, ");
+#endif
+
+    printf("\"items_per_op\": %zu, \"items_per_sec\": %.1f}\n", items_per_op, (double)items_per_op * 1e9 / ns_per_op);
+    fflush(stdout);
+}
+
+// Growable string used to generate expressions.
+typedef struct string_builder {
+    char *data;
+    size_t length;
+    size_t capacity;
+} string_builder;
+
+static void append(string_builder *string, const char *text) {
+    size_t length = strlen(text);
+
+    if (string->length + length + 1 > string->capacity) {
+        string->capacity = 2 * (string->length + length + 1);
+        string->data = realloc(string->data, string->capacity);
+
+        if (string->data == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memcpy(string->data + string->length, text, length + 1);
+    string->length += length;
+}
+
+// Deterministic pseudorandom numbers, so that every run measures the same inputs.
+static unsigned long next_random(unsigned long *state) {
+    *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+    return *state >> 33;
+}
+
+typedef struct expression_context {
+    mx_config *config;
+    mx_workspace *workspace;
+    mx_program *program;
+    const char *expression;
+} expression_context;
+
+static bool evaluate_ws_op(void *context) {
+    expression_context *data = context;
+    double result;
+    return mx_evaluate_ws(data->config, data->workspace, data->expression, &result) == MX_SUCCESS;
+}
+
+static bool evaluate_op(void *context) {
+    expression_context *data = context;
+    double result;
+    return mx_evaluate(data->config, data->expression, &result) == MX_SUCCESS;
+}
+
+static bool program_eval_op(void *context) {
+    expression_context *data = context;
+    double result;
+    return mx_program_eval(data->program, &result) == MX_SUCCESS;
+}
+
+static const size_t lengths[] = {10, 100, 1000, 10000, 100000};
+
+// Tokenization is measured by evaluating flat sums in a workspace, which does not allocate
+// and spends most of the time scanning the input.
+static void bench_tokenize(void) {
+    static const char *numbers[] = {"1.25", "3", "0.5e3", "42.125", "7e-2", "1000000", "0.001", "2.5E+1"};
+    static const char *names[] = {"alpha", "beta_2", "gamma", "delta_max", "epsilon", "zeta0", "eta", "theta_min"};
+    double value = 1;
+
+    mx_config *config = mx_create(MX_DEFAULT);
+    mx_workspace *workspace = mx_workspace_create();
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        mx_add_variable(config, names[i], &value);
+    }
+
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(*lengths); i++) {
+        string_builder numeric = {NULL, 0, 0};
+        string_builder identifiers = {NULL, 0, 0};
+
+        // Every operand is followed by an operator, so there are `2 * operands - 1` tokens
+        for (size_t j = 0; j < (lengths[i] + 1) / 2; j++) {
+            append(&numeric, j > 0 ? " + " : "");
+            append(&numeric, numbers[j % (sizeof(numbers) / sizeof(*numbers))]);
+            append(&identifiers, j > 0 ? " + " : "");
+            append(&identifiers, names[j % (sizeof(names) / sizeof(*names))]);
+        }
+
+        expression_context context = {config, workspace, NULL, numeric.data};
+        run("tokenize_numbers", lengths[i], lengths[i], evaluate_ws_op, &context);
+
+        context.expression = identifiers.data;
+        run("tokenize_identifiers", lengths[i], lengths[i], evaluate_ws_op, &context);
+
+        free(numeric.data);
+        free(identifiers.data);
+    }
+
+    mx_workspace_free(workspace);
+    mx_free(config);
+}
+
+// Symbol lookup is measured by evaluating sums of randomly chosen registered variables.
+static void bench_lookup(void) {
+    static const size_t sizes[] = {10, 100, 1000, 10000, 100000};
+    double value = 1;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+        mx_config *config = mx_create(MX_DEFAULT);
+        mx_workspace *workspace = mx_workspace_create();
+        string_builder expression = {NULL, 0, 0};
+        unsigned long state = sizes[i];
+        char name[32];
+
+        for (size_t j = 0; j < sizes[i]; j++) {
+            sprintf(name, "var_%zu", j);
+            mx_add_variable(config, name, &value);
+        }
+
+        for (size_t j = 0; j < N_REFERENCES; j++) {
+            sprintf(name, "%svar_%lu", j > 0 ? " + " : "", next_random(&state) % sizes[i]);
+            append(&expression, name);
+        }
+
+        expression_context context = {config, workspace, NULL, expression.data};
+        run("lookup", sizes[i], N_REFERENCES, evaluate_ws_op, &context);
+
+        mx_freeze(config);
+        run("lookup_frozen", sizes[i], N_REFERENCES, evaluate_ws_op, &context);
+
+        free(expression.data);
+        mx_workspace_free(workspace);
+        mx_free(config);
+    }
+}
+
+// End-to-end evaluation of expressions mixing every kind of token, including allocation of buffers.
+static void bench_evaluate(void) {
+    static const char *operands[] = {"x", "2.5", "(x - 1)", "y", "3", "(y / 2 + x)"};
+    static const char *operators[] = {" + ", " * ", " - ", " / "};
+    double x = 1.5, y = -0.25;
+
+    mx_config *config = mx_create(MX_DEFAULT);
+    mx_add_variable(config, "x", &x);
+    mx_add_variable(config, "y", &y);
+
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(*lengths); i++) {
+        string_builder expression = {NULL, 0, 0};
+        size_t tokens = 0;
+
+        for (size_t j = 0; tokens < lengths[i]; j++) {
+            const char *operand = operands[j % (sizeof(operands) / sizeof(*operands))];
+
+            if (j > 0) {
+                append(&expression, operators[j % (sizeof(operators) / sizeof(*operators))]);
+                tokens++;
+            }
+
+            append(&expression, operand);
+            tokens += operand[0] == '(' ? (operand[1] == 'x' ? 5 : 7) : 1;
+        }
+
+        expression_context context = {config, NULL, NULL, expression.data};
+        run("evaluate", lengths[i], tokens, evaluate_op, &context);
+
+        free(expression.data);
+    }
+
+    mx_free(config);
+}
+
+static mx_error identity(double args[], int argc, double *result, void *data) {
+    (void)data;
+    *result = argc > 0 ? args[0] : 0;
+    return MX_SUCCESS;
+}
+
+// Overhead of calling user functions from compiled expressions, with and without native code.
+static void bench_call(void) {
+    static const char *calls[] = {"f()", "f(x)", "f(x, x, x, x)"};
+    static const size_t arities[] = {0, 1, 4};
+    double x = 1;
+
+    mx_config *config = mx_create(MX_DEFAULT);
+    mx_add_variable(config, "x", &x);
+    mx_add_function(config, "f", identity, NULL);
+
+    for (size_t i = 0; i < sizeof(calls) / sizeof(*calls); i++) {
+        string_builder expression = {NULL, 0, 0};
+
+        for (size_t j = 0; j < N_REFERENCES; j++) {
+            append(&expression, j > 0 ? " + " : "");
+            append(&expression, calls[i]);
+        }
+
+        expression_context context = {config, NULL, NULL, expression.data};
+
+        if (mx_compile(config, expression.data, &context.program) != MX_SUCCESS) {
+            fprintf(stderr, "failed to compile %s\n", expression.data);
+            exit(EXIT_FAILURE);
+        }
+
+        run("call", arities[i], N_REFERENCES, program_eval_op, &context);
+
+        if (mx_program_jit(context.program) == MX_SUCCESS) {
+            run("call_jit", arities[i], N_REFERENCES, program_eval_op, &context);
+        }
+
+        mx_program_free(context.program);
+        free(expression.data);
+    }
+
+    mx_free(config);
+}
+
+static mx_error call_sin(double args[], int argc, double *result, void *data) {
+    (void)argc;
+    (void)data;
+    *result = sin(args[0]);
+    return MX_SUCCESS;
+}
+
+static mx_error call_exp(double args[], int argc, double *result, void *data) {
+    (void)argc;
+    (void)data;
+    *result = exp(args[0]);
+    return MX_SUCCESS;
+}
+
+static mx_error call_sqrt(double args[], int argc, double *result, void *data) {
+    (void)argc;
+    (void)data;
+    *result = sqrt(args[0]);
+    return MX_SUCCESS;
+}
+
+static mx_error call_max(double args[], int argc, double *result, void *data) {
+    (void)argc;
+    (void)data;
+    *result = fmax(args[0], args[1]);
+    return MX_SUCCESS;
+}
+
+typedef struct batch_context {
+    mx_program *program;
+    mx_column *columns;
+    size_t n_rows;
+    double *results;
+} batch_context;
+
+static bool program_eval_batch_op(void *context) {
+    batch_context *data = context;
+    return mx_program_eval_batch(data->program, data->columns, 1, data->n_rows, data->results) == MX_SUCCESS;
+}
+
+// Built-in functions compared to the same functions added as user functions, in batches and one value at a time.
+static void bench_builtin(void) {
+    static const char *functions[] = {"sin", "exp", "sqrt", "max"};
+    static const char *builtins[] = {"sin(x)", "exp(x)", "sqrt(x)", "max(x, 0.5)"};
+    static const char *callbacks[] = {"user_sin(x)", "user_exp(x)", "user_sqrt(x)", "user_max(x, 0.5)"};
+    enum { N_ROWS = 4096 };
+    static double values[N_ROWS], results[N_ROWS];
+    unsigned long state = 1;
+    double x = 0.5;
+
+    for (size_t i = 0; i < N_ROWS; i++) {
+        values[i] = (double)next_random(&state) / 2147483648.0 * 8;
+    }
+
+    mx_config *config = mx_create(MX_DEFAULT | MX_ENABLE_MATH);
+    mx_add_variable(config, "x", &x);
+    mx_add_function_ex(config, "user_sin", call_sin, NULL, 1, 1, MX_FUNC_PURE);
+    mx_add_function_ex(config, "user_exp", call_exp, NULL, 1, 1, MX_FUNC_PURE);
+    mx_add_function_ex(config, "user_sqrt", call_sqrt, NULL, 1, 1, MX_FUNC_PURE);
+    mx_add_function_ex(config, "user_max", call_max, NULL, 2, 2, MX_FUNC_PURE);
+
+    mx_column column = {.name = "x", .values = values};
+
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(*builtins); i++) {
+        const char *expressions[] = {builtins[i], callbacks[i]};
+        const char *kinds[] = {"builtin", "callback"};
+
+        for (size_t j = 0; j < 2; j++) {
+            batch_context context = {NULL, &column, N_ROWS, results};
+            char batch_name[64], single_name[64];
+            snprintf(batch_name, sizeof(batch_name), "%s_%s_batch", kinds[j], functions[i]);
+            snprintf(single_name, sizeof(single_name), "%s_%s", kinds[j], functions[i]);
+
+            if (mx_compile(config, expressions[j], &context.program) != MX_SUCCESS) {
+                fprintf(stderr, "failed to compile %s\n", expressions[j]);
+                exit(EXIT_FAILURE);
+            }
+
+            expression_context single = {config, NULL, context.program, expressions[j]};
+            run(batch_name, N_ROWS, N_ROWS, program_eval_batch_op, &context);
+            run(single_name, 1, 1, program_eval_op, &single);
+            mx_program_free(context.program);
+        }
+    }
+
+    mx_free(config);
+}
+
+typedef struct batch_f_context {
+    mx_program *program;
+    mx_column_f *columns;
+    size_t n_rows;
+    float *results;
+} batch_f_context;
+
+static bool program_eval_batch_f_op(void *context) {
+    batch_f_context *data = context;
+    return mx_program_eval_batch_f(data->program, data->columns, 1, data->n_rows, data->results) == MX_SUCCESS;
+}
+
+// Batch evaluation of the same expressions over columns of doubles and of floats.
+static void bench_precision(void) {
+    static const char *names[] = {"arithmetic", "rounding", "transcendental"};
+    static const char *expressions[] = {"x * 2.5 + x * x - 1 / x", "sqrt(abs(x)) + floor(x) - max(x, 0.5)", "sin(x) + exp(x / 8)"};
+    enum { N_ROWS = 4096 };
+    static double values[N_ROWS], results[N_ROWS];
+    static float values_f[N_ROWS], results_f[N_ROWS];
+    unsigned long state = 1;
+
+    for (size_t i = 0; i < N_ROWS; i++) {
+        values[i] = (double)next_random(&state) / 2147483648.0 * 8;
+        values_f[i] = (float)values[i];
+    }
+
+    mx_config *config = mx_create(MX_DEFAULT | MX_ENABLE_MATH);
+    mx_add_frame_variable(config, "x", 0);
+
+    mx_column column = {.name = "x", .values = values};
+    mx_column_f column_f = {.name = "x", .values = values_f};
+
+    for (size_t i = 0; i < sizeof(expressions) / sizeof(*expressions); i++) {
+        mx_program *program;
+        char double_name[64], float_name[64];
+        snprintf(double_name, sizeof(double_name), "batch_double_%s", names[i]);
+        snprintf(float_name, sizeof(float_name), "batch_float_%s", names[i]);
+
+        if (mx_compile(config, expressions[i], &program) != MX_SUCCESS) {
+            fprintf(stderr, "failed to compile %s\n", expressions[i]);
+            exit(EXIT_FAILURE);
+        }
+
+        batch_context context = {program, &column, N_ROWS, results};
+        batch_f_context context_f = {program, &column_f, N_ROWS, results_f};
+        run(double_name, N_ROWS, N_ROWS, program_eval_batch_op, &context);
+        run(float_name, N_ROWS, N_ROWS, program_eval_batch_f_op, &context_f);
+        mx_program_free(program);
+    }
+
+    mx_free(config);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        filter = argv[1];
+    }
+
+    bench_tokenize();
+    bench_lookup();
+    bench_evaluate();
+    bench_call();
+    bench_builtin();
+    bench_precision();
+
+    return EXIT_SUCCESS;
+}
@@ -31,6 +31,11 @@
  */
 #define MX_DEFAULT (MX_IMPLICIT_PARENS | MX_IMPLICIT_MUL | MX_SCI_NOTATION | MX_ENABLE_ADD | MX_ENABLE_SUB | MX_ENABLE_MUL | MX_ENABLE_DIV | MX_ENABLE_POS | MX_ENABLE_NEG)
 
+/**
+ * @brief All built-in functions. Functions added to the config take precedence over built-in functions with the same name.
+ */
+#define MX_ENABLE_MATH (MX_ENABLE_SIN | MX_ENABLE_COS | MX_ENABLE_EXP | MX_ENABLE_LOG | MX_ENABLE_SQRT | MX_ENABLE_ABS | MX_ENABLE_MIN | MX_ENABLE_MAX | MX_ENABLE_FLOOR | MX_ENABLE_CEIL)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -39,40 +44,163 @@ extern "C" {
  * @brief Evaluation parameters.
  */
 typedef enum mx_flag {
-    MX_NONE = 0,            // Disable all parameters.
-    MX_IMPLICIT_PARENS = 1, // Enable implicit parentheses.
-    MX_IMPLICIT_MUL = 2,    // Enable implicit multiplication.
-    MX_SCI_NOTATION = 4,    // Enable numbers in scientific notation.
-    MX_ENABLE_ADD = 8,      // Enable addition operator.
-    MX_ENABLE_SUB = 16,     // Enable substraction operator.
-    MX_ENABLE_MUL = 32,     // Enable multiplication operator.
-    MX_ENABLE_DIV = 64,     // Enable division operator.
-    MX_ENABLE_POW = 128,    // Enable exponentiation operator.
-    MX_ENABLE_MOD = 256,    // Enable modulus operator.
-    MX_ENABLE_POS = 512,    // Enable unary identity operator.
-    MX_ENABLE_NEG = 1024,   // Enable unary negation operator.
+    MX_NONE = 0,              // Disable all parameters.
+    MX_IMPLICIT_PARENS = 1,   // Enable implicit parentheses.
+    MX_IMPLICIT_MUL = 2,      // Enable implicit multiplication.
+    MX_SCI_NOTATION = 4,      // Enable numbers in scientific notation.
+    MX_ENABLE_ADD = 8,        // Enable addition operator.
+    MX_ENABLE_SUB = 16,       // Enable substraction operator.
+    MX_ENABLE_MUL = 32,       // Enable multiplication operator.
+    MX_ENABLE_DIV = 64,       // Enable division operator.
+    MX_ENABLE_POW = 128,      // Enable exponentiation operator.
+    MX_ENABLE_MOD = 256,      // Enable modulus operator.
+    MX_ENABLE_POS = 512,      // Enable unary identity operator.
+    MX_ENABLE_NEG = 1024,     // Enable unary negation operator.
+    MX_ENABLE_SIN = 2048,     // Enable built-in `sin` function.
+    MX_ENABLE_COS = 4096,     // Enable built-in `cos` function.
+    MX_ENABLE_EXP = 8192,     // Enable built-in `exp` function.
+    MX_ENABLE_LOG = 16384,    // Enable built-in `log` function (natural logarithm).
+    MX_ENABLE_SQRT = 32768,   // Enable built-in `sqrt` function.
+    MX_ENABLE_ABS = 65536,    // Enable built-in `abs` function.
+    MX_ENABLE_MIN = 131072,   // Enable built-in `min` function, taking one or more arguments.
+    MX_ENABLE_MAX = 262144,   // Enable built-in `max` function, taking one or more arguments.
+    MX_ENABLE_FLOOR = 524288, // Enable built-in `floor` function.
+    MX_ENABLE_CEIL = 1048576, // Enable built-in `ceil` function.
 } mx_flag;
 
 /**
  * @brief Error codes.
  */
 typedef enum mx_error {
-    MX_SUCCESS = 0,      // Parsed successfully.
-    MX_ERR_ILLEGAL_NAME, // Name of variable/function contains illegal characters.
-    MX_ERR_ALREADY_DEF,  // Trying to add a variable/function that already exists.
-    MX_ERR_NO_MEMORY,    // Out of memory.
-    MX_ERR_DIV_ZERO,     // Division by zero.
-    MX_ERR_SYNTAX,       // Expression syntax is invalid.
-    MX_ERR_UNDEFINED,    // Function or variable name not found.
-    MX_ERR_INVALID_ARGS, // Arguments validation failed.
-    MX_ERR_ARGS_NUM,     // Incorrect number of arguments.
+    MX_SUCCESS = 0,       // Parsed successfully.
+    MX_ERR_ILLEGAL_NAME,  // Name of variable/function contains illegal characters.
+    MX_ERR_ALREADY_DEF,   // Trying to add a variable/function that already exists.
+    MX_ERR_NO_MEMORY,     // Out of memory.
+    MX_ERR_DIV_ZERO,      // Division by zero.
+    MX_ERR_SYNTAX,        // Expression syntax is invalid.
+    MX_ERR_UNDEFINED,     // Function or variable name not found.
+    MX_ERR_INVALID_ARGS,  // Arguments validation failed.
+    MX_ERR_ARGS_NUM,      // Incorrect number of arguments.
+    MX_ERR_NOT_SUPPORTED, // Operation is not supported on this platform.
+    MX_ERR_FROZEN,        // Trying to modify a frozen config.
+    MX_ERR_IO,            // Failed to read or write a file.
+    MX_ERR_CYCLE,         // Formulas depend on each other in a cycle.
 } mx_error;
 
+/**
+ * @brief Properties of user-defined functions.
+ */
+typedef enum mx_func_flag {
+    MX_FUNC_NONE = 0,        // No guarantees about the function.
+    MX_FUNC_PURE = 1,        // Result depends only on the arguments and function has no side effects. Implies thread safety.
+    MX_FUNC_THREAD_SAFE = 2, // Function can be called by multiple threads at once.
+} mx_func_flag;
+
+/**
+ * @brief Statistics collected for the configuration.
+ */
+typedef enum mx_stats_flag {
+    MX_STATS_NONE = 0,   // Do not collect statistics.
+    MX_STATS_COUNT = 1,  // Count events of parsing and evaluation.
+    MX_STATS_TIMING = 2, // Measure CPU cycles spent in each phase. Implies counting.
+} mx_stats_flag;
+
+/**
+ * @brief Maximum number of error codes counted by `mx_stats`.
+ */
+#define MX_STATS_ERRORS 16
+
 /**
  * @brief Configuration for parsing.
  */
 typedef struct mx_config mx_config;
 
+/**
+ * @brief Expression parsed into a form that can be evaluated repeatedly.
+ */
+typedef struct mx_program mx_program;
+
+/**
+ * @brief Reusable memory for evaluation of expressions.
+ */
+typedef struct mx_workspace mx_workspace;
+
+/**
+ * @brief Configuration that can be replaced by one thread while other threads evaluate expressions with it.
+ */
+typedef struct mx_shared mx_shared;
+
+/**
+ * @brief Handle of a thread that reads configuration from `mx_shared`.
+ */
+typedef struct mx_reader mx_reader;
+
+/**
+ * @brief Cached intermediate results of a compiled expression, updated only where variables changed.
+ */
+typedef struct mx_incremental mx_incremental;
+
+/**
+ * @brief Named formulas referring to each other, recomputed in order of their dependencies.
+ */
+typedef struct mx_graph mx_graph;
+
+/**
+ * @brief Threads evaluating expressions in parallel.
+ */
+typedef struct mx_pool mx_pool;
+
+/**
+ * @brief Array of values of a variable used for batch evaluation.
+ */
+typedef struct mx_column {
+    const char *name;     // Name of the variable as NULL-terminated string.
+    const double *values; // Values of the variable, one for each row.
+} mx_column;
+
+/**
+ * @brief Array of single-precision values of a variable used for batch evaluation.
+ */
+typedef struct mx_column_f {
+    const char *name;    // Name of the variable as NULL-terminated string.
+    const float *values; // Values of the variable, one for each row.
+} mx_column_f;
+
+/**
+ * @brief File of values of a variable used for evaluation over files.
+ */
+typedef struct mx_column_file {
+    const char *name; // Name of the variable as NULL-terminated string.
+    const char *path; // Path to the file of raw little-endian `double` values, one for each row.
+} mx_column_file;
+
+/**
+ * @brief Counters of the expression cache.
+ */
+typedef struct mx_cache_stats {
+    size_t hits;      // Number of evaluations that reused compiled expression.
+    size_t misses;    // Number of evaluations that had to compile expression.
+    size_t evictions; // Number of expressions removed to make room for new ones.
+    size_t entries;   // Number of expressions currently in the cache.
+    size_t bytes;     // Memory currently taken by the cached expressions.
+} mx_cache_stats;
+
+/**
+ * @brief Counters of parsing and evaluation of expressions.
+ */
+typedef struct mx_stats {
+    size_t evaluations;              // Number of expressions evaluated by `mx_evaluate` and `mx_evaluate_ws`, including failed ones.
+    size_t compilations;             // Number of expressions compiled by `mx_compile`, including ones compiled by the cache.
+    size_t tokens;                   // Number of tokens produced by the parser.
+    size_t lookups;                  // Number of identifiers looked up in the configuration.
+    size_t probes;                   // Number of entries compared while looking up identifiers.
+    size_t allocations;              // Number of memory allocations made by the parser to grow its stacks and queues.
+    size_t calls;                    // Number of calls of user-defined functions by successfully evaluated expressions.
+    size_t errors[MX_STATS_ERRORS];  // Number of failed evaluations and compilations, indexed by error code.
+    unsigned long long parse_cycles; // CPU cycles spent parsing and compiling expressions, if timing is enabled.
+    unsigned long long eval_cycles;  // CPU cycles spent evaluating parsed expressions, if timing is enabled.
+} mx_stats;
+
 /**
  * @brief Creates empty configuration struct with given parsing parameters.
  *
@@ -84,6 +212,17 @@ typedef struct mx_config mx_config;
  */
 mx_config *mx_create(mx_flag flags);
 
+/**
+ * @brief Creates copy of configuration struct with the same parameters, variables and functions.
+ *
+ * Expression cache is not copied. This function allocates memory, so it is mandatory to free using `mx_free` after usage.
+ *
+ * @param config Configuration struct to copy.
+ *
+ * @return Returns pointer to the copy, or NULL if failed to allocate.
+ */
+mx_config *mx_clone(const mx_config *config);
+
 /**
  * @brief Inserts a variable into the configuration struct to be available for use in the expressions.
  *
@@ -95,6 +234,19 @@ mx_config *mx_create(mx_flag flags);
  */
 mx_error mx_add_variable(mx_config *config, const char *name, const double *value);
 
+/**
+ * @brief Inserts a single-precision variable into the configuration struct to be available for use in the expressions.
+ *
+ * Value is converted to double when evaluated by `mx_evaluate` or `mx_program_eval`, and read as is by `mx_program_eval_batch_f`.
+ *
+ * @param config Configuration struct to insert into.
+ * @param name Name of the variable as NULL-terminated string. (should only contain letters, digits or underscore and cannot start with a digit)
+ * @param value Pointer to value of the variable. Lifetime of a pointer is responsibility of a caller.
+ *
+ * @return Returns MX_SUCCESS, or error code if failed to insert.
+ */
+mx_error mx_add_variable_f(mx_config *config, const char *name, const float *value);
+
 /**
  * @brief Inserts a constant into the configuration struct to be available for use in the expressions.
  *
@@ -106,6 +258,19 @@ mx_error mx_add_variable(mx_config *config, const char *name, const double *valu
  */
 mx_error mx_add_constant(mx_config *config, const char *name, double value);
 
+/**
+ * @brief Inserts a variable into the configuration struct, which is read from the frame passed to `mx_program_eval_frame`.
+ *
+ * Compiled expression does not depend on location of the values, so it can be evaluated against different frames at once.
+ *
+ * @param config Configuration struct to insert into.
+ * @param name Name of the variable as NULL-terminated string. (should only contain letters, digits or underscore and cannot start with a digit)
+ * @param index Index of the value of the variable in the frame.
+ *
+ * @return Returns MX_SUCCESS, or error code if failed to insert.
+ */
+mx_error mx_add_frame_variable(mx_config *config, const char *name, size_t index);
+
 /**
  * @brief Inserts a function into the configuration struct to be available for use in the expressions.
  *
@@ -118,6 +283,73 @@ mx_error mx_add_constant(mx_config *config, const char *name, double value);
  */
 mx_error mx_add_function(mx_config *config, const char *name, mx_error (*apply)(double[], int, double *, void *), void *data);
 
+/**
+ * @brief Inserts a function accepting a limited number of arguments into the configuration struct, along with its properties.
+ *
+ * Expressions calling the function with wrong number of arguments fail to parse with MX_ERR_ARGS_NUM, so the function
+ * itself does not have to check `argc`. Calls to pure functions with constant arguments are evaluated once when
+ * expression is compiled using `mx_compile`.
+ *
+ * @param config Configuration struct to insert into.
+ * @param name Name of the function as NULL-terminated string. (should only contain letters, digits or underscore and cannot start with a digit)
+ * @param apply Function that takes the arguments, writes the result to the given address and returns MX_SUCCESS or appropriate error code.
+ * @param data Pointer to a data that would be passed to a function on each call. Used to make closures, but can be NULL if you don't need that.
+ * @param min_args Fewest number of arguments the function accepts.
+ * @param max_args Most number of arguments the function accepts, or negative number if there is no limit.
+ * @param flags Properties of the function.
+ *
+ * @return Returns MX_SUCCESS, MX_ERR_INVALID_ARGS if range of arguments is empty, or error code if failed to insert.
+ */
+mx_error mx_add_function_ex(mx_config *config, const char *name, mx_error (*apply)(double[], int, double *, void *), void *data, int min_args, int max_args, mx_func_flag flags);
+
+/**
+ * @brief Inserts a function taking and returning single-precision values into the configuration struct.
+ *
+ * Same as `mx_add_function_ex`, but arguments are converted to float when called by double-precision evaluation, and passed
+ * as is by `mx_program_eval_batch_f`.
+ *
+ * @param config Configuration struct to insert into.
+ * @param name Name of the function as NULL-terminated string. (should only contain letters, digits or underscore and cannot start with a digit)
+ * @param apply Function that takes the arguments, writes the result to the given address and returns MX_SUCCESS or appropriate error code.
+ * @param data Pointer to a data that would be passed to a function on each call. Used to make closures, but can be NULL if you don't need that.
+ * @param min_args Fewest number of arguments the function accepts.
+ * @param max_args Most number of arguments the function accepts, or negative number if there is no limit.
+ * @param flags Properties of the function.
+ *
+ * @return Returns MX_SUCCESS, MX_ERR_INVALID_ARGS if range of arguments is empty, or error code if failed to insert.
+ */
+mx_error mx_add_function_f(mx_config *config, const char *name, mx_error (*apply)(float[], int, float *, void *), void *data, int min_args, int max_args, mx_func_flag flags);
+
+/**
+ * @brief Declares properties of a function that was added using `mx_add_function`.
+ *
+ * Pure functions can be called only once for identical arguments within an expression compiled using `mx_compile`.
+ * Properties are taken into account by expressions compiled after this call.
+ *
+ * @param config Configuration struct containing the function.
+ * @param name Name of the function as NULL-terminated string.
+ * @param flags Properties of the function.
+ *
+ * @return Returns MX_SUCCESS, or error code if function was not found.
+ */
+mx_error mx_set_function_flags(mx_config *config, const char *name, mx_func_flag flags);
+
+/**
+ * @brief Declares derivative of a function that was added using `mx_add_function`, used to differentiate expressions calling it.
+ *
+ * Derivative is called with the same arguments and data as the function, and writes partial derivative of the function
+ * with respect to each of the arguments into `partials`. Expressions calling functions without derivative can be
+ * differentiated only with respect to variables that arguments of these functions do not depend on.
+ * Derivative is taken into account by expressions compiled after this call.
+ *
+ * @param config Configuration struct containing the function.
+ * @param name Name of the function as NULL-terminated string.
+ * @param derivative Function that takes the arguments, writes partial derivatives to the given array and returns MX_SUCCESS or appropriate error code.
+ *
+ * @return Returns MX_SUCCESS, or error code if function was not found.
+ */
+mx_error mx_set_function_derivative(mx_config *config, const char *name, mx_error (*derivative)(double[], int, double[], void *));
+
 /**
  * @brief Removes a variable or a function with given name that was added using `mx_add_variable`, `mx_add_constant` or `mx_add_function`.
  *
@@ -128,6 +360,67 @@ mx_error mx_add_function(mx_config *config, const char *name, mx_error (*apply)(
  */
 mx_error mx_remove(mx_config *config, const char *name);
 
+/**
+ * @brief Makes configuration struct read-only, optimizing it for lookup of variables and functions.
+ *
+ * Variables and functions are moved into a minimal perfect hash table, so finding a name in the expression takes
+ * one hash computation and one comparison. If names cannot be placed into such table, which only happens when
+ * their 64-bit hashes collide or there are more than 2^31 of them, config is still frozen but keeps its regular
+ * hash table. After this call, functions that add, remove or modify variables and functions return MX_ERR_FROZEN.
+ * Use `mx_clone` to get a modifiable copy.
+ *
+ * @param config Configuration struct to freeze.
+ *
+ * @return Returns MX_SUCCESS, or error code if failed to allocate, in which case config stays modifiable.
+ */
+mx_error mx_freeze(mx_config *config);
+
+/**
+ * @brief Enables cache of compiled expressions used by `mx_evaluate` and `mx_evaluate_ws`.
+ *
+ * Expressions evaluated repeatedly are then parsed only once. When cache is full, expressions that
+ * were not used recently are evicted. Cache is emptied whenever variables or functions of the config change.
+ * Evaluation with the cache is thread-safe as long as the config is not modified at the same time.
+ * Replaces the previous cache of the config, if any.
+ *
+ * @param config Configuration struct to enable the cache for.
+ * @param max_entries Maximum number of cached expressions. Zero disables the cache.
+ * @param max_bytes Maximum memory taken by the cached expressions.
+ *
+ * @return Returns MX_SUCCESS, or error code if failed to allocate.
+ */
+mx_error mx_enable_cache(mx_config *config, size_t max_entries, size_t max_bytes);
+
+/**
+ * @brief Writes current counters of the expression cache. All counters are zero if cache is disabled.
+ *
+ * @param config Configuration struct to get the counters of.
+ * @param stats Pointer to write the counters to.
+ */
+void mx_get_cache_stats(const mx_config *config, mx_cache_stats *stats);
+
+/**
+ * @brief Enables collection of statistics about parsing and evaluation with the configuration.
+ *
+ * Counters are updated once per call of `mx_evaluate`, `mx_evaluate_ws` or `mx_compile`, so they can
+ * be read while other threads are evaluating. Evaluation of compiled expressions is not counted.
+ * Collection has almost no overhead while disabled. Replaces previous statistics of the config, if any.
+ *
+ * @param config Configuration struct to collect statistics for.
+ * @param flags Statistics to collect. `MX_STATS_NONE` disables collection.
+ *
+ * @return Returns MX_SUCCESS, MX_ERR_NOT_SUPPORTED if timing was requested and cycle counter is not available, or MX_ERR_NO_MEMORY.
+ */
+mx_error mx_enable_stats(mx_config *config, mx_stats_flag flags);
+
+/**
+ * @brief Writes current statistics of the configuration. All counters are zero if statistics are disabled.
+ *
+ * @param config Configuration struct to get the statistics of.
+ * @param stats Pointer to write the statistics to.
+ */
+void mx_get_stats(const mx_config *config, mx_stats *stats);
+
 /**
  * @brief Takes mathematical expression and evaluates its numerical value.
  *
@@ -141,6 +434,374 @@ mx_error mx_remove(mx_config *config, const char *name);
  */
 mx_error mx_evaluate(const mx_config *config, const char *expression, double *result);
 
+/**
+ * @brief Creates empty workspace to evaluate expressions in.
+ *
+ * Workspace grows to fit the largest expression evaluated in it and keeps its capacity, so evaluation
+ * does not allocate memory once it is warmed up. Workspace cannot be used by multiple threads at once.
+ * This function allocates memory, so it is mandatory to free using `mx_workspace_free` after usage.
+ *
+ * @return Returns pointer to workspace, or NULL if failed to allocate.
+ */
+mx_workspace *mx_workspace_create(void);
+
+/**
+ * @brief Takes mathematical expression and evaluates its numerical value using memory of given workspace.
+ *
+ * Same as `mx_evaluate`, but does not allocate memory unless expression is larger than any previously evaluated in the workspace.
+ *
+ * @param config Configuration struct containing rules to evaluate by.
+ * @param workspace Workspace to evaluate in.
+ * @param expression NULL-terminated string to evaluate.
+ * @param result Pointer to write evaluation result to. Can be NULL.
+ *
+ * @return Returns MX_SUCCESS, or error code if expression contains any errors.
+ */
+mx_error mx_evaluate_ws(const mx_config *config, mx_workspace *workspace, const char *expression, double *result);
+
+/**
+ * @brief Takes mathematical expression of given length and evaluates its numerical value using memory of given workspace.
+ *
+ * Same as `mx_evaluate_ws`, but expression does not have to be NULL-terminated, so it can be evaluated right where it is stored.
+ *
+ * @param config Configuration struct containing rules to evaluate by.
+ * @param workspace Workspace to evaluate in.
+ * @param expression Characters of the expression to evaluate.
+ * @param length Number of characters in the expression.
+ * @param result Pointer to write evaluation result to. Can be NULL.
+ *
+ * @return Returns MX_SUCCESS, or error code if expression contains any errors.
+ */
+mx_error mx_evaluate_ws_n(const mx_config *config, mx_workspace *workspace, const char *expression, size_t length, double *result);
+
+/**
+ * @brief Frees workspace from memory.
+ *
+ * @param workspace Pointer to a workspace allocated using `mx_workspace_create`.
+ */
+void mx_workspace_free(mx_workspace *workspace);
+
+/**
+ * @brief Parses mathematical expression once, so that it can be evaluated many times without parsing it again.
+ *
+ * Constants and functions are resolved at the time of compilation, while values of variables are read on each evaluation.
+ * This function allocates memory, so it is mandatory to free using `mx_program_free` after usage.
+ *
+ * @param config Configuration struct containing rules to parse by.
+ * @param expression NULL-terminated string to compile.
+ * @param program Pointer to write compiled program to. Left untouched if compilation failed.
+ *
+ * @return Returns MX_SUCCESS, or error code if expression contains any errors.
+ */
+mx_error mx_compile(const mx_config *config, const char *expression, mx_program **program);
+
+/**
+ * @brief Evaluates numerical value of an expression compiled using `mx_compile`.
+ *
+ * Result of the evaluation is written into a `result` pointer. If evaluation failed, returns error code.
+ *
+ * @param program Compiled expression to evaluate.
+ * @param result Pointer to write evaluation result to. Can be NULL.
+ *
+ * @return Returns MX_SUCCESS, or error code if any of the functions failed.
+ */
+mx_error mx_program_eval(const mx_program *program, double *result);
+
+/**
+ * @brief Evaluates numerical value of an expression compiled using `mx_compile`, reading variables added using `mx_add_frame_variable` from the frame.
+ *
+ * Expressions that use frame variables can only be evaluated by this function, other evaluation functions return MX_ERR_UNDEFINED for them.
+ *
+ * @param program Compiled expression to evaluate.
+ * @param frame Array of values of frame variables, which has to contain every index used by the expression. Can be NULL if there are none.
+ * @param result Pointer to write evaluation result to. Can be NULL.
+ *
+ * @return Returns MX_SUCCESS, or error code if any of the functions failed.
+ */
+mx_error mx_program_eval_frame(const mx_program *program, const double frame[], double *result);
+
+/**
+ * @brief Evaluates numerical value of an expression compiled using `mx_compile` using memory of given workspace.
+ *
+ * Same as `mx_program_eval`, but does not allocate memory for expressions larger than any previously evaluated in the workspace.
+ *
+ * @param program Compiled expression to evaluate.
+ * @param workspace Workspace to evaluate in.
+ * @param result Pointer to write evaluation result to. Can be NULL.
+ *
+ * @return Returns MX_SUCCESS, or error code if any of the functions failed.
+ */
+mx_error mx_program_eval_ws(const mx_program *program, mx_workspace *workspace, double *result);
+
+/**
+ * @brief Evaluates an expression compiled using `mx_compile` together with its derivative with respect to a variable.
+ *
+ * Derivative is exact up to rounding, computed in forward mode during the same pass as the value of the expression.
+ * Expression has derivative zero with respect to variables it does not use.
+ *
+ * @param program Compiled expression to evaluate.
+ * @param frame Values of frame variables, same as for `mx_program_eval_frame`. Can be NULL if there are none.
+ * @param name Name of the variable to differentiate with respect to, as NULL-terminated string.
+ * @param result Pointer to write evaluation result to. Can be NULL.
+ * @param derivative Pointer to write the derivative to.
+ *
+ * @return Returns MX_SUCCESS, MX_ERR_NOT_SUPPORTED if expression calls a function without derivative on arguments
+ * that depend on the variable, or error code if any of the functions failed.
+ */
+mx_error mx_program_eval_derivative(const mx_program *program, const double frame[], const char *name, double *result, double *derivative);
+
+/**
+ * @brief Evaluates an expression compiled using `mx_compile` together with its gradient with respect to given variables.
+ *
+ * Gradient is exact up to rounding, computed in reverse mode: expression is evaluated once while recording
+ * partial derivatives of each operation, which are then accumulated backwards. Costs about as much as a few
+ * evaluations of the expression, regardless of the number of variables.
+ *
+ * @param program Compiled expression to evaluate.
+ * @param frame Values of frame variables, same as for `mx_program_eval_frame`. Can be NULL if there are none.
+ * @param names Names of the variables to differentiate with respect to, as NULL-terminated strings.
+ * @param n_names Number of variables.
+ * @param result Pointer to write evaluation result to. Can be NULL.
+ * @param gradient Array of `n_names` elements to write partial derivatives with respect to each variable to.
+ *
+ * @return Returns MX_SUCCESS, MX_ERR_NOT_SUPPORTED if expression calls a function without derivative on arguments
+ * that depend on any of the variables, or error code if any of the functions failed.
+ */
+mx_error mx_program_eval_gradient(const mx_program *program, const double frame[], const char *const names[], size_t n_names, double *result, double gradient[]);
+
+/**
+ * @brief Translates compiled expression into native machine code, which is then used by `mx_program_eval` and `mx_program_eval_ws`.
+ *
+ * Only available on x86-64 systems using System V calling convention, and only if the system allows to make memory executable.
+ * Library can be built without this feature by defining `MX_NO_JIT`. Program that failed to translate stays interpreted.
+ *
+ * @param program Compiled expression to translate.
+ *
+ * @return Returns MX_SUCCESS, MX_ERR_NOT_SUPPORTED if platform does not support it, or other error code if failed to translate.
+ */
+mx_error mx_program_jit(mx_program *program);
+
+/**
+ * @brief Evaluates an expression compiled using `mx_compile` once for each row of given columns.
+ *
+ * Each operation is applied to a whole block of rows at a time. Variables that do not have a column
+ * are read through their pointer once per call, before any row is evaluated, and have the same value
+ * in every row, even if they change during the call. Columns
+ * named after variables not used in the expression are ignored. Frame variables are read only
+ * from columns, so every one of them used by the expression has to have a column.
+ *
+ * @param program Compiled expression to evaluate.
+ * @param columns Values of the variables.
+ * @param n_columns Number of columns.
+ * @param n_rows Number of values in each column.
+ * @param results Array of `n_rows` elements to write evaluation results to.
+ *
+ * @return Returns MX_SUCCESS, or error code if any of the functions failed.
+ */
+mx_error mx_program_eval_batch(const mx_program *program, const mx_column columns[], size_t n_columns, size_t n_rows, double results[]);
+
+/**
+ * @brief Evaluates compiled expression for every row of given columns using multiple threads.
+ *
+ * Same as `mx_program_eval_batch`, but rows are split into chunks evaluated by threads of the pool,
+ * with idle threads taking chunks from busy ones. Functions not declared `MX_FUNC_THREAD_SAFE` or `MX_FUNC_PURE`
+ * are never called by multiple threads at once. Pool can be used by only one evaluation at a time,
+ * other evaluations wait for it to finish.
+ *
+ * @param program Compiled expression to evaluate.
+ * @param pool Threads to evaluate with. If NULL, pool shared by the whole process with one thread per processor is used.
+ * @param columns Values of the variables.
+ * @param n_columns Number of columns.
+ * @param n_rows Number of values in each column.
+ * @param results Array of `n_rows` elements to write evaluation results to.
+ *
+ * @return Returns MX_SUCCESS, or error code if any of the functions failed.
+ */
+mx_error mx_program_eval_parallel(const mx_program *program, mx_pool *pool, const mx_column columns[], size_t n_columns, size_t n_rows, double results[]);
+
+/**
+ * @brief Evaluates an expression compiled using `mx_compile` once for each row of given single-precision columns.
+ *
+ * Same as `mx_program_eval_batch`, but every operation is computed in single precision, processing twice as many rows
+ * per vector instruction. Constants and double-precision variables are rounded to float, and double-precision functions
+ * are called with arguments converted to double.
+ *
+ * @param program Compiled expression to evaluate.
+ * @param columns Values of the variables.
+ * @param n_columns Number of columns.
+ * @param n_rows Number of values in each column.
+ * @param results Array of `n_rows` elements to write evaluation results to.
+ *
+ * @return Returns MX_SUCCESS, or error code if any of the functions failed.
+ */
+mx_error mx_program_eval_batch_f(const mx_program *program, const mx_column_f columns[], size_t n_columns, size_t n_rows, float results[]);
+
+/**
+ * @brief Evaluates compiled expression for every row of given single-precision columns using multiple threads.
+ *
+ * Same as `mx_program_eval_parallel`, but computed in single precision like in `mx_program_eval_batch_f`.
+ *
+ * @param program Compiled expression to evaluate.
+ * @param pool Threads to evaluate with. If NULL, pool shared by the whole process with one thread per processor is used.
+ * @param columns Values of the variables.
+ * @param n_columns Number of columns.
+ * @param n_rows Number of values in each column.
+ * @param results Array of `n_rows` elements to write evaluation results to.
+ *
+ * @return Returns MX_SUCCESS, or error code if any of the functions failed.
+ */
+mx_error mx_program_eval_parallel_f(const mx_program *program, mx_pool *pool, const mx_column_f columns[], size_t n_columns, size_t n_rows, float results[]);
+
+/**
+ * @brief Evaluates compiled expression for every row of given column files and writes results to the output file.
+ *
+ * Files of variables used by the expression are memory-mapped and evaluated in windows of rows, like in
+ * `mx_program_eval_parallel`, with values read right from the mapped pages. Pages of evaluated windows are released,
+ * so files larger than memory are read sequentially. Only available on systems that support `mmap`.
+ *
+ * @param program Compiled expression to evaluate.
+ * @param pool Threads to evaluate with. If NULL, pool shared by the whole process with one thread per processor is used.
+ * @param files Column files of the variables. Every file has to contain the same number of rows.
+ * @param n_files Number of files, at least one.
+ * @param output Path to the file to write results to, in the same format as column files. Left incomplete if evaluation failed.
+ *
+ * @return Returns MX_SUCCESS, MX_ERR_IO if failed to read or write a file, MX_ERR_INVALID_ARGS if files have different
+ * number of rows, MX_ERR_NOT_SUPPORTED if platform does not support it, or error code if any of the functions failed.
+ */
+mx_error mx_program_eval_files(const mx_program *program, mx_pool *pool, const mx_column_file files[], size_t n_files, const char *output);
+
+/**
+ * @brief Frees compiled expression from memory.
+ *
+ * @param program Pointer to a program allocated using `mx_compile`.
+ */
+void mx_program_free(mx_program *program);
+
+/**
+ * @brief Creates state for incremental evaluation of an expression compiled using `mx_compile`.
+ *
+ * State records which operations of the expression depend on which variables and caches their results, so that
+ * evaluation after some of the variables changed recomputes only operations depending on them. Functions not
+ * declared `MX_FUNC_PURE` are called on every evaluation, along with everything depending on their results.
+ * This function allocates memory, so it is mandatory to free using `mx_incremental_free` after usage.
+ *
+ * @param program Compiled expression to evaluate. Has to stay valid as long as the state is used.
+ *
+ * @return Returns pointer to the state, or NULL if failed to allocate.
+ */
+mx_incremental *mx_incremental_create(const mx_program *program);
+
+/**
+ * @brief Marks a variable as changed, so that operations depending on it are recomputed by the next `mx_incremental_eval`.
+ *
+ * Variables are compared by name. Variables that the expression does not use are ignored.
+ *
+ * @param state State created using `mx_incremental_create`.
+ * @param name Name of the variable as NULL-terminated string.
+ *
+ * @return Returns MX_SUCCESS.
+ */
+mx_error mx_incremental_mark(mx_incremental *state, const char *name);
+
+/**
+ * @brief Evaluates the expression, recomputing only operations that depend on variables marked as changed since the last evaluation.
+ *
+ * First evaluation, and evaluation after a failed one, computes every operation. Values of variables that changed
+ * without being marked may or may not be taken into account.
+ *
+ * @param state State created using `mx_incremental_create`.
+ * @param frame Values of frame variables, same as for `mx_program_eval_frame`. Can be NULL if there are none.
+ * @param result Pointer to write evaluation result to. Can be NULL.
+ *
+ * @return Returns MX_SUCCESS, or error code if any of the functions failed.
+ */
+mx_error mx_incremental_eval(mx_incremental *state, const double frame[], double *result);
+
+/**
+ * @brief Frees state of incremental evaluation from memory.
+ *
+ * @param state Pointer to a state allocated using `mx_incremental_create`.
+ */
+void mx_incremental_free(mx_incremental *state);
+
+/**
+ * @brief Creates empty graph of formulas, whose names are added into the configuration struct.
+ *
+ * Formulas are added as frame variables of the config, so the config cannot use frame variables of its own.
+ * This function allocates memory, so it is mandatory to free using `mx_graph_free` after usage.
+ *
+ * @param config Configuration struct to compile formulas with. Has to stay valid as long as the graph is used.
+ *
+ * @return Returns pointer to the graph, or NULL if failed to allocate.
+ */
+mx_graph *mx_graph_create(mx_config *config);
+
+/**
+ * @brief Binds a name to an expression, which can refer to other formulas of the graph by their names.
+ *
+ * Defining a name that is already a formula of the graph replaces its expression. Expressions are compiled by
+ * the next `mx_graph_recompute`, so formulas can refer to formulas defined after them.
+ *
+ * @param graph Graph created using `mx_graph_create`.
+ * @param name Name of the formula as NULL-terminated string. (should only contain letters, digits or underscore and cannot start with a digit)
+ * @param expression Expression of the formula as NULL-terminated string.
+ *
+ * @return Returns MX_SUCCESS, or error code if failed to insert the name into the config.
+ */
+mx_error mx_graph_define(mx_graph *graph, const char *name, const char *expression);
+
+/**
+ * @brief Evaluates every formula of the graph after all formulas it refers to.
+ *
+ * Formulas are split into levels, each depending only on formulas of previous levels, and formulas of a level are
+ * evaluated in parallel. Formulas calling functions not declared `MX_FUNC_PURE` or `MX_FUNC_THREAD_SAFE` are evaluated
+ * by the calling thread. Formulas that failed, including ones in a cycle, do not stop evaluation of the rest.
+ *
+ * @param graph Graph created using `mx_graph_create`.
+ * @param pool Threads to evaluate with. If NULL, pool shared by the whole process with one thread per processor is used.
+ *
+ * @return Returns MX_SUCCESS, error code of the first formula that failed in order of evaluation,
+ * or MX_ERR_CYCLE if the only formulas that failed depend on each other in a cycle.
+ */
+mx_error mx_graph_recompute(mx_graph *graph, mx_pool *pool);
+
+/**
+ * @brief Reads value of a formula computed by the last `mx_graph_recompute`.
+ *
+ * @param graph Graph created using `mx_graph_create`.
+ * @param name Name of the formula as NULL-terminated string.
+ * @param value Pointer to write value of the formula to.
+ *
+ * @return Returns MX_SUCCESS, MX_ERR_UNDEFINED if formula was not found or not computed yet,
+ * or error code that evaluation of the formula or one of the formulas it refers to failed with.
+ */
+mx_error mx_graph_value(const mx_graph *graph, const char *name, double *value);
+
+/**
+ * @brief Removes names of formulas from the configuration struct and frees the graph from memory.
+ *
+ * @param graph Pointer to a graph allocated using `mx_graph_create`.
+ */
+void mx_graph_free(mx_graph *graph);
+
+/**
+ * @brief Creates pool of threads for parallel evaluation.
+ *
+ * This function allocates memory and starts threads, so it is mandatory to free using `mx_pool_free` after usage.
+ *
+ * @param n_threads Number of threads evaluating in parallel, including the calling thread. Zero uses one thread per processor.
+ *
+ * @return Returns pointer to the pool, or NULL if failed to allocate.
+ */
+mx_pool *mx_pool_create(size_t n_threads);
+
+/**
+ * @brief Stops threads of the pool and frees it from memory.
+ *
+ * @param pool Pointer to a pool allocated using `mx_pool_create`.
+ */
+void mx_pool_free(mx_pool *pool);
+
 /**
  * @brief Frees configuration struct and its contents from memory.
  *
@@ -150,6 +811,86 @@ mx_error mx_evaluate(const mx_config *config, const char *expression, double *re
  */
 void mx_free(mx_config *config);
 
+/**
+ * @brief Creates shared configuration that initially publishes given config.
+ *
+ * Published configs are immutable: to change variables or functions, get a copy of the latest one using
+ * `mx_shared_edit`, modify it and publish it using `mx_shared_publish`. Readers get the current config using
+ * `mx_read_begin` without taking any locks, and previous versions are freed once no reader can use them.
+ * This function allocates memory, so it is mandatory to free using `mx_shared_free` after usage.
+ *
+ * @param config Config to publish. Shared configuration takes ownership of it.
+ *
+ * @return Returns pointer to shared configuration, or NULL if failed to allocate.
+ */
+mx_shared *mx_shared_create(mx_config *config);
+
+/**
+ * @brief Creates copy of the latest published config to be modified and published.
+ *
+ * Modifications made by writers using different copies at the same time do not merge, only the last published one is kept.
+ *
+ * @param shared Shared configuration to copy the config of.
+ *
+ * @return Returns pointer to the copy, or NULL if failed to allocate.
+ */
+mx_config *mx_shared_edit(mx_shared *shared);
+
+/**
+ * @brief Atomically replaces published config, so following calls of `mx_read_begin` return the new one.
+ *
+ * Readers that got previous config keep using it until `mx_read_end`, and then it is freed.
+ *
+ * @param shared Shared configuration to publish into.
+ * @param config Config to publish. Shared configuration takes ownership of it, and it must not be modified anymore.
+ *
+ * @return Returns MX_SUCCESS, or error code if failed to allocate, in which case config stays owned by the caller.
+ */
+mx_error mx_shared_publish(mx_shared *shared, mx_config *config);
+
+/**
+ * @brief Frees shared configuration and all published configs. All readers have to be freed before.
+ *
+ * @param shared Pointer to shared configuration allocated using `mx_shared_create`.
+ */
+void mx_shared_free(mx_shared *shared);
+
+/**
+ * @brief Registers a reader of shared configuration. Each thread has to use its own reader.
+ *
+ * @param shared Shared configuration to read.
+ *
+ * @return Returns pointer to the reader, or NULL if failed to allocate.
+ */
+mx_reader *mx_reader_create(mx_shared *shared);
+
+/**
+ * @brief Returns the latest published config, that stays valid until `mx_read_end` is called.
+ *
+ * Does not take any locks or write any memory shared with other readers. Read sections cannot be nested.
+ *
+ * @param reader Reader of the thread.
+ *
+ * @return Returns published config, which must not be modified.
+ */
+const mx_config *mx_read_begin(mx_reader *reader);
+
+/**
+ * @brief Ends read section started by `mx_read_begin`. Config returned by it cannot be used anymore.
+ *
+ * @param reader Reader of the thread.
+ */
+void mx_read_end(mx_reader *reader);
+
+/**
+ * @brief Unregisters reader of shared configuration. Reader must not be in a read section.
+ *
+ * Memory of the reader is reused by readers registered later and is freed by `mx_shared_free`.
+ *
+ * @param reader Pointer to a reader allocated using `mx_reader_create`.
+ */
+void mx_reader_free(mx_reader *reader);
+
 #ifdef __cplusplus
 }
 #endif
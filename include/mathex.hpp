@@ -29,6 +29,16 @@
 #include <string>
 #include <type_traits>
 
+#if __cplusplus >= 202002L
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#endif
+
 namespace mathex {
     /**
      * @brief Evaluation parameters.
@@ -46,6 +56,16 @@ namespace mathex {
         Modulus = MX_ENABLE_MOD,                  // Enable modulus operator.
         Identity = MX_ENABLE_POS,                 // Enable unary identity operator.
         Negation = MX_ENABLE_NEG,                 // Enable unary negation operator.
+        Sine = MX_ENABLE_SIN,                     // Enable built-in `sin` function.
+        Cosine = MX_ENABLE_COS,                   // Enable built-in `cos` function.
+        Exponent = MX_ENABLE_EXP,                 // Enable built-in `exp` function.
+        Logarithm = MX_ENABLE_LOG,                // Enable built-in `log` function (natural logarithm).
+        SquareRoot = MX_ENABLE_SQRT,              // Enable built-in `sqrt` function.
+        AbsoluteValue = MX_ENABLE_ABS,            // Enable built-in `abs` function.
+        Minimum = MX_ENABLE_MIN,                  // Enable built-in `min` function, taking one or more arguments.
+        Maximum = MX_ENABLE_MAX,                  // Enable built-in `max` function, taking one or more arguments.
+        Floor = MX_ENABLE_FLOOR,                  // Enable built-in `floor` function.
+        Ceiling = MX_ENABLE_CEIL,                 // Enable built-in `ceil` function.
     };
 
     /**
@@ -53,6 +73,11 @@ namespace mathex {
      */
     constexpr Flags DefaultFlags = static_cast<Flags>(MX_DEFAULT);
 
+    /**
+     * @brief All built-in functions. Functions added to the config take precedence over built-in functions with the same name.
+     */
+    constexpr Flags MathFlags = static_cast<Flags>(MX_ENABLE_MATH);
+
     inline constexpr Flags operator+(Flags a, Flags b) {
         return static_cast<Flags>(static_cast<std::underlying_type<Flags>::type>(a) | static_cast<std::underlying_type<Flags>::type>(b));
     }
@@ -74,6 +99,29 @@ namespace mathex {
         Undefined = MX_ERR_UNDEFINED,        // Function or variable name not found.
         InvalidArgs = MX_ERR_INVALID_ARGS,   // Arguments validation failed.
         IncorrectArgsNum = MX_ERR_ARGS_NUM,  // Incorrect number of arguments.
+        NotSupported = MX_ERR_NOT_SUPPORTED, // Operation is not supported on this platform.
+        Frozen = MX_ERR_FROZEN,              // Trying to modify a frozen config.
+        IOError = MX_ERR_IO,                 // Failed to read or write a file.
+        Cycle = MX_ERR_CYCLE,                // Formulas depend on each other in a cycle.
+    };
+
+    /**
+     * @brief Properties of user-defined functions.
+     */
+    enum class FunctionFlags : std::underlying_type<mx_func_flag>::type {
+        None = MX_FUNC_NONE,              // No guarantees about the function.
+        Pure = MX_FUNC_PURE,              // Result depends only on the arguments and function has no side effects. Implies thread safety.
+        ThreadSafe = MX_FUNC_THREAD_SAFE, // Function can be called by multiple threads at once.
+    };
+
+    inline constexpr FunctionFlags operator+(FunctionFlags a, FunctionFlags b) {
+        return static_cast<FunctionFlags>(static_cast<std::underlying_type<FunctionFlags>::type>(a) | static_cast<std::underlying_type<FunctionFlags>::type>(b));
+    }
+
+    enum class StatsFlags : std::underlying_type<mx_stats_flag>::type {
+        None = MX_STATS_NONE,     // Do not collect statistics.
+        Count = MX_STATS_COUNT,   // Count events of parsing and evaluation.
+        Timing = MX_STATS_TIMING, // Measure CPU cycles spent in each phase. Implies counting.
     };
 
     /**
@@ -81,31 +129,410 @@ namespace mathex {
      */
     constexpr Error Success = Error::Success;
 
+    /**
+     * @brief Type of function or functor taking values of type `T` for adding into the config.
+     */
+    template <typename T>
+    using BasicFunction = std::function<Error(T[], int, T &)>;
+
     /**
      * @brief Type of function or functor for adding into the config.
      */
-    using Function = std::function<Error(double[], int, double &)>;
+    using Function = BasicFunction<double>;
 
-    static mx_error wrapper_function(double args[], int num_args, double *result, void *data) {
-        Function *func = reinterpret_cast<Function *>(data);
-        return static_cast<mx_error>((*func)(args, num_args, *result));
+    /**
+     * @brief Type of function or functor writing partial derivatives of a function with respect to each of the arguments.
+     * Derivatives are always computed in double precision.
+     */
+    using Derivative = std::function<Error(double[], int, double[])>;
+
+    // Function added into the config, passed as data to both of the wrappers.
+    template <typename T>
+    struct Callable {
+        BasicFunction<T> apply;
+        Derivative derivative;
+    };
+
+    template <typename T>
+    static mx_error wrapper_function(T args[], int num_args, T *result, void *data) {
+        Callable<T> *func = reinterpret_cast<Callable<T> *>(data);
+        return static_cast<mx_error>(func->apply(args, num_args, *result));
     }
 
+    template <typename T>
+    static mx_error wrapper_derivative(double args[], int num_args, double partials[], void *data) {
+        Callable<T> *func = reinterpret_cast<Callable<T> *>(data);
+        return static_cast<mx_error>(func->derivative(args, num_args, partials));
+    }
+
+    // Functions of the C library taking values of type `T`, which is either `double` or `float`.
+    template <typename T>
+    struct Precision;
+
+    template <>
+    struct Precision<double> {
+        using Column = mx_column;
+
+        static mx_error add_variable(mx_config *config, const char *name, const double *value) {
+            return mx_add_variable(config, name, value);
+        }
+
+        static mx_error add_function(mx_config *config, const char *name, Callable<double> *func, int min_args, int max_args, mx_func_flag flags) {
+            return mx_add_function_ex(config, name, wrapper_function<double>, func, min_args, max_args, flags);
+        }
+
+        static mx_error eval_batch(const mx_program *program, const Column columns[], size_t n_columns, size_t n_rows, double results[]) {
+            return mx_program_eval_batch(program, columns, n_columns, n_rows, results);
+        }
+
+        static mx_error eval_parallel(const mx_program *program, mx_pool *pool, const Column columns[], size_t n_columns, size_t n_rows, double results[]) {
+            return mx_program_eval_parallel(program, pool, columns, n_columns, n_rows, results);
+        }
+    };
+
+    template <>
+    struct Precision<float> {
+        using Column = mx_column_f;
+
+        static mx_error add_variable(mx_config *config, const char *name, const float *value) {
+            return mx_add_variable_f(config, name, value);
+        }
+
+        static mx_error add_function(mx_config *config, const char *name, Callable<float> *func, int min_args, int max_args, mx_func_flag flags) {
+            return mx_add_function_f(config, name, wrapper_function<float>, func, min_args, max_args, flags);
+        }
+
+        static mx_error eval_batch(const mx_program *program, const Column columns[], size_t n_columns, size_t n_rows, float results[]) {
+            return mx_program_eval_batch_f(program, columns, n_columns, n_rows, results);
+        }
+
+        static mx_error eval_parallel(const mx_program *program, mx_pool *pool, const Column columns[], size_t n_columns, size_t n_rows, float results[]) {
+            return mx_program_eval_parallel_f(program, pool, columns, n_columns, n_rows, results);
+        }
+    };
+
     /**
-     * @brief Configuration for parsing.
+     * @brief Array of values of type `T` of a variable used for batch evaluation.
+     */
+    template <typename T>
+    using BasicColumn = typename Precision<T>::Column;
+
+    /**
+     * @brief Array of values of a variable used for batch evaluation.
+     */
+    using Column = BasicColumn<double>;
+
+    /**
+     * @brief File of values of a variable used for evaluation over files.
+     */
+    using ColumnFile = mx_column_file;
+
+    /**
+     * @brief Counters of the expression cache.
+     */
+    using CacheStats = mx_cache_stats;
+
+    /**
+     * @brief Counters of parsing and evaluation of expressions.
+     */
+    using Stats = mx_stats;
+
+    /**
+     * @brief Reusable memory for evaluation of expressions. Cannot be used by multiple threads at once.
+     */
+    class Workspace {
+    public:
+        Workspace() {
+            this->workspace = mx_workspace_create();
+        }
+
+        Workspace(const Workspace &) = delete;
+        Workspace &operator=(const Workspace &) = delete;
+
+        ~Workspace() {
+            mx_workspace_free(this->workspace);
+        }
+
+    private:
+        template <typename>
+        friend class BasicProgram;
+        template <typename>
+        friend class BasicConfig;
+        mx_workspace *workspace;
+    };
+
+    /**
+     * @brief Threads evaluating expressions in parallel.
+     */
+    class Pool {
+    public:
+        /**
+         * @brief Starts pool of threads.
+         *
+         * @param threads Number of threads evaluating in parallel, including the calling thread. Zero uses one thread per processor.
+         */
+        Pool(size_t threads = 0) {
+            this->pool = mx_pool_create(threads);
+        }
+
+        Pool(const Pool &) = delete;
+        Pool &operator=(const Pool &) = delete;
+
+        ~Pool() {
+            mx_pool_free(this->pool);
+        }
+
+    private:
+        template <typename>
+        friend class BasicProgram;
+        friend class Graph;
+        mx_pool *pool;
+    };
+
+    /**
+     * @brief Expression parsed into a form that can be evaluated repeatedly, giving values of type `T`.
+     *
+     * Single-precision programs evaluate batches of rows entirely in single precision. Other evaluations are computed in double precision
+     * and rounded.
+     */
+    template <typename T>
+    class BasicProgram {
+    public:
+        BasicProgram() : program(nullptr) {}
+        BasicProgram(const BasicProgram &) = delete;
+        BasicProgram &operator=(const BasicProgram &) = delete;
+
+        ~BasicProgram() {
+            if (this->program != nullptr) {
+                mx_program_free(this->program);
+            }
+        }
+
+        /**
+         * @brief Evaluates numerical value of an expression compiled using `Config::compile`.
+         *
+         * Result of the evaluation is written into a `result` reference. If evaluation failed, returns error code.
+         *
+         * @param result Reference to write evaluation result to.
+         *
+         * @return Returns `mathex::Success`, or error code if any of the functions failed.
+         */
+        Error evaluate(T &result) const {
+            double value;
+            mx_error error = mx_program_eval(this->program, &value);
+
+            if (error == MX_SUCCESS) {
+                result = static_cast<T>(value);
+            }
+
+            return static_cast<Error>(error);
+        }
+
+        /**
+         * @brief Evaluates numerical value of the expression, reading frame variables from given frame.
+         *
+         * @param frame Values of variables added using `Config::addFrameVariable`.
+         * @param result Reference to write evaluation result to.
+         *
+         * @return Returns `mathex::Success`, or error code if any of the functions failed.
+         */
+        Error evaluate(const double frame[], T &result) const {
+            double value;
+            mx_error error = mx_program_eval_frame(this->program, frame, &value);
+
+            if (error == MX_SUCCESS) {
+                result = static_cast<T>(value);
+            }
+
+            return static_cast<Error>(error);
+        }
+
+        /**
+         * @brief Evaluates numerical value of the expression using memory of given workspace.
+         *
+         * @param workspace Workspace to evaluate in.
+         * @param result Reference to write evaluation result to.
+         *
+         * @return Returns `mathex::Success`, or error code if any of the functions failed.
+         */
+        Error evaluate(Workspace &workspace, T &result) const {
+            double value;
+            mx_error error = mx_program_eval_ws(this->program, workspace.workspace, &value);
+
+            if (error == MX_SUCCESS) {
+                result = static_cast<T>(value);
+            }
+
+            return static_cast<Error>(error);
+        }
+
+        /**
+         * @brief Translates the expression into native machine code, which is then used for evaluation.
+         *
+         * @return Returns `mathex::Success`, `mathex::Error::NotSupported` if platform does not support it, or other error code if failed to translate.
+         */
+        Error jit() {
+            return static_cast<Error>(mx_program_jit(this->program));
+        }
+
+        /**
+         * @brief Evaluates the expression together with its derivative with respect to a variable, computed in forward mode.
+         *
+         * @param frame Values of frame variables. Can be `nullptr` if there are none.
+         * @param name Name of the variable to differentiate with respect to.
+         * @param result Reference to write evaluation result to.
+         * @param derivative Reference to write the derivative to.
+         *
+         * @return Returns `mathex::Success`, or error code if any of the functions failed or has no derivative.
+         */
+        Error derivative(const double frame[], const std::string &name, double &result, double &derivative) const {
+            return static_cast<Error>(mx_program_eval_derivative(this->program, frame, name.c_str(), &result, &derivative));
+        }
+
+        /**
+         * @brief Evaluates the expression together with its gradient with respect to given variables, computed in reverse mode.
+         *
+         * @param frame Values of frame variables. Can be `nullptr` if there are none.
+         * @param names Names of the variables to differentiate with respect to.
+         * @param n_names Number of variables.
+         * @param result Reference to write evaluation result to.
+         * @param gradient Array of `n_names` elements to write partial derivatives to.
+         *
+         * @return Returns `mathex::Success`, or error code if any of the functions failed or has no derivative.
+         */
+        Error gradient(const double frame[], const char *const names[], size_t n_names, double &result, double gradient[]) const {
+            return static_cast<Error>(mx_program_eval_gradient(this->program, frame, names, n_names, &result, gradient));
+        }
+
+        /**
+         * @brief Evaluates the expression once for each row of given columns.
+         *
+         * Variables that do not have a column have the same value in every row.
+         *
+         * @param columns Values of the variables.
+         * @param n_columns Number of columns.
+         * @param n_rows Number of values in each column.
+         * @param results Array of `n_rows` elements to write evaluation results to.
+         *
+         * @return Returns `mathex::Success`, or error code if any of the functions failed.
+         */
+        Error evaluate(const BasicColumn<T> columns[], size_t n_columns, size_t n_rows, T results[]) const {
+            return static_cast<Error>(Precision<T>::eval_batch(this->program, columns, n_columns, n_rows, results));
+        }
+
+        /**
+         * @brief Evaluates the expression once for each row of given columns using threads of the pool.
+         *
+         * Functions not declared `FunctionFlags::ThreadSafe` or `FunctionFlags::Pure` are never called by multiple threads at once.
+         *
+         * @param pool Threads to evaluate with.
+         * @param columns Values of the variables.
+         * @param n_columns Number of columns.
+         * @param n_rows Number of values in each column.
+         * @param results Array of `n_rows` elements to write evaluation results to.
+         *
+         * @return Returns `mathex::Success`, or error code if any of the functions failed.
+         */
+        Error evaluate(Pool &pool, const BasicColumn<T> columns[], size_t n_columns, size_t n_rows, T results[]) const {
+            return static_cast<Error>(Precision<T>::eval_parallel(this->program, pool.pool, columns, n_columns, n_rows, results));
+        }
+
+        /**
+         * @brief Evaluates the expression once for each row of given column files using threads of the pool.
+         *
+         * Files are memory-mapped and read sequentially, so they can be larger than memory.
+         *
+         * @param pool Threads to evaluate with.
+         * @param files Column files of the variables, each with the same number of rows.
+         * @param n_files Number of files.
+         * @param output Path to the file to write evaluation results to.
+         *
+         * @return Returns `mathex::Success`, or error code if failed to read or write a file or any of the functions failed.
+         */
+        Error evaluate(Pool &pool, const ColumnFile files[], size_t n_files, const std::string &output) const {
+            return static_cast<Error>(mx_program_eval_files(this->program, pool.pool, files, n_files, output.c_str()));
+        }
+
+    private:
+        template <typename>
+        friend class BasicConfig;
+        friend class Incremental;
+        mx_program *program;
+    };
+
+    /**
+     * @brief Expression parsed into a form that can be evaluated repeatedly.
      */
-    class Config {
+    using Program = BasicProgram<double>;
+
+    /**
+     * @brief Cached intermediate results of a compiled expression, updated only where variables changed.
+     */
+    class Incremental {
+    public:
+        /**
+         * @brief Creates state for incremental evaluation of the program.
+         *
+         * @param program Compiled expression to evaluate. Has to outlive the state.
+         */
+        Incremental(const Program &program) {
+            this->state = mx_incremental_create(program.program);
+        }
+
+        Incremental(const Incremental &) = delete;
+        Incremental &operator=(const Incremental &) = delete;
+
+        ~Incremental() {
+            if (this->state != nullptr) {
+                mx_incremental_free(this->state);
+            }
+        }
+
+        /**
+         * @brief Marks a variable as changed, so that operations depending on it are recomputed by the next evaluation.
+         *
+         * @param name Name of the variable.
+         *
+         * @return Returns `mathex::Success`.
+         */
+        Error mark(const std::string &name) {
+            return static_cast<Error>(mx_incremental_mark(this->state, name.c_str()));
+        }
+
+        /**
+         * @brief Evaluates the expression, recomputing only operations that depend on variables marked as changed.
+         *
+         * @param frame Values of frame variables. Can be `nullptr` if there are none.
+         * @param result Reference to write evaluation result to.
+         *
+         * @return Returns `mathex::Success`, or error code if any of the functions failed.
+         */
+        Error evaluate(const double frame[], double &result) {
+            return static_cast<Error>(mx_incremental_eval(this->state, frame, &result));
+        }
+
+    private:
+        mx_incremental *state;
+    };
+
+    /**
+     * @brief Configuration for parsing, with variables and functions taking values of type `T`, which is either `double` or `float`.
+     */
+    template <typename T>
+    class BasicConfig {
+        static_assert(std::is_same<T, double>::value || std::is_same<T, float>::value, "Values have to be double or float");
+
     public:
         /**
          * @brief Creates empty configuration object with given parsing parameters.
          *
          * @param flags Evaluation flags.
          */
-        Config(Flags flags = DefaultFlags) {
+        BasicConfig(Flags flags = DefaultFlags) {
             this->config = mx_create(static_cast<mx_flag>(flags));
         }
 
-        ~Config() {
+        ~BasicConfig() {
             mx_free(this->config);
         }
 
@@ -117,8 +544,20 @@ namespace mathex {
          *
          * @return Returns `mathex::Success`, or error code if failed to insert.
          */
-        Error addVariable(const std::string &name, const double &value) {
-            return static_cast<Error>(mx_add_variable(this->config, name.c_str(), &value));
+        Error addVariable(const std::string &name, const T &value) {
+            return static_cast<Error>(Precision<T>::add_variable(this->config, name.c_str(), &value));
+        }
+
+        /**
+         * @brief Inserts a variable into the configuration object, which is read from the frame passed to `Program::evaluate`.
+         *
+         * @param name Name of the variable. (should only contain letters, digits or underscore and cannot start with a digit)
+         * @param index Index of the value of the variable in the frame.
+         *
+         * @return Returns `mathex::Success`, or error code if failed to insert.
+         */
+        Error addFrameVariable(const std::string &name, size_t index) {
+            return static_cast<Error>(mx_add_frame_variable(this->config, name.c_str(), index));
         }
 
         /**
@@ -129,7 +568,7 @@ namespace mathex {
          *
          * @return Returns `mathex::Success`, or error code if failed to insert.
          */
-        Error addConstant(const std::string &name, double value) {
+        Error addConstant(const std::string &name, T value) {
             return static_cast<Error>(mx_add_constant(this->config, name.c_str(), value));
         }
 
@@ -141,9 +580,62 @@ namespace mathex {
          *
          * @return Returns `mathex::Success`, or error code if failed to insert.
          */
-        Error addFunction(const std::string &name, Function apply) {
-            this->functions[name] = apply;
-            return static_cast<Error>(mx_add_function(this->config, name.c_str(), wrapper_function, &this->functions[name]));
+        Error addFunction(const std::string &name, BasicFunction<T> apply) {
+            return this->addFunction(name, apply, 0, -1);
+        }
+
+        /**
+         * @brief Inserts a function accepting a limited number of arguments into the configuration object, along with its properties.
+         *
+         * Expressions calling the function with wrong number of arguments fail to parse with `mathex::Error::IncorrectArgsNum`.
+         *
+         * @param name Name of the function. (should only contain letters, digits or underscore and cannot start with a digit)
+         * @param apply Function that takes the arguments, writes the result to the given reference and returns `mathex::Success` or appropriate error code.
+         * @param minArgs Fewest number of arguments the function accepts.
+         * @param maxArgs Most number of arguments the function accepts, or negative number if there is no limit.
+         * @param flags Properties of the function.
+         *
+         * @return Returns `mathex::Success`, or error code if failed to insert.
+         */
+        Error addFunction(const std::string &name, BasicFunction<T> apply, int minArgs, int maxArgs, FunctionFlags flags = FunctionFlags::None) {
+            this->functions[name] = Callable<T>{apply, nullptr};
+            return static_cast<Error>(Precision<T>::add_function(this->config, name.c_str(), &this->functions[name], minArgs, maxArgs, static_cast<mx_func_flag>(flags)));
+        }
+
+        /**
+         * @brief Declares properties of a function that was added using `addFunction`.
+         *
+         * @param name Name of the function.
+         * @param flags Properties of the function.
+         *
+         * @return Returns `mathex::Success`, or error code if function was not found.
+         */
+        Error setFunctionFlags(const std::string &name, FunctionFlags flags) {
+            return static_cast<Error>(mx_set_function_flags(this->config, name.c_str(), static_cast<mx_func_flag>(flags)));
+        }
+
+        /**
+         * @brief Declares derivative of a function that was added using `addFunction`, used to differentiate expressions calling it.
+         *
+         * @param name Name of the function.
+         * @param derivative Function that takes the same arguments, writes partial derivatives to the given array and returns `mathex::Success` or appropriate error code.
+         *
+         * @return Returns `mathex::Success`, or error code if function was not found.
+         */
+        Error setFunctionDerivative(const std::string &name, Derivative derivative) {
+            auto function = this->functions.find(name);
+
+            if (function == this->functions.end()) {
+                return Error::Undefined;
+            }
+
+            Error error = static_cast<Error>(mx_set_function_derivative(this->config, name.c_str(), wrapper_derivative<T>));
+
+            if (error == Success) {
+                function->second.derivative = derivative;
+            }
+
+            return error;
         }
 
         /**
@@ -158,6 +650,58 @@ namespace mathex {
             return static_cast<Error>(mx_remove(this->config, name.c_str()));
         }
 
+        /**
+         * @brief Makes configuration read-only, optimizing it for lookup of variables and functions.
+         *
+         * After this call, functions that add, remove or modify variables and functions return `mathex::Error::Frozen`.
+         *
+         * @return Returns `mathex::Success`, or error code if failed to allocate.
+         */
+        Error freeze() {
+            return static_cast<Error>(mx_freeze(this->config));
+        }
+
+        /**
+         * @brief Enables cache of compiled expressions used by `evaluate`. Cache is emptied whenever variables or functions change.
+         *
+         * @param maxEntries Maximum number of cached expressions. Zero disables the cache.
+         * @param maxBytes Maximum memory taken by the cached expressions.
+         *
+         * @return Returns `mathex::Success`, or error code if failed to allocate.
+         */
+        Error enableCache(size_t maxEntries, size_t maxBytes) {
+            return static_cast<Error>(mx_enable_cache(this->config, maxEntries, maxBytes));
+        }
+
+        /**
+         * @brief Returns current counters of the expression cache. All counters are zero if cache is disabled.
+         */
+        CacheStats cacheStats() const {
+            CacheStats stats;
+            mx_get_cache_stats(this->config, &stats);
+            return stats;
+        }
+
+        /**
+         * @brief Enables collection of statistics about parsing and evaluation. Evaluation of compiled expressions is not counted.
+         *
+         * @param flags Statistics to collect. `StatsFlags::None` disables collection.
+         *
+         * @return Returns `mathex::Success`, `Error::NotSupported` if timing is not available, or error code if failed to allocate.
+         */
+        Error enableStats(StatsFlags flags) {
+            return static_cast<Error>(mx_enable_stats(this->config, static_cast<mx_stats_flag>(flags)));
+        }
+
+        /**
+         * @brief Returns current statistics. All counters are zero if statistics are disabled.
+         */
+        Stats stats() const {
+            Stats stats;
+            mx_get_stats(this->config, &stats);
+            return stats;
+        }
+
         /**
          * @brief Takes mathematical expression and evaluates its numerical value.
          *
@@ -168,14 +712,955 @@ namespace mathex {
          *
          * @return Returns `mathex::Success`, or error code if expression contains any errors.
          */
-        Error evaluate(const std::string &expression, double &result) const {
-            return static_cast<Error>(mx_evaluate(this->config, expression.c_str(), &result));
+        Error evaluate(const std::string &expression, T &result) const {
+            double value;
+            mx_error error = mx_evaluate(this->config, expression.c_str(), &value);
+
+            if (error == MX_SUCCESS) {
+                result = static_cast<T>(value);
+            }
+
+            return static_cast<Error>(error);
+        }
+
+        /**
+         * @brief Takes mathematical expression and evaluates its numerical value using memory of given workspace.
+         *
+         * Does not allocate memory unless expression is larger than any previously evaluated in the workspace.
+         *
+         * @param workspace Workspace to evaluate in.
+         * @param expression String to evaluate.
+         * @param result Reference to write evaluation result to.
+         *
+         * @return Returns `mathex::Success`, or error code if expression contains any errors.
+         */
+        Error evaluate(Workspace &workspace, const std::string &expression, T &result) const {
+            double value;
+            mx_error error = mx_evaluate_ws(this->config, workspace.workspace, expression.c_str(), &value);
+
+            if (error == MX_SUCCESS) {
+                result = static_cast<T>(value);
+            }
+
+            return static_cast<Error>(error);
+        }
+
+        /**
+         * @brief Parses mathematical expression once, so that it can be evaluated many times without parsing it again.
+         *
+         * Program stays valid only as long as the functions it uses are not removed from this configuration object.
+         *
+         * @param expression String to compile.
+         * @param program Reference to write compiled program to. Left untouched if compilation failed.
+         *
+         * @return Returns `mathex::Success`, or error code if expression contains any errors.
+         */
+        Error compile(const std::string &expression, BasicProgram<T> &program) const {
+            mx_program *compiled;
+            mx_error error = mx_compile(this->config, expression.c_str(), &compiled);
+
+            if (error == MX_SUCCESS) {
+                if (program.program != nullptr) {
+                    mx_program_free(program.program);
+                }
+
+                program.program = compiled;
+            }
+
+            return static_cast<Error>(error);
         }
 
     private:
+        friend class Graph;
         mx_config *config;
-        std::map<std::string, Function> functions;
+        std::map<std::string, Callable<T>> functions;
+    };
+
+    /**
+     * @brief Configuration for parsing.
+     */
+    using Config = BasicConfig<double>;
+
+    /**
+     * @brief Named formulas referring to each other, recomputed in order of their dependencies.
+     */
+    class Graph {
+    public:
+        /**
+         * @brief Creates empty graph, whose formulas are compiled with the configuration object.
+         *
+         * @param config Configuration to add names of formulas into. Has to outlive the graph, and cannot use frame variables of its own.
+         */
+        Graph(Config &config) {
+            this->graph = mx_graph_create(config.config);
+        }
+
+        Graph(const Graph &) = delete;
+        Graph &operator=(const Graph &) = delete;
+
+        ~Graph() {
+            if (this->graph != nullptr) {
+                mx_graph_free(this->graph);
+            }
+        }
+
+        /**
+         * @brief Binds a name to an expression, which can refer to other formulas by their names.
+         *
+         * @param name Name of the formula.
+         * @param expression Expression of the formula.
+         *
+         * @return Returns `mathex::Success`, or error code if failed to insert the name.
+         */
+        Error define(const std::string &name, const std::string &expression) {
+            return static_cast<Error>(mx_graph_define(this->graph, name.c_str(), expression.c_str()));
+        }
+
+        /**
+         * @brief Evaluates every formula after all formulas it refers to, evaluating independent formulas in parallel.
+         *
+         * @param pool Threads to evaluate with.
+         *
+         * @return Returns `mathex::Success`, or error code of the first formula that failed.
+         */
+        Error recompute(Pool &pool) {
+            return static_cast<Error>(mx_graph_recompute(this->graph, pool.pool));
+        }
+
+        /**
+         * @brief Reads value of a formula computed by the last recompute.
+         *
+         * @param name Name of the formula.
+         * @param value Reference to write value of the formula to.
+         *
+         * @return Returns `mathex::Success`, or error code that evaluation of the formula failed with.
+         */
+        Error value(const std::string &name, double &value) const {
+            return static_cast<Error>(mx_graph_value(this->graph, name.c_str(), &value));
+        }
+
+    private:
+        mx_graph *graph;
+    };
+
+#if __cplusplus >= 202002L
+    namespace detail {
+        // String literal passed as a template argument.
+        template <size_t N>
+        struct FixedString {
+            char data[N] = {};
+
+            constexpr FixedString(const char (&string)[N]) {
+                for (size_t i = 0; i < N; i++) {
+                    this->data[i] = string[i];
+                }
+            }
+
+            constexpr std::string_view view() const {
+                return std::string_view(this->data, N - 1);
+            }
+        };
+
+        // Unsigned integer of fixed capacity, used to round number literals exactly like `mx_evaluate` does.
+        struct BigInteger {
+            static constexpr size_t capacity = 128;
+            uint32_t limbs[capacity] = {}; // least significant first
+            size_t size = 0;               // number of limbs in use, the most significant one is not zero
+
+            constexpr void multiplyAdd(uint32_t factor, uint32_t addend) {
+                uint64_t carry = addend;
+
+                for (size_t i = 0; i < this->size; i++) {
+                    uint64_t product = static_cast<uint64_t>(this->limbs[i]) * factor + carry;
+                    this->limbs[i] = static_cast<uint32_t>(product);
+                    carry = product >> 32;
+                }
+
+                if (carry != 0 && this->size < capacity) {
+                    this->limbs[this->size++] = static_cast<uint32_t>(carry);
+                }
+            }
+
+            constexpr void shiftLeft(size_t bits) {
+                size_t words = bits / 32;
+                size_t rest = bits % 32;
+
+                for (size_t i = this->size + words + 1; i-- > 0;) {
+                    uint64_t high = i >= words && i - words < this->size ? this->limbs[i - words] : 0;
+                    uint64_t low = i >= words + 1 && i - words - 1 < this->size ? this->limbs[i - words - 1] : 0;
+
+                    if (i < capacity) {
+                        this->limbs[i] = static_cast<uint32_t>(((high << 32 | low) << rest) >> 32);
+                    }
+                }
+
+                this->size = this->size + words + 1 < capacity ? this->size + words + 1 : capacity;
+
+                while (this->size > 0 && this->limbs[this->size - 1] == 0) {
+                    this->size--;
+                }
+            }
+
+            constexpr size_t bitLength() const {
+                return this->size == 0 ? 0 : 32 * (this->size - 1) + static_cast<size_t>(std::bit_width(this->limbs[this->size - 1]));
+            }
+
+            constexpr int compare(const BigInteger &other) const {
+                if (this->size != other.size) {
+                    return this->size < other.size ? -1 : 1;
+                }
+
+                for (size_t i = this->size; i-- > 0;) {
+                    if (this->limbs[i] != other.limbs[i]) {
+                        return this->limbs[i] < other.limbs[i] ? -1 : 1;
+                    }
+                }
+
+                return 0;
+            }
+
+            // Subtracts integer that is not greater than this one.
+            constexpr void subtract(const BigInteger &other) {
+                int64_t borrow = 0;
+
+                for (size_t i = 0; i < this->size; i++) {
+                    int64_t difference = static_cast<int64_t>(this->limbs[i]) - (i < other.size ? other.limbs[i] : 0) - borrow;
+                    borrow = difference < 0 ? 1 : 0;
+                    this->limbs[i] = static_cast<uint32_t>(difference + (borrow << 32));
+                }
+
+                while (this->size > 0 && this->limbs[this->size - 1] == 0) {
+                    this->size--;
+                }
+            }
+        };
+
+        // Digits of a number literal that are significant for rounding, more are only checked for being zero.
+        constexpr size_t maxLiteralDigits = 800;
+
+        // Rounds `digits * 10^exponent` to the nearest double, ties to even.
+        constexpr double roundDecimal(BigInteger digits, size_t nDigits, int64_t exponent) {
+            if (digits.size == 0 || static_cast<int64_t>(nDigits) + exponent < -324) {
+                return 0.0;
+            }
+
+            if (static_cast<int64_t>(nDigits) + exponent > 310) {
+                return std::numeric_limits<double>::infinity();
+            }
+
+            // value = numerator / denominator * 2^binaryExponent
+            BigInteger numerator = digits;
+            BigInteger denominator;
+            denominator.limbs[0] = 1;
+            denominator.size = 1;
+            int64_t binaryExponent = 0;
+
+            for (int64_t i = 0; i < exponent; i++) {
+                numerator.multiplyAdd(10, 0);
+            }
+
+            for (int64_t i = 0; i < -exponent; i++) {
+                denominator.multiplyAdd(5, 0);
+                binaryExponent--;
+            }
+
+            // Scales the fraction so that its integer part has 63 or 64 bits
+            int64_t shift = 63 + static_cast<int64_t>(denominator.bitLength()) - static_cast<int64_t>(numerator.bitLength());
+
+            if (shift > 0) {
+                numerator.shiftLeft(static_cast<size_t>(shift));
+            } else {
+                denominator.shiftLeft(static_cast<size_t>(-shift));
+            }
+
+            binaryExponent -= shift;
+            uint64_t quotient = 0;
+
+            for (size_t bit = 64; bit-- > 0;) {
+                BigInteger shifted = denominator;
+                shifted.shiftLeft(bit);
+
+                if (shifted.compare(numerator) <= 0) {
+                    numerator.subtract(shifted);
+                    quotient |= uint64_t(1) << bit;
+                }
+            }
+
+            bool sticky = numerator.size != 0;
+            int64_t length = std::bit_width(quotient);
+            int64_t leading = binaryExponent + length - 1;
+
+            // Subnormal numbers keep fewer bits, so that the least significant one is 2^-1074
+            int64_t drop = leading >= -1022 ? length - 53 : -1074 - binaryExponent;
+
+            if (drop >= 65) {
+                return 0.0;
+            }
+
+            uint64_t mantissa = drop >= 64 ? 0 : quotient >> drop;
+            bool half = (quotient >> (drop - 1)) & 1;
+            bool rest = sticky || (drop >= 2 && (quotient & ((uint64_t(1) << (drop - 1)) - 1)) != 0);
+
+            if (half && (rest || (mantissa & 1))) {
+                mantissa++;
+            }
+
+            if (leading < -1022) {
+                // Subnormal number rounded up to 2^52 is the smallest normal number, which has the same bits
+                return std::bit_cast<double>(mantissa);
+            }
+
+            if (mantissa >> 53) {
+                mantissa >>= 1;
+                leading++;
+            }
+
+            if (leading > 1023) {
+                return std::numeric_limits<double>::infinity();
+            }
+
+            return std::bit_cast<double>(static_cast<uint64_t>(leading + 1023) << 52 | (mantissa & ((uint64_t(1) << 52) - 1)));
+        }
+
+        // Reads number literal starting at `begin` with the same rules as `mx_evaluate`. Returns end of the literal, or `npos` if it is invalid.
+        constexpr size_t scanNumber(std::string_view expression, size_t begin, bool sciNotation, double &value) {
+            BigInteger digits;
+            size_t nDigits = 0;
+            int64_t exponent = 0;
+            bool truncated = false;
+            size_t i = begin;
+
+            auto scanDigits = [&](bool fraction) {
+                for (; i < expression.size() && expression[i] >= '0' && expression[i] <= '9'; i++) {
+                    uint32_t digit = static_cast<uint32_t>(expression[i] - '0');
+
+                    if (digits.size == 0 && digit == 0) {
+                        // Leading zeros are not significant
+                        exponent -= fraction ? 1 : 0;
+                    } else if (nDigits < maxLiteralDigits) {
+                        digits.multiplyAdd(10, digit);
+                        nDigits++;
+                        exponent -= fraction ? 1 : 0;
+                    } else {
+                        truncated = truncated || digit != 0;
+                        exponent += fraction ? 0 : 1;
+                    }
+                }
+            };
+
+            scanDigits(false);
+
+            if (i < expression.size() && expression[i] == '.') {
+                i++;
+                scanDigits(true);
+
+                // Only one decimal point is allowed
+                if (i < expression.size() && expression[i] == '.') {
+                    return std::string_view::npos;
+                }
+            }
+
+            if (sciNotation && i < expression.size() && (expression[i] == 'e' || expression[i] == 'E')) {
+                size_t exponentStart = i + 1;
+                bool negative = false;
+                int64_t literalExponent = 0;
+
+                if (exponentStart < expression.size() && expression[exponentStart] == '.') {
+                    return std::string_view::npos;
+                }
+
+                // Separator that is not followed by exponent is not part of the literal
+                if (exponentStart < expression.size() && (expression[exponentStart] == '+' || expression[exponentStart] == '-')) {
+                    negative = expression[exponentStart] == '-';
+                    i = exponentStart + 1;
+                } else if (exponentStart < expression.size() && expression[exponentStart] >= '0' && expression[exponentStart] <= '9') {
+                    i = exponentStart;
+                }
+
+                for (; i < expression.size() && expression[i] >= '0' && expression[i] <= '9'; i++) {
+                    if (literalExponent < 1000000000) {
+                        literalExponent = literalExponent * 10 + (expression[i] - '0');
+                    }
+                }
+
+                if (i < expression.size() && expression[i] == '.') {
+                    return std::string_view::npos;
+                }
+
+                exponent += negative ? -literalExponent : literalExponent;
+            }
+
+            // ".1" => 0.1 and "1." => 1.0 but "." != 0.0
+            if (i - begin == 1 && expression[begin] == '.') {
+                return std::string_view::npos;
+            }
+
+            // Digits beyond the significant ones only matter for breaking ties, which a trailing non-zero digit does as well
+            if (truncated) {
+                digits.multiplyAdd(10, 1);
+                nDigits++;
+                exponent--;
+            }
+
+            value = roundDecimal(digits, nDigits, exponent);
+            return i;
+        }
+
+        // Operation of an expression parsed at compile time.
+        enum class StaticOp { Add, Sub, Mul, Div, Pow, Mod, Min, Max, Pos, Neg, Sin, Cos, Exp, Log, Sqrt, Abs, Floor, Ceil };
+
+        // Token of an expression parsed at compile time, in postfix order once parsed.
+        struct StaticToken {
+            enum Type { Empty, LeftParen, RightParen, Comma, Constant, Variable, Function, BinaryOperator, UnaryOperator };
+
+            Type type = Empty;
+            StaticOp op = StaticOp::Add;
+            double number = 0; // value of a constant
+            size_t name = 0;   // offset of the name of a variable in the expression
+            size_t length = 0; // length of the name of a variable
+            size_t slot = 0;   // position of the result on the evaluation stack
+        };
+
+        // Built-in function that can be called by expressions parsed at compile time.
+        struct StaticBuiltin {
+            std::string_view name;
+            mx_flag flag;
+            StaticOp op;
+            bool binary; // applied repeatedly to one or more arguments
+        };
+
+        inline constexpr StaticBuiltin staticBuiltins[] = {
+            {"sin", MX_ENABLE_SIN, StaticOp::Sin, false},
+            {"cos", MX_ENABLE_COS, StaticOp::Cos, false},
+            {"exp", MX_ENABLE_EXP, StaticOp::Exp, false},
+            {"log", MX_ENABLE_LOG, StaticOp::Log, false},
+            {"sqrt", MX_ENABLE_SQRT, StaticOp::Sqrt, false},
+            {"abs", MX_ENABLE_ABS, StaticOp::Abs, false},
+            {"min", MX_ENABLE_MIN, StaticOp::Min, true},
+            {"max", MX_ENABLE_MAX, StaticOp::Max, true},
+            {"floor", MX_ENABLE_FLOOR, StaticOp::Floor, false},
+            {"ceil", MX_ENABLE_CEIL, StaticOp::Ceil, false},
+        };
+
+        constexpr int precedence(StaticOp op) {
+            return op == StaticOp::Pow ? 4 : op == StaticOp::Add || op == StaticOp::Sub ? 2 : 3;
+        }
+
+        constexpr bool isBinary(StaticOp op) {
+            return op <= StaticOp::Max;
+        }
+
+        // Expression parsed into postfix tokens at compile time. Expression of length N never has more than 2N tokens.
+        template <size_t Capacity>
+        struct StaticProgram {
+            Error error = Error::Success;
+            size_t nTokens = 0;
+            size_t depth = 0; // maximum number of values on the evaluation stack
+            StaticToken tokens[Capacity] = {};
+        };
+
+        // Converts expression into postfix notation with the same grammar as `mx_evaluate`. Names that are not enabled
+        // built-in functions are variables.
+        template <size_t N>
+        constexpr StaticProgram<2 * N> parseStatic(const FixedString<N> &source, Flags flags) {
+            using Token = StaticToken;
+
+            std::string_view expression = source.view();
+            StaticProgram<2 * N> program;
+            Token ops[N] = {};
+            size_t nOps = 0;
+            int args[N] = {};
+            size_t nArgs = 0;
+            int argCount = 0;
+            Token::Type lastToken = Token::Empty;
+
+            auto flag = [&](mx_flag f) {
+                return (static_cast<std::underlying_type<Flags>::type>(flags) & f) != 0;
+            };
+
+            auto operandOrder = [&]() {
+                return lastToken == Token::Empty || lastToken == Token::LeftParen || lastToken == Token::Comma || lastToken == Token::BinaryOperator || lastToken == Token::UnaryOperator;
+            };
+
+            auto unaryOrder = [&]() {
+                return lastToken == Token::Empty || lastToken == Token::LeftParen || lastToken == Token::Comma || lastToken == Token::UnaryOperator;
+            };
+
+            auto binaryOrder = [&]() {
+                return lastToken == Token::Constant || lastToken == Token::Variable || lastToken == Token::RightParen;
+            };
+
+            auto emit = [&](Token token) {
+                program.tokens[program.nTokens++] = token;
+            };
+
+            auto operatorToken = [](Token::Type type, StaticOp op) {
+                Token token;
+                token.type = type;
+                token.op = op;
+                return token;
+            };
+
+            // Pops operators binding tighter than binary operator `op` into the output
+            auto popOperators = [&](StaticOp op) {
+                while (nOps > 0) {
+                    const Token &top = ops[nOps - 1];
+
+                    if (top.type == Token::BinaryOperator) {
+                        if (!(precedence(top.op) > precedence(op) || (precedence(top.op) == precedence(op) && op != StaticOp::Pow))) {
+                            break;
+                        }
+                    } else if (top.type != Token::UnaryOperator) {
+                        // Precedence of unary operator is always greater than of any binary operator
+                        break;
+                    }
+
+                    emit(ops[--nOps]);
+                }
+            };
+
+            // Built-in functions are written as operators they are compiled into
+            auto emitCall = [&](const Token &function, int count) {
+                bool binary = isBinary(function.op);
+
+                if (count < 1 || (!binary && count > 1)) {
+                    return false;
+                }
+
+                for (int i = binary ? 1 : 0; i < count; i++) {
+                    emit(operatorToken(binary ? Token::BinaryOperator : Token::UnaryOperator, function.op));
+                }
+
+                return true;
+            };
+
+            auto fail = [&](Error error) {
+                program.error = error;
+                return program;
+            };
+
+            for (size_t i = 0; i < expression.size(); i++) {
+                char character = expression[i];
+
+                if (character == ' ') {
+                    continue;
+                }
+
+                if ((character >= '0' && character <= '9') || character == '.') {
+                    if (!operandOrder()) {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    argCount = argCount == 0 ? 1 : argCount;
+
+                    Token token;
+                    token.type = Token::Constant;
+                    size_t end = scanNumber(expression, i, flag(MX_SCI_NOTATION), token.number);
+
+                    if (end == std::string_view::npos) {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    emit(token);
+                    lastToken = Token::Constant;
+                    i = end - 1;
+                    continue;
+                }
+
+                if ((character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') || character == '_') {
+                    if (lastToken == Token::Constant && flag(MX_IMPLICIT_MUL)) {
+                        popOperators(StaticOp::Mul);
+                        ops[nOps++] = operatorToken(Token::BinaryOperator, StaticOp::Mul);
+                    } else if (!operandOrder()) {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    argCount = argCount == 0 ? 1 : argCount;
+
+                    size_t end = i + 1;
+
+                    while (end < expression.size() && ((expression[end] >= 'a' && expression[end] <= 'z') || (expression[end] >= 'A' && expression[end] <= 'Z') || (expression[end] >= '0' && expression[end] <= '9') || expression[end] == '_')) {
+                        end++;
+                    }
+
+                    std::string_view name = expression.substr(i, end - i);
+                    Token token;
+                    token.type = Token::Variable;
+                    token.name = i;
+                    token.length = end - i;
+
+                    for (const StaticBuiltin &builtin : staticBuiltins) {
+                        if (builtin.name == name && flag(builtin.flag)) {
+                            token.type = Token::Function;
+                            token.op = builtin.op;
+                        }
+                    }
+
+                    if (token.type == Token::Function) {
+                        if (end == expression.size() || expression[end] != '(') {
+                            return fail(Error::SyntaxError);
+                        }
+
+                        ops[nOps++] = token;
+                    } else {
+                        emit(token);
+                    }
+
+                    lastToken = token.type;
+                    i = end - 1;
+                    continue;
+                }
+
+                Token token;
+                bool isOperator = false;
+
+                if (character == '+') {
+                    if (flag(MX_ENABLE_ADD) && binaryOrder()) {
+                        token = operatorToken(Token::BinaryOperator, StaticOp::Add);
+                    } else if (flag(MX_ENABLE_POS) && unaryOrder()) {
+                        token = operatorToken(Token::UnaryOperator, StaticOp::Pos);
+                    } else {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    isOperator = true;
+                } else if (character == '-') {
+                    if (flag(MX_ENABLE_SUB) && binaryOrder()) {
+                        token = operatorToken(Token::BinaryOperator, StaticOp::Sub);
+                    } else if (flag(MX_ENABLE_NEG) && unaryOrder()) {
+                        token = operatorToken(Token::UnaryOperator, StaticOp::Neg);
+                    } else {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    isOperator = true;
+                } else if ((character == '*' && flag(MX_ENABLE_MUL)) || (character == '/' && flag(MX_ENABLE_DIV)) || (character == '^' && flag(MX_ENABLE_POW)) || (character == '%' && flag(MX_ENABLE_MOD))) {
+                    // There should always be an operand on the left hand side of the operator
+                    if (!binaryOrder()) {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    StaticOp op = character == '*' ? StaticOp::Mul : character == '/' ? StaticOp::Div : character == '^' ? StaticOp::Pow : StaticOp::Mod;
+                    token = operatorToken(Token::BinaryOperator, op);
+                    isOperator = true;
+                }
+
+                if (isOperator) {
+                    if (token.type == Token::BinaryOperator) {
+                        popOperators(token.op);
+                    }
+
+                    ops[nOps++] = token;
+                    lastToken = token.type;
+                    continue;
+                }
+
+                if (character == '(') {
+                    if (lastToken == Token::Function) {
+                        // Start of function argument list
+                        args[nArgs++] = argCount;
+                        argCount = 0;
+                    } else {
+                        if (!operandOrder()) {
+                            return fail(Error::SyntaxError);
+                        }
+
+                        argCount = argCount == 0 ? 1 : argCount;
+                    }
+
+                    ops[nOps++] = operatorToken(Token::LeftParen, StaticOp::Add);
+                    lastToken = Token::LeftParen;
+                    continue;
+                }
+
+                if (character == ')') {
+                    // Empty expressions are not allowed
+                    if (lastToken == Token::Empty || lastToken == Token::Comma) {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    if (lastToken != Token::LeftParen) {
+                        if (nOps == 0) {
+                            // Mismatched parenthesis (ignore if implicit parentheses are enabled)
+                            if (!flag(MX_IMPLICIT_PARENS)) {
+                                return fail(Error::SyntaxError);
+                            }
+
+                            continue;
+                        }
+
+                        while (ops[nOps - 1].type != Token::LeftParen) {
+                            emit(ops[--nOps]);
+
+                            if (nOps == 0) {
+                                if (!flag(MX_IMPLICIT_PARENS)) {
+                                    return fail(Error::SyntaxError);
+                                }
+
+                                break;
+                            }
+                        }
+                    }
+
+                    if (nOps > 0) {
+                        nOps--; // Discard left parenthesis
+
+                        if (nOps > 0 && ops[nOps - 1].type == Token::Function) {
+                            if (!emitCall(ops[--nOps], argCount)) {
+                                return fail(Error::IncorrectArgsNum);
+                            }
+
+                            argCount = args[--nArgs];
+                        } else if (lastToken == Token::LeftParen) {
+                            // Empty parentheses are not allowed
+                            return fail(Error::SyntaxError);
+                        }
+                    }
+
+                    lastToken = Token::RightParen;
+                    continue;
+                }
+
+                if (character == ',') {
+                    // Previous argument has to be non-empty, and comma is only valid inside function parentheses
+                    if (!binaryOrder() || nArgs == 0) {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    if (nOps == 0) {
+                        if (!flag(MX_IMPLICIT_PARENS)) {
+                            return fail(Error::SyntaxError);
+                        }
+
+                        continue;
+                    }
+
+                    while (ops[nOps - 1].type != Token::LeftParen) {
+                        emit(ops[--nOps]);
+
+                        if (nOps == 0) {
+                            if (!flag(MX_IMPLICIT_PARENS)) {
+                                return fail(Error::SyntaxError);
+                            }
+
+                            break;
+                        }
+                    }
+
+                    argCount++;
+                    lastToken = Token::Comma;
+                    continue;
+                }
+
+                // Any character that was not captured by previous checks is considered invalid
+                return fail(Error::SyntaxError);
+            }
+
+            // Expression cannot end if operand is expected next
+            if (operandOrder()) {
+                return fail(Error::SyntaxError);
+            }
+
+            while (nOps > 0) {
+                Token token = ops[--nOps];
+
+                if (token.type == Token::LeftParen) {
+                    if (!flag(MX_IMPLICIT_PARENS)) {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    continue;
+                }
+
+                if (token.type == Token::Function) {
+                    // Implicit parentheses for zero argument functions are not allowed
+                    if (argCount == 0) {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    if (!emitCall(token, argCount)) {
+                        return fail(Error::IncorrectArgsNum);
+                    }
+
+                    argCount = args[--nArgs];
+                    continue;
+                }
+
+                emit(token);
+            }
+
+            // Assigns stack positions to the results, checking that exactly one value is left
+            size_t depth = 0;
+
+            for (size_t i = 0; i < program.nTokens; i++) {
+                Token &token = program.tokens[i];
+
+                if (token.type == Token::Constant || token.type == Token::Variable) {
+                    token.slot = depth++;
+                } else if (token.type == Token::BinaryOperator) {
+                    if (depth < 2) {
+                        return fail(Error::SyntaxError);
+                    }
+
+                    token.slot = --depth - 1;
+                } else if (depth < 1) {
+                    return fail(Error::SyntaxError);
+                } else {
+                    token.slot = depth - 1;
+                }
+
+                program.depth = depth > program.depth ? depth : program.depth;
+            }
+
+            return depth == 1 ? program : fail(Error::SyntaxError);
+        }
+
+        constexpr double applyBinary(StaticOp op, double a, double b) {
+            switch (op) {
+            case StaticOp::Add:
+                return a + b;
+            case StaticOp::Sub:
+                return a - b;
+            case StaticOp::Mul:
+                return a * b;
+            case StaticOp::Div:
+                return a / b;
+            case StaticOp::Pow:
+                return std::pow(a, b);
+            case StaticOp::Mod:
+                return std::fmod(a, b);
+            case StaticOp::Min:
+                return std::fmin(a, b);
+            default:
+                return std::fmax(a, b);
+            }
+        }
+
+        constexpr double applyUnary(StaticOp op, double x) {
+            switch (op) {
+            case StaticOp::Neg:
+                return -x;
+            case StaticOp::Sin:
+                return std::sin(x);
+            case StaticOp::Cos:
+                return std::cos(x);
+            case StaticOp::Exp:
+                return std::exp(x);
+            case StaticOp::Log:
+                return std::log(x);
+            case StaticOp::Sqrt:
+                return std::sqrt(x);
+            case StaticOp::Abs:
+                return std::fabs(x);
+            case StaticOp::Floor:
+                return std::floor(x);
+            case StaticOp::Ceil:
+                return std::ceil(x);
+            default:
+                return x;
+            }
+        }
+    }
+
+    /**
+     * @brief Value of a variable of `StaticExpression` bound to its name.
+     */
+    template <detail::FixedString Name, typename T>
+    struct Binding {
+        static constexpr detail::FixedString name = Name;
+        T value;
+    };
+
+    /**
+     * @brief Binds value to a variable of `StaticExpression` with given name.
+     *
+     * @param value Value of the variable.
+     */
+    template <detail::FixedString Name, typename T>
+    constexpr Binding<Name, T> bind(T value) {
+        return Binding<Name, T>{value};
+    }
+
+    /**
+     * @brief Expression parsed at compile time with the same grammar and flags as `Config::evaluate`, requires C++20.
+     *
+     * Every name that is not an enabled built-in function is a variable, bound by name when the expression is evaluated.
+     * Evaluation is compiled into straight-line code for the expression, with no parsing or lookups at runtime.
+     * Invalid expressions fail to compile.
+     *
+     * @code
+     * constexpr mathex::StaticExpression<"x * y + 2"> expression;
+     * double result = expression(mathex::bind<"x">(3.0), mathex::bind<"y">(4.0));
+     * @endcode
+     */
+    template <detail::FixedString Expression, Flags ExpressionFlags = DefaultFlags>
+    class StaticExpression {
+        static constexpr auto program = detail::parseStatic(Expression, ExpressionFlags);
+
+        static_assert(program.error != Error::SyntaxError, "Expression syntax is invalid");
+        static_assert(program.error != Error::IncorrectArgsNum, "Built-in function is called with incorrect number of arguments");
+
+        // Index of the binding of the variable read by the token.
+        template <size_t I, typename... Bindings>
+        static constexpr size_t bindingIndex() {
+            constexpr detail::StaticToken token = program.tokens[I];
+            constexpr std::string_view names[] = {Bindings::name.view()..., std::string_view()};
+
+            for (size_t i = 0; i < sizeof...(Bindings); i++) {
+                if (names[i] == Expression.view().substr(token.name, token.length)) {
+                    return i;
+                }
+            }
+
+            return sizeof...(Bindings);
+        }
+
+        template <size_t I, typename... Bindings>
+        static constexpr void step(double stack[], const Bindings &...bindings) {
+            constexpr detail::StaticToken token = program.tokens[I];
+
+            if constexpr (token.type == detail::StaticToken::Constant) {
+                stack[token.slot] = token.number;
+            } else if constexpr (token.type == detail::StaticToken::Variable) {
+                constexpr size_t index = bindingIndex<I, Bindings...>();
+                static_assert(index < sizeof...(Bindings), "Variable of the expression is not bound");
+
+                if constexpr (index < sizeof...(Bindings)) {
+                    stack[token.slot] = static_cast<double>(std::get<index>(std::forward_as_tuple(bindings...)).value);
+                }
+            } else if constexpr (token.type == detail::StaticToken::BinaryOperator) {
+                stack[token.slot] = detail::applyBinary(token.op, stack[token.slot], stack[token.slot + 1]);
+            } else {
+                stack[token.slot] = detail::applyUnary(token.op, stack[token.slot]);
+            }
+        }
+
+        template <size_t... I, typename... Bindings>
+        static constexpr double execute(std::index_sequence<I...>, const Bindings &...bindings) {
+            double stack[program.depth] = {};
+            (step<I>(stack, bindings...), ...);
+            return stack[0];
+        }
+
+    public:
+        /**
+         * @brief Evaluates numerical value of the expression.
+         *
+         * @param bindings Values of every variable of the expression, created using `mathex::bind`. Bindings of names not used by the expression are ignored.
+         *
+         * @return Returns value of the expression.
+         */
+        template <typename... Bindings>
+        static constexpr double evaluate(const Bindings &...bindings) {
+            return execute(std::make_index_sequence<program.nTokens>(), bindings...);
+        }
+
+        template <typename... Bindings>
+        constexpr double operator()(const Bindings &...bindings) const {
+            return evaluate(bindings...);
+        }
     };
+#endif
 }
 
 #endif /* MATHEX_HPP */
@@ -1,4 +1,3 @@
-#include <math.h>
 #include <mathex.h>
 #include <stdio.h>
 
@@ -17,22 +16,13 @@ mx_error sum_function(double args[], int num_args, double *result, void *data) {
     return MX_SUCCESS;
 }
 
-mx_error abs_function(double args[], int num_args, double *result, void *data) {
-    if (num_args != 1) {
-        return MX_ERR_ARGS_NUM;
-    }
-
-    *result = fabs(args[0]);
-    return MX_SUCCESS;
-}
-
 double x = 3;
 double y = 5;
 double z = 8;
 
 int main() {
-    // Create a configuration with default flags
-    mx_config *config = mx_create(MX_DEFAULT);
+    // Create a configuration with default flags and built-in `abs` function
+    mx_config *config = mx_create(MX_DEFAULT | MX_ENABLE_ABS);
 
     if (!config) {
         fprintf(stderr, "Failed to create configuration.\n");
@@ -48,7 +38,6 @@ int main() {
     mx_add_constant(config, "pi", 3.14);
 
     mx_add_function(config, "sum", sum_function, NULL);
-    mx_add_function(config, "abs", abs_function, NULL);
 
     // Evaluate expressions using the configuration
     double result;
@@ -0,0 +1,484 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+// Required for POSIX threads in strict C99 mode
+#define _DEFAULT_SOURCE
+
+#include "mathex.h"
+#include "mx_kernels.h"
+#include "mx_pool.h"
+#include "mx_program.h"
+#include "mx_thread.h"
+#include "mx_token.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of rows evaluated by each postfix operation at once.
+#define BLOCK_SIZE 256
+
+// Number of rows evaluated by a thread before it takes the next chunk in parallel evaluation.
+#define CHUNK_SIZE (16 * BLOCK_SIZE)
+
+// Program bound to columns, shared by all threads evaluating it.
+typedef struct batch_plan {
+    const mx_program *program;
+    const kernel_table *kernels;     // kernels of double-precision evaluation, or NULL if evaluated in single precision
+    const kernel_table_f *kernels_f; // kernels of single-precision evaluation, or NULL if evaluated in double precision
+    bool single;                     // whether program is evaluated in single precision
+    const void **sources;            // column of each variable token, or NULL if variable has no column
+    double *values;                  // value of each variable token without column, read once for all rows
+    size_t stack_size;               // number of values in the evaluation stack of one thread, including temporary slots
+    size_t max_args;                 // maximum number of arguments of a function call
+    bool lock_calls;                 // whether functions that are not thread-safe have to be called under `call_lock`
+    mx_mutex call_lock;
+} batch_plan;
+
+// Finds column bound to the variable token, or NULL if variable has no column.
+// Columns are `columns_f` if evaluated in single precision, or `columns` otherwise.
+static const void *find_column(const mx_program *program, const mx_column columns[], const mx_column_f columns_f[], size_t n_columns, bool single, const mx_token *token) {
+    for (size_t i = 0; i < program->n_vars; i++) {
+        if (!same_variable(&program->vars[i], token)) {
+            continue;
+        }
+
+        for (size_t j = 0; j < n_columns; j++) {
+            const char *name = single ? columns_f[j].name : columns[j].name;
+
+            if (strcmp(name, program->vars[i].name) == 0) {
+                return single ? (const void *)columns_f[j].values : (const void *)columns[j].values;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Frame variables have no value outside of the frame, so every one of them has to be bound to a column.
+// Program evaluated in single precision is bound to `columns_f`, otherwise it is bound to `columns`.
+static mx_error create_plan(batch_plan *plan, const mx_program *program, const mx_column columns[], const mx_column_f columns_f[], size_t n_columns, bool single, bool lock_calls) {
+    plan->program = program;
+    plan->kernels = single ? NULL : select_kernels();
+    plan->kernels_f = single ? select_kernels_f() : NULL;
+    plan->single = single;
+    plan->sources = calloc(program->n_tokens, sizeof(const void *));
+    plan->values = calloc(program->n_tokens, sizeof(double));
+    plan->stack_size = BLOCK_SIZE * (program->depth + program->n_slots);
+    plan->max_args = 1;
+    plan->lock_calls = false;
+
+    if (plan->sources == NULL || plan->values == NULL) {
+        free(plan->sources);
+        free(plan->values);
+        return MX_ERR_NO_MEMORY;
+    }
+
+    for (size_t i = 0; i < program->n_args; i++) {
+        if ((size_t)program->args[i] > plan->max_args) {
+            plan->max_args = (size_t)program->args[i];
+        }
+    }
+
+    for (size_t i = 0; i < program->n_tokens; i++) {
+        mx_token token = program->tokens[i];
+
+        if (token.type == MX_VARIABLE || token.type == MX_FLOAT_VARIABLE || token.type == MX_FRAME_VARIABLE) {
+            plan->sources[i] = find_column(program, columns, columns_f, n_columns, single, &token);
+
+            if (token.type == MX_FRAME_VARIABLE && plan->sources[i] == NULL) {
+                free(plan->sources);
+                free(plan->values);
+                return MX_ERR_UNDEFINED;
+            }
+
+            if (plan->sources[i] == NULL) {
+                plan->values[i] = variable_value(&token);
+            }
+        } else if (token.type == MX_FUNCTION && !(token.d.func.flags & (MX_FUNC_PURE | MX_FUNC_THREAD_SAFE))) {
+            plan->lock_calls = lock_calls;
+        }
+    }
+
+    if (plan->lock_calls) {
+        mutex_init(&plan->call_lock);
+    }
+
+    return MX_SUCCESS;
+}
+
+static void free_plan(batch_plan *plan) {
+    if (plan->lock_calls) {
+        mutex_destroy(&plan->call_lock);
+    }
+
+    free(plan->sources);
+    free(plan->values);
+}
+
+// Evaluates rows from `begin` to `end`, using `stack` of `stack_size` values and `func_args` of `max_args` values.
+static mx_error evaluate_rows(batch_plan *plan, double *stack, double *func_args, size_t begin, size_t end, double results[]) {
+    const mx_program *program = plan->program;
+    double *slots = stack + BLOCK_SIZE * program->depth;
+
+    for (size_t start = begin; start < end; start += BLOCK_SIZE) {
+        size_t length = end - start < BLOCK_SIZE ? end - start : BLOCK_SIZE;
+        double *top = stack; // Block right above the top of the stack
+        const int *args = program->args;
+
+        for (size_t i = 0; i < program->n_tokens; i++) {
+            mx_token token = program->tokens[i];
+
+            switch (token.type) {
+            case MX_CONSTANT: {
+                for (size_t j = 0; j < length; j++) {
+                    top[j] = token.d.number;
+                }
+
+                top += BLOCK_SIZE;
+            } break;
+
+            case MX_VARIABLE:
+            case MX_FLOAT_VARIABLE:
+            case MX_FRAME_VARIABLE: {
+                if (plan->sources[i] != NULL) {
+                    memcpy(top, (const double *)plan->sources[i] + start, sizeof(double) * length);
+                } else {
+                    double value = plan->values[i];
+
+                    for (size_t j = 0; j < length; j++) {
+                        top[j] = value;
+                    }
+                }
+
+                top += BLOCK_SIZE;
+            } break;
+
+            case MX_BINARY_OPERATOR: {
+                double *a = top - 2 * BLOCK_SIZE;
+                double *b = top - BLOCK_SIZE;
+
+                plan->kernels->binary[token.d.biop.op](a, b, length);
+                top -= BLOCK_SIZE;
+            } break;
+
+            case MX_UNARY_OPERATOR: {
+                plan->kernels->unary[token.d.unop.op](top - BLOCK_SIZE, length);
+            } break;
+
+            case MX_STORE: {
+                memcpy(slots + token.d.slot * BLOCK_SIZE, top - BLOCK_SIZE, sizeof(double) * length);
+            } break;
+
+            case MX_LOAD: {
+                memcpy(top, slots + token.d.slot * BLOCK_SIZE, sizeof(double) * length);
+                top += BLOCK_SIZE;
+            } break;
+
+            case MX_FUNCTION: {
+                int args_num = *args++;
+                double *first = top - (size_t)args_num * BLOCK_SIZE;
+                bool locked = plan->lock_calls && !(token.d.func.flags & (MX_FUNC_PURE | MX_FUNC_THREAD_SAFE));
+                mx_error error_code = MX_SUCCESS;
+
+                if (locked) {
+                    mutex_lock(&plan->call_lock);
+                }
+
+                for (size_t j = 0; j < length && error_code == MX_SUCCESS; j++) {
+                    for (int k = 0; k < args_num; k++) {
+                        func_args[k] = first[(size_t)k * BLOCK_SIZE + j];
+                    }
+
+                    error_code = call_function(&token, args_num > 0 ? func_args : NULL, args_num, &first[j]);
+                }
+
+                if (locked) {
+                    mutex_unlock(&plan->call_lock);
+                }
+
+                if (error_code != MX_SUCCESS) {
+                    return error_code;
+                }
+
+                top = first + BLOCK_SIZE;
+            } break;
+
+            default: {
+            } break;
+            }
+        }
+
+        memcpy(results + start, stack, sizeof(double) * length);
+    }
+
+    return MX_SUCCESS;
+}
+
+// Same as `evaluate_rows`, but in single precision.
+static mx_error evaluate_rows_f(batch_plan *plan, float *stack, float *func_args, size_t begin, size_t end, float results[]) {
+    const mx_program *program = plan->program;
+    float *slots = stack + BLOCK_SIZE * program->depth;
+
+    for (size_t start = begin; start < end; start += BLOCK_SIZE) {
+        size_t length = end - start < BLOCK_SIZE ? end - start : BLOCK_SIZE;
+        float *top = stack; // Block right above the top of the stack
+        const int *args = program->args;
+
+        for (size_t i = 0; i < program->n_tokens; i++) {
+            mx_token token = program->tokens[i];
+
+            switch (token.type) {
+            case MX_CONSTANT: {
+                for (size_t j = 0; j < length; j++) {
+                    top[j] = (float)token.d.number;
+                }
+
+                top += BLOCK_SIZE;
+            } break;
+
+            case MX_VARIABLE:
+            case MX_FLOAT_VARIABLE:
+            case MX_FRAME_VARIABLE: {
+                if (plan->sources[i] != NULL) {
+                    memcpy(top, (const float *)plan->sources[i] + start, sizeof(float) * length);
+                } else {
+                    float value = (float)plan->values[i];
+
+                    for (size_t j = 0; j < length; j++) {
+                        top[j] = value;
+                    }
+                }
+
+                top += BLOCK_SIZE;
+            } break;
+
+            case MX_BINARY_OPERATOR: {
+                float *a = top - 2 * BLOCK_SIZE;
+                float *b = top - BLOCK_SIZE;
+
+                plan->kernels_f->binary[token.d.biop.op](a, b, length);
+                top -= BLOCK_SIZE;
+            } break;
+
+            case MX_UNARY_OPERATOR: {
+                plan->kernels_f->unary[token.d.unop.op](top - BLOCK_SIZE, length);
+            } break;
+
+            case MX_STORE: {
+                memcpy(slots + token.d.slot * BLOCK_SIZE, top - BLOCK_SIZE, sizeof(float) * length);
+            } break;
+
+            case MX_LOAD: {
+                memcpy(top, slots + token.d.slot * BLOCK_SIZE, sizeof(float) * length);
+                top += BLOCK_SIZE;
+            } break;
+
+            case MX_FUNCTION: {
+                int args_num = *args++;
+                float *first = top - (size_t)args_num * BLOCK_SIZE;
+                bool locked = plan->lock_calls && !(token.d.func.flags & (MX_FUNC_PURE | MX_FUNC_THREAD_SAFE));
+                mx_error error_code = MX_SUCCESS;
+
+                if (locked) {
+                    mutex_lock(&plan->call_lock);
+                }
+
+                for (size_t j = 0; j < length && error_code == MX_SUCCESS; j++) {
+                    for (int k = 0; k < args_num; k++) {
+                        func_args[k] = first[(size_t)k * BLOCK_SIZE + j];
+                    }
+
+                    error_code = call_function_f(&token, args_num > 0 ? func_args : NULL, args_num, &first[j]);
+                }
+
+                if (locked) {
+                    mutex_unlock(&plan->call_lock);
+                }
+
+                if (error_code != MX_SUCCESS) {
+                    return error_code;
+                }
+
+                top = first + BLOCK_SIZE;
+            } break;
+
+            default: {
+            } break;
+            }
+        }
+
+        memcpy(results + start, stack, sizeof(float) * length);
+    }
+
+    return MX_SUCCESS;
+}
+
+mx_error mx_program_eval_batch(const mx_program *program, const mx_column columns[], size_t n_columns, size_t n_rows, double results[]) {
+    mx_error error_code = MX_SUCCESS;
+    batch_plan plan;
+
+    error_code = create_plan(&plan, program, columns, NULL, n_columns, false, false);
+
+    if (error_code != MX_SUCCESS) {
+        return error_code;
+    }
+
+    double *stack = malloc(sizeof(double) * (plan.stack_size + plan.max_args));
+    RETURN_ERROR_IF(stack == NULL, MX_ERR_NO_MEMORY);
+
+    error_code = evaluate_rows(&plan, stack, stack + plan.stack_size, 0, n_rows, results);
+
+cleanup:
+    free(stack);
+    free_plan(&plan);
+
+    return error_code;
+}
+
+mx_error mx_program_eval_batch_f(const mx_program *program, const mx_column_f columns[], size_t n_columns, size_t n_rows, float results[]) {
+    mx_error error_code = MX_SUCCESS;
+    batch_plan plan;
+
+    error_code = create_plan(&plan, program, NULL, columns, n_columns, true, false);
+
+    if (error_code != MX_SUCCESS) {
+        return error_code;
+    }
+
+    float *stack = malloc(sizeof(float) * (plan.stack_size + plan.max_args));
+    RETURN_ERROR_IF(stack == NULL, MX_ERR_NO_MEMORY);
+
+    error_code = evaluate_rows_f(&plan, stack, stack + plan.stack_size, 0, n_rows, results);
+
+cleanup:
+    free(stack);
+    free_plan(&plan);
+
+    return error_code;
+}
+
+// Parallel evaluation shared by all threads of the pool.
+typedef struct batch_job {
+    batch_plan *plan;
+    void *buffers;      // evaluation stack and function arguments of each thread, of values of evaluation precision
+    size_t buffer_size; // number of values in buffer of one thread
+    size_t chunk_size;
+    size_t n_rows;
+    void *results;
+    mx_error error; // first error that occurred, remaining chunks are skipped after it
+} batch_job;
+
+static void evaluate_chunk(void *context, size_t worker, size_t index) {
+    batch_job *job = context;
+    batch_plan *plan = job->plan;
+    mx_error error_code;
+
+    if (ATOMIC_LOAD(&job->error) != MX_SUCCESS) {
+        return;
+    }
+
+    size_t begin = index * job->chunk_size;
+    size_t end = job->n_rows - begin < job->chunk_size ? job->n_rows : begin + job->chunk_size;
+
+    if (plan->single) {
+        float *buffer = (float *)job->buffers + worker * job->buffer_size;
+        error_code = evaluate_rows_f(plan, buffer, buffer + plan->stack_size, begin, end, job->results);
+    } else {
+        double *buffer = (double *)job->buffers + worker * job->buffer_size;
+        error_code = evaluate_rows(plan, buffer, buffer + plan->stack_size, begin, end, job->results);
+    }
+
+    if (error_code != MX_SUCCESS) {
+        mx_error expected = MX_SUCCESS;
+        ATOMIC_CAS(&job->error, &expected, error_code);
+    }
+}
+
+// Evaluates the plan using the pool, with results of given size written to `results`.
+static mx_error evaluate_parallel(batch_plan *plan, mx_pool *pool, size_t value_size, size_t n_rows, void *results) {
+    batch_job job;
+
+    // Buffers are rounded up to whole cache lines, so that threads do not write into the same one
+    size_t line_values = 64 / value_size;
+
+    job.plan = plan;
+    job.buffer_size = (plan->stack_size + plan->max_args + line_values - 1) / line_values * line_values;
+    job.buffers = malloc(value_size * job.buffer_size * pool_size(pool));
+    job.chunk_size = CHUNK_SIZE;
+    job.n_rows = n_rows;
+    job.results = results;
+    job.error = MX_SUCCESS;
+
+    if (job.buffers == NULL) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    // Pool indexes tasks with 32-bit integers
+    while (n_rows / job.chunk_size >= UINT32_MAX) {
+        job.chunk_size *= 2;
+    }
+
+    pool_run(pool, (n_rows + job.chunk_size - 1) / job.chunk_size, evaluate_chunk, &job);
+    free(job.buffers);
+
+    return job.error;
+}
+
+mx_error mx_program_eval_parallel(const mx_program *program, mx_pool *pool, const mx_column columns[], size_t n_columns, size_t n_rows, double results[]) {
+    mx_error error_code = MX_SUCCESS;
+    batch_plan plan;
+
+    if (pool == NULL && (pool = default_pool()) == NULL) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    error_code = create_plan(&plan, program, columns, NULL, n_columns, false, true);
+
+    if (error_code != MX_SUCCESS) {
+        return error_code;
+    }
+
+    error_code = evaluate_parallel(&plan, pool, sizeof(double), n_rows, results);
+    free_plan(&plan);
+
+    return error_code;
+}
+
+mx_error mx_program_eval_parallel_f(const mx_program *program, mx_pool *pool, const mx_column_f columns[], size_t n_columns, size_t n_rows, float results[]) {
+    mx_error error_code = MX_SUCCESS;
+    batch_plan plan;
+
+    if (pool == NULL && (pool = default_pool()) == NULL) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    error_code = create_plan(&plan, program, NULL, columns, n_columns, true, true);
+
+    if (error_code != MX_SUCCESS) {
+        return error_code;
+    }
+
+    error_code = evaluate_parallel(&plan, pool, sizeof(float), n_rows, results);
+    free_plan(&plan);
+
+    return error_code;
+}
@@ -0,0 +1,390 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+// Required for POSIX threads in strict C99 mode
+#define _DEFAULT_SOURCE
+
+#include "mathex.h"
+#include "mx_cache.h"
+#include "mx_program.h"
+#include "mx_thread.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Entries are spread over independently locked shards, so threads evaluating different expressions rarely contend.
+// Each shard evicts its entries using CLOCK algorithm: hits only set a reference bit, and a hand sweeping over entries
+// gives referenced entries a second chance, evicting the first one that was not used since the previous sweep.
+
+#define MAX_SHARDS 16
+#define INITIAL_CAPACITY 16
+
+typedef struct cache_shard cache_shard;
+
+struct cache_entry {
+    char *expression;
+    size_t length; // length of the expression, excluding NULL-terminator
+    size_t hash;
+    size_t bytes; // memory taken by the entry, including compiled program
+    mx_program *program;
+    size_t refs;        // number of users, including the shard while entry is stored in it
+    bool referenced;    // reference bit of CLOCK algorithm
+    cache_shard *shard; // shard the entry was inserted into, or NULL if it was never stored
+    cache_entry *next;  // next entry in the same bucket
+};
+
+struct cache_shard {
+    mx_mutex lock;
+    cache_entry **buckets;
+    size_t n_buckets;
+    cache_entry **ring; // stored entries in order swept by the CLOCK hand
+    size_t n_entries;
+    size_t capacity;
+    size_t hand;
+    size_t bytes;
+    size_t max_entries;
+    size_t max_bytes;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+};
+
+struct mx_cache {
+    cache_shard shards[MAX_SHARDS];
+    size_t n_shards;
+};
+
+static size_t hash_expression(const char *expression, size_t length) {
+    // FNV-1a
+    size_t hash = (size_t)14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)expression[i];
+        hash *= (size_t)1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static size_t program_bytes(const mx_program *program) {
+    size_t bytes = sizeof(mx_program);
+    bytes += program->n_tokens * sizeof(mx_token);
+    bytes += program->n_args * sizeof(int);
+    bytes += program->n_vars * sizeof(program_variable);
+
+    for (size_t i = 0; i < program->n_vars; i++) {
+        bytes += strlen(program->vars[i].name) + 1;
+    }
+
+    return bytes;
+}
+
+static void free_entry(cache_entry *entry) {
+    mx_program_free(entry->program);
+    free(entry->expression);
+    free(entry);
+}
+
+static cache_entry **find_entry(cache_shard *shard, const char *expression, size_t length, size_t hash) {
+    cache_entry **entry = &shard->buckets[(hash / MAX_SHARDS) % shard->n_buckets];
+
+    while (*entry != NULL && ((*entry)->hash != hash || (*entry)->length != length || memcmp((*entry)->expression, expression, length) != 0)) {
+        entry = &(*entry)->next;
+    }
+
+    return entry;
+}
+
+static void unlink_entry(cache_shard *shard, cache_entry *entry) {
+    cache_entry **link = find_entry(shard, entry->expression, entry->length, entry->hash);
+    *link = entry->next;
+    shard->bytes -= entry->bytes;
+
+    if (--entry->refs == 0) {
+        free_entry(entry);
+    }
+}
+
+static void evict_entry(cache_shard *shard) {
+    for (;;) {
+        if (shard->hand >= shard->n_entries) {
+            shard->hand = 0;
+        }
+
+        cache_entry *entry = shard->ring[shard->hand];
+
+        if (entry->referenced) {
+            entry->referenced = false;
+            shard->hand++;
+            continue;
+        }
+
+        // Last entry takes place of the evicted one, so the hand examines it next
+        shard->ring[shard->hand] = shard->ring[--shard->n_entries];
+        shard->evictions++;
+        unlink_entry(shard, entry);
+        return;
+    }
+}
+
+static bool reserve_entry(cache_shard *shard) {
+    if (shard->n_entries < shard->capacity) {
+        return true;
+    }
+
+    size_t capacity = 2 * shard->capacity;
+    cache_entry **ring = realloc(shard->ring, sizeof(cache_entry *) * capacity);
+
+    if (ring == NULL) {
+        return false;
+    }
+
+    shard->ring = ring;
+
+    // Keep load factor of buckets at most one
+    cache_entry **buckets = calloc(capacity, sizeof(cache_entry *));
+
+    if (buckets == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < shard->n_entries; i++) {
+        cache_entry *entry = shard->ring[i];
+        size_t index = (entry->hash / MAX_SHARDS) % capacity;
+
+        entry->next = buckets[index];
+        buckets[index] = entry;
+    }
+
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->n_buckets = capacity;
+    shard->capacity = capacity;
+
+    return true;
+}
+
+mx_cache *cache_create(size_t max_entries, size_t max_bytes) {
+    mx_cache *cache = malloc(sizeof(mx_cache));
+
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    // Number of shards is a power of two not exceeding the entry limit, so every shard can hold at least one entry
+    cache->n_shards = 1;
+
+    while (cache->n_shards < MAX_SHARDS && 2 * cache->n_shards <= max_entries) {
+        cache->n_shards *= 2;
+    }
+
+    for (size_t i = 0; i < cache->n_shards; i++) {
+        cache_shard *shard = &cache->shards[i];
+        size_t capacity = max_entries / cache->n_shards < INITIAL_CAPACITY ? max_entries / cache->n_shards : INITIAL_CAPACITY;
+
+        mutex_init(&shard->lock);
+        shard->buckets = calloc(capacity, sizeof(cache_entry *));
+        shard->n_buckets = capacity;
+        shard->ring = malloc(sizeof(cache_entry *) * capacity);
+        shard->n_entries = 0;
+        shard->capacity = capacity;
+        shard->hand = 0;
+        shard->bytes = 0;
+        shard->max_entries = max_entries / cache->n_shards;
+        shard->max_bytes = max_bytes / cache->n_shards;
+        shard->hits = 0;
+        shard->misses = 0;
+        shard->evictions = 0;
+
+        if (shard->buckets == NULL || shard->ring == NULL) {
+            cache->n_shards = i + 1;
+            cache_free(cache);
+            return NULL;
+        }
+    }
+
+    return cache;
+}
+
+mx_error cache_acquire(mx_cache *cache, const mx_config *config, const char *expression, size_t length, cache_entry **entry) {
+    size_t hash = hash_expression(expression, length);
+    cache_shard *shard = &cache->shards[hash % cache->n_shards];
+
+    mutex_lock(&shard->lock);
+    cache_entry *found = *find_entry(shard, expression, length, hash);
+
+    if (found != NULL) {
+        found->refs++;
+        found->referenced = true;
+        shard->hits++;
+    } else {
+        shard->misses++;
+    }
+
+    mutex_unlock(&shard->lock);
+
+    if (found != NULL) {
+        *entry = found;
+        return MX_SUCCESS;
+    }
+
+    // Compile without holding the lock, so other expressions of the shard can be evaluated meanwhile
+    cache_entry *new = malloc(sizeof(cache_entry));
+
+    if (new == NULL) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    new->expression = malloc(length + 1);
+
+    if (new->expression == NULL) {
+        free(new);
+        return MX_ERR_NO_MEMORY;
+    }
+
+    // Expression is compiled from the copy, since it does not have to be NULL-terminated
+    memcpy(new->expression, expression, length);
+    new->expression[length] = '\0';
+
+    mx_error error_code = mx_compile(config, new->expression, &new->program);
+
+    if (error_code != MX_SUCCESS) {
+        free(new->expression);
+        free(new);
+        return error_code;
+    }
+
+    new->length = length;
+    new->hash = hash;
+    new->bytes = sizeof(cache_entry) + length + 1 + program_bytes(new->program);
+    new->refs = 1;
+    new->referenced = false;
+    new->shard = NULL;
+    new->next = NULL;
+
+    if (new->bytes > shard->max_bytes) {
+        // Too large to be stored, only used once
+        *entry = new;
+        return MX_SUCCESS;
+    }
+
+    mutex_lock(&shard->lock);
+    cache_entry **link = find_entry(shard, expression, length, hash);
+    found = *link;
+
+    if (found != NULL) {
+        // Another thread compiled the same expression meanwhile
+        found->refs++;
+        found->referenced = true;
+    } else {
+        while (shard->n_entries > 0 && (shard->n_entries >= shard->max_entries || shard->bytes + new->bytes > shard->max_bytes)) {
+            evict_entry(shard);
+        }
+
+        if (reserve_entry(shard)) {
+            link = find_entry(shard, expression, length, hash);
+            *link = new;
+
+            new->shard = shard;
+            new->refs++;
+            shard->ring[shard->n_entries++] = new;
+            shard->bytes += new->bytes;
+        }
+    }
+
+    mutex_unlock(&shard->lock);
+
+    if (found != NULL) {
+        free_entry(new);
+        *entry = found;
+    } else {
+        *entry = new;
+    }
+
+    return MX_SUCCESS;
+}
+
+const mx_program *cache_entry_program(const cache_entry *entry) {
+    return entry->program;
+}
+
+void cache_release(cache_entry *entry) {
+    cache_shard *shard = entry->shard;
+    bool unused;
+
+    if (shard == NULL) {
+        unused = true;
+    } else {
+        mutex_lock(&shard->lock);
+        unused = --entry->refs == 0;
+        mutex_unlock(&shard->lock);
+    }
+
+    if (unused) {
+        free_entry(entry);
+    }
+}
+
+void cache_clear(mx_cache *cache) {
+    for (size_t i = 0; i < cache->n_shards; i++) {
+        cache_shard *shard = &cache->shards[i];
+        mutex_lock(&shard->lock);
+
+        while (shard->n_entries > 0) {
+            unlink_entry(shard, shard->ring[--shard->n_entries]);
+        }
+
+        shard->hand = 0;
+        mutex_unlock(&shard->lock);
+    }
+}
+
+void cache_stats(mx_cache *cache, mx_cache_stats *stats) {
+    memset(stats, 0, sizeof(mx_cache_stats));
+
+    for (size_t i = 0; i < cache->n_shards; i++) {
+        cache_shard *shard = &cache->shards[i];
+        mutex_lock(&shard->lock);
+
+        stats->hits += shard->hits;
+        stats->misses += shard->misses;
+        stats->evictions += shard->evictions;
+        stats->entries += shard->n_entries;
+        stats->bytes += shard->bytes;
+
+        mutex_unlock(&shard->lock);
+    }
+}
+
+void cache_free(mx_cache *cache) {
+    cache_clear(cache);
+
+    for (size_t i = 0; i < cache->n_shards; i++) {
+        cache_shard *shard = &cache->shards[i];
+
+        mutex_destroy(&shard->lock);
+        free(shard->buckets);
+        free(shard->ring);
+    }
+
+    free(cache);
+}
@@ -0,0 +1,56 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef MATHEX_CACHE_H
+#define MATHEX_CACHE_H
+
+#include "mathex.h"
+#include <stddef.h>
+
+// Bounded thread-safe map from expression text to compiled program.
+typedef struct mx_cache mx_cache;
+
+// Cached program that is kept alive until released.
+typedef struct cache_entry cache_entry;
+
+// Creates empty cache holding at most `max_entries` programs taking at most `max_bytes` in total. NULL if out of memory.
+mx_cache *cache_create(size_t max_entries, size_t max_bytes);
+
+// Finds compiled program for the expression of given length, compiling and inserting it if missing. Entry has to be released after use.
+mx_error cache_acquire(mx_cache *cache, const mx_config *config, const char *expression, size_t length, cache_entry **entry);
+
+// Returns compiled program of the entry.
+const mx_program *cache_entry_program(const cache_entry *entry);
+
+// Releases entry acquired with `cache_acquire`.
+void cache_release(cache_entry *entry);
+
+// Removes all programs from the cache. Programs still in use are freed once released.
+void cache_clear(mx_cache *cache);
+
+// Writes current counters of the cache.
+void cache_stats(mx_cache *cache, mx_cache_stats *stats);
+
+// Frees the cache. No entries may be in use.
+void cache_free(mx_cache *cache);
+
+#endif /* MATHEX_CACHE_H */
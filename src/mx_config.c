@@ -21,24 +21,45 @@
 */
 
 #include "mathex.h"
+#include "mx_cache.h"
+#include "mx_config.h"
+#include "mx_program.h"
 #include "mx_token.h"
 #include <ctype.h>
 #include <float.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Maximum number of seeds tried for a bucket of the frozen table before giving up on building it.
+#define MAX_SEED (1 << 20)
+
 typedef struct config_item {
     char *key;
     mx_token value;
     struct config_item *next;
 } config_item;
 
+// Item of frozen table, which stores keys contiguously in one buffer.
+typedef struct frozen_item {
+    mx_token value;
+    uint32_t offset; // offset of the key in the buffer of keys
+    uint32_t length;
+} frozen_item;
+
 struct mx_config {
     mx_flag flags;
     config_item **buckets;
     size_t n_buckets;
     size_t n_items;
+    mx_cache *cache;
+    mx_counters *counters;
+    bool frozen;
+    char *frozen_keys;
+    frozen_item *frozen_items; // minimal perfect hash table built by `mx_freeze`, replaces buckets
+    int32_t *displacements;    // seed or, if negative, position of the item for each bucket of the perfect hash
+    size_t n_displacements;
 };
 
 static size_t hash(const char *key, size_t length) {
@@ -53,7 +74,53 @@ static size_t hash(const char *key, size_t length) {
     return hash;
 }
 
+// Frozen table uses hash and displace scheme. Keys are split into buckets by upper half of their hash, and each
+// bucket gets a seed that maps all of its keys to free positions when mixed with the hash. Buckets with single key
+// store its position directly. Lookup computes hash of the name once, and then finds the only position to compare.
+
+static uint64_t frozen_hash(const char *key, size_t length) {
+    // Hashes eight bytes at a time, mixing each word with multiplication
+    const uint64_t multiplier = UINT64_C(0x9E3779B97F4A7C15);
+    uint64_t hash = (uint64_t)length * multiplier;
+    uint64_t word;
+
+    for (; length >= sizeof(word); key += sizeof(word), length -= sizeof(word)) {
+        memcpy(&word, key, sizeof(word));
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 32;
+    }
+
+    word = 0;
+    memcpy(&word, key, length);
+    hash = (hash ^ word) * multiplier;
+
+    return hash ^ (hash >> 29);
+}
+
+static size_t frozen_bucket_index(uint64_t hash, size_t n_buckets) {
+    return (size_t)(((hash >> 32) * n_buckets) >> 32);
+}
+
+static size_t frozen_position(uint64_t hash, int32_t displacement, size_t length) {
+    if (displacement < 0) {
+        return (size_t)(-(displacement + 1));
+    }
+
+    // SplitMix64 finalizer
+    uint64_t mixed = hash + (uint64_t)displacement * UINT64_C(0x9E3779B97F4A7C15);
+    mixed = (mixed ^ (mixed >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    mixed = (mixed ^ (mixed >> 27)) * UINT64_C(0x94D049BB133111EB);
+    mixed ^= mixed >> 31;
+
+    // Maps lower half of the hash into range without division
+    return (size_t)(((mixed & UINT32_MAX) * length) >> 32);
+}
+
 static mx_error insert_item(mx_config *config, const char *key, mx_token value) {
+    if (config->frozen) {
+        return MX_ERR_FROZEN;
+    }
+
     if (config->n_buckets == 0) {
         // Initialize first time
         config->n_buckets = 4;
@@ -132,25 +199,64 @@ static mx_error insert_item(mx_config *config, const char *key, mx_token value)
     return MX_SUCCESS;
 }
 
+// Cached programs were resolved against previous contents of the config, so they have to be dropped.
+static void invalidate_cache(mx_config *config) {
+    if (config->cache != NULL) {
+        cache_clear(config->cache);
+    }
+}
+
 bool read_flag(const mx_config *config, mx_flag flag) {
     return config->flags & flag;
 }
 
-mx_token *lookup_id(const mx_config *config, const char *key, size_t length) {
+mx_token *lookup_id(const mx_config *config, const char *key, size_t length, size_t *probes) {
+    if (config->frozen_items != NULL) {
+        uint64_t hash = frozen_hash(key, length);
+        int32_t displacement = config->displacements[frozen_bucket_index(hash, config->n_displacements)];
+        frozen_item *item = &config->frozen_items[frozen_position(hash, displacement, config->n_items)];
+
+        if (probes != NULL) {
+            (*probes)++;
+        }
+
+        return item->length == length && memcmp(config->frozen_keys + item->offset, key, length) == 0 ? &item->value : NULL;
+    }
+
     if (config->n_items == 0) {
         return NULL;
     }
 
     size_t index = hash(key, length) % config->n_buckets;
     config_item *item = config->buckets[index];
+    size_t compared = 0;
+
+    while (item != NULL) {
+        compared++;
+
+        // Key is not NULL-terminated, so stored key also has to end right after it
+        if (strncmp(item->key, key, length) == 0 && item->key[length] == '\0') {
+            break;
+        }
 
-    while (item != NULL && strncmp(item->key, key, length) != 0) {
         item = item->next;
     }
 
+    if (probes != NULL) {
+        *probes += compared;
+    }
+
     return item != NULL ? &item->value : NULL;
 }
 
+mx_cache *config_cache(const mx_config *config) {
+    return config->cache;
+}
+
+mx_counters *config_counters(const mx_config *config) {
+    return config->counters;
+}
+
 mx_config *mx_create(mx_flag flags) {
     mx_config *config = malloc(sizeof(mx_config));
 
@@ -159,11 +265,58 @@ mx_config *mx_create(mx_flag flags) {
         config->buckets = NULL;
         config->n_buckets = 0;
         config->n_items = 0;
+        config->cache = NULL;
+        config->counters = NULL;
+        config->frozen = false;
+        config->frozen_keys = NULL;
+        config->frozen_items = NULL;
+        config->displacements = NULL;
+        config->n_displacements = 0;
     }
 
     return config;
 }
 
+mx_config *mx_clone(const mx_config *config) {
+    mx_config *clone = mx_create(config->flags);
+
+    if (clone == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < config->n_buckets; i++) {
+        for (config_item *item = config->buckets[i]; item != NULL; item = item->next) {
+            if (insert_item(clone, item->key, item->value) != MX_SUCCESS) {
+                mx_free(clone);
+                return NULL;
+            }
+        }
+    }
+
+    for (size_t i = 0; config->frozen_items != NULL && i < config->n_items; i++) {
+        frozen_item *item = &config->frozen_items[i];
+        char *key = malloc(item->length + 1);
+
+        if (key == NULL) {
+            mx_free(clone);
+            return NULL;
+        }
+
+        memcpy(key, config->frozen_keys + item->offset, item->length);
+        key[item->length] = '\0';
+
+        mx_error error_code = insert_item(clone, key, item->value);
+        free(key);
+
+        if (error_code != MX_SUCCESS) {
+            mx_free(clone);
+            return NULL;
+        }
+    }
+
+    return clone;
+}
+
 mx_error mx_add_variable(mx_config *config, const char *name, const double *value) {
     mx_token token;
 
@@ -180,7 +333,63 @@ mx_error mx_add_variable(mx_config *config, const char *name, const double *valu
     token.type = MX_VARIABLE;
     token.d.var = value;
 
-    return insert_item(config, name, token);
+    mx_error error_code = insert_item(config, name, token);
+
+    if (error_code == MX_SUCCESS) {
+        invalidate_cache(config);
+    }
+
+    return error_code;
+}
+
+mx_error mx_add_variable_f(mx_config *config, const char *name, const float *value) {
+    mx_token token;
+
+    if (!isalpha(*name) && *name != '_') {
+        return MX_ERR_ILLEGAL_NAME;
+    }
+
+    for (const char *character = name + 1; *character; character++) {
+        if (!isalnum(*character) && *character != '_') {
+            return MX_ERR_ILLEGAL_NAME;
+        }
+    }
+
+    token.type = MX_FLOAT_VARIABLE;
+    token.d.fvar = value;
+
+    mx_error error_code = insert_item(config, name, token);
+
+    if (error_code == MX_SUCCESS) {
+        invalidate_cache(config);
+    }
+
+    return error_code;
+}
+
+mx_error mx_add_frame_variable(mx_config *config, const char *name, size_t index) {
+    mx_token token;
+
+    if (!isalpha(*name) && *name != '_') {
+        return MX_ERR_ILLEGAL_NAME;
+    }
+
+    for (const char *character = name + 1; *character; character++) {
+        if (!isalnum(*character) && *character != '_') {
+            return MX_ERR_ILLEGAL_NAME;
+        }
+    }
+
+    token.type = MX_FRAME_VARIABLE;
+    token.d.index = index;
+
+    mx_error error_code = insert_item(config, name, token);
+
+    if (error_code == MX_SUCCESS) {
+        invalidate_cache(config);
+    }
+
+    return error_code;
 }
 
 mx_error mx_add_constant(mx_config *config, const char *name, double value) {
@@ -199,12 +408,27 @@ mx_error mx_add_constant(mx_config *config, const char *name, double value) {
     token.type = MX_CONSTANT;
     token.d.number = value;
 
-    return insert_item(config, name, token);
+    mx_error error_code = insert_item(config, name, token);
+
+    if (error_code == MX_SUCCESS) {
+        invalidate_cache(config);
+    }
+
+    return error_code;
 }
 
 mx_error mx_add_function(mx_config *config, const char *name, mx_error (*apply)(double[], int, double *, void *), void *data) {
+    return mx_add_function_ex(config, name, apply, data, 0, -1, MX_FUNC_NONE);
+}
+
+// Adds function with given flags, which may include private ones.
+static mx_error add_function(mx_config *config, const char *name, mx_error (*apply)(double[], int, double *, void *), void *data, int min_args, int max_args, mx_func_flag flags) {
     mx_token token;
 
+    if (min_args < 0 || min_args > SHRT_MAX || max_args > SHRT_MAX || (max_args >= 0 && max_args < min_args)) {
+        return MX_ERR_INVALID_ARGS;
+    }
+
     if (!isalpha(*name) && *name != '_') {
         return MX_ERR_ILLEGAL_NAME;
     }
@@ -217,12 +441,68 @@ mx_error mx_add_function(mx_config *config, const char *name, mx_error (*apply)(
 
     token.type = MX_FUNCTION;
     token.d.func.call = apply;
+    token.d.func.derivative = NULL;
     token.d.func.data = data;
+    token.d.func.flags = flags;
+    token.d.func.min_args = (short)min_args;
+    token.d.func.max_args = (short)(max_args >= 0 ? max_args : -1);
+
+    mx_error error_code = insert_item(config, name, token);
+
+    if (error_code == MX_SUCCESS) {
+        invalidate_cache(config);
+    }
+
+    return error_code;
+}
+
+mx_error mx_add_function_ex(mx_config *config, const char *name, mx_error (*apply)(double[], int, double *, void *), void *data, int min_args, int max_args, mx_func_flag flags) {
+    return add_function(config, name, apply, data, min_args, max_args, (mx_func_flag)(flags & PUBLIC_FUNC_FLAGS));
+}
 
-    return insert_item(config, name, token);
+mx_error mx_add_function_f(mx_config *config, const char *name, mx_error (*apply)(float[], int, float *, void *), void *data, int min_args, int max_args, mx_func_flag flags) {
+    // Function is stored like any other, its flag tells callers to convert the pointer back before calling it
+    mx_error (*call)(double[], int, double *, void *) = (mx_error(*)(double[], int, double *, void *))(void (*)(void))apply;
+    return add_function(config, name, call, data, min_args, max_args, (mx_func_flag)((flags & PUBLIC_FUNC_FLAGS) | FUNC_SINGLE));
+}
+
+mx_error mx_set_function_flags(mx_config *config, const char *name, mx_func_flag flags) {
+    if (config->frozen) {
+        return MX_ERR_FROZEN;
+    }
+
+    mx_token *token = lookup_id(config, name, strlen(name), NULL);
+
+    if (token == NULL || token->type != MX_FUNCTION) {
+        return MX_ERR_UNDEFINED;
+    }
+
+    token->d.func.flags = (mx_func_flag)((flags & PUBLIC_FUNC_FLAGS) | (token->d.func.flags & FUNC_SINGLE));
+    invalidate_cache(config);
+    return MX_SUCCESS;
+}
+
+mx_error mx_set_function_derivative(mx_config *config, const char *name, mx_error (*derivative)(double[], int, double[], void *)) {
+    if (config->frozen) {
+        return MX_ERR_FROZEN;
+    }
+
+    mx_token *token = lookup_id(config, name, strlen(name), NULL);
+
+    if (token == NULL || token->type != MX_FUNCTION) {
+        return MX_ERR_UNDEFINED;
+    }
+
+    token->d.func.derivative = derivative;
+    invalidate_cache(config);
+    return MX_SUCCESS;
 }
 
 mx_error mx_remove(mx_config *config, const char *name) {
+    if (config->frozen) {
+        return MX_ERR_FROZEN;
+    }
+
     if (config->n_items == 0) {
         return MX_ERR_UNDEFINED;
     }
@@ -232,7 +512,7 @@ mx_error mx_remove(mx_config *config, const char *name) {
     config_item *prev = NULL;
     config_item *item = config->buckets[index];
 
-    while (item != NULL && strncmp(item->key, name, length) != 0) {
+    while (item != NULL && strcmp(item->key, name) != 0) {
         prev = item;
         item = item->next;
     }
@@ -249,9 +529,251 @@ mx_error mx_remove(mx_config *config, const char *name) {
 
     free(item->key);
     free(item);
+    invalidate_cache(config);
     return MX_SUCCESS;
 }
 
+// Bucket of keys of the frozen table that is being built.
+typedef struct frozen_bucket {
+    size_t index;
+    size_t size;
+} frozen_bucket;
+
+static int compare_buckets(const void *a, const void *b) {
+    size_t size_a = ((const frozen_bucket *)a)->size;
+    size_t size_b = ((const frozen_bucket *)b)->size;
+
+    // Larger buckets first, since they are harder to place
+    return (size_a < size_b) - (size_a > size_b);
+}
+
+mx_error mx_freeze(mx_config *config) {
+    mx_error error_code = MX_SUCCESS;
+    size_t n_keys = 0;
+    size_t keys_length = 0;
+
+    if (config->frozen) {
+        return MX_SUCCESS;
+    }
+
+    config->frozen = true;
+
+    for (size_t i = 0; i < config->n_buckets; i++) {
+        for (config_item *item = config->buckets[i]; item != NULL; item = item->next) {
+            n_keys++;
+            keys_length += strlen(item->key);
+        }
+    }
+
+    // Positions and offsets have to fit into 32 bits, otherwise chained table is kept
+    if (n_keys == 0 || n_keys > INT32_MAX || keys_length > UINT32_MAX) {
+        return MX_SUCCESS;
+    }
+
+    size_t n_displacements = n_keys / 2 + 1;
+    config_item **items = malloc(sizeof(config_item *) * n_keys);
+    uint64_t *hashes = malloc(sizeof(uint64_t) * n_keys);
+    size_t *positions = malloc(sizeof(size_t) * n_keys);
+    size_t *order = malloc(sizeof(size_t) * n_keys); // indices of items grouped by bucket
+    size_t *starts = calloc(n_displacements + 1, sizeof(size_t));
+    frozen_bucket *buckets = malloc(sizeof(frozen_bucket) * n_displacements);
+    bool *taken = calloc(n_keys, sizeof(bool));
+    int32_t *displacements = calloc(n_displacements, sizeof(int32_t));
+    frozen_item *table = malloc(sizeof(frozen_item) * n_keys);
+    char *keys = malloc(keys_length + 1);
+
+    RETURN_ERROR_IF(items == NULL || hashes == NULL || positions == NULL || order == NULL || starts == NULL, MX_ERR_NO_MEMORY);
+    RETURN_ERROR_IF(buckets == NULL || taken == NULL || displacements == NULL || table == NULL || keys == NULL, MX_ERR_NO_MEMORY);
+
+    size_t n_items = 0;
+
+    for (size_t i = 0; i < config->n_buckets; i++) {
+        for (config_item *item = config->buckets[i]; item != NULL; item = item->next) {
+            hashes[n_items] = frozen_hash(item->key, strlen(item->key));
+            items[n_items++] = item;
+        }
+    }
+
+    for (size_t i = 0; i < n_displacements; i++) {
+        buckets[i].index = i;
+        buckets[i].size = 0;
+    }
+
+    for (size_t i = 0; i < n_keys; i++) {
+        starts[frozen_bucket_index(hashes[i], n_displacements) + 1]++;
+    }
+
+    for (size_t i = 0; i < n_displacements; i++) {
+        starts[i + 1] += starts[i];
+    }
+
+    for (size_t i = 0; i < n_keys; i++) {
+        size_t index = frozen_bucket_index(hashes[i], n_displacements);
+        order[starts[index] + buckets[index].size++] = i;
+    }
+
+    qsort(buckets, n_displacements, sizeof(frozen_bucket), compare_buckets);
+    size_t free_position = 0;
+
+    for (size_t i = 0; i < n_displacements && buckets[i].size > 0; i++) {
+        const frozen_bucket *bucket = &buckets[i];
+        const size_t *members = order + starts[bucket->index];
+
+        if (bucket->size == 1) {
+            while (taken[free_position]) {
+                free_position++;
+            }
+
+            taken[free_position] = true;
+            positions[members[0]] = free_position;
+            displacements[bucket->index] = -(int32_t)free_position - 1;
+            continue;
+        }
+
+        int32_t seed;
+
+        for (seed = 0; seed < MAX_SEED; seed++) {
+            size_t placed;
+
+            for (placed = 0; placed < bucket->size; placed++) {
+                size_t position = frozen_position(hashes[members[placed]], seed, n_keys);
+
+                if (taken[position]) {
+                    break;
+                }
+
+                taken[position] = true;
+                positions[members[placed]] = position;
+            }
+
+            if (placed == bucket->size) {
+                break;
+            }
+
+            while (placed-- > 0) {
+                taken[positions[members[placed]]] = false;
+            }
+        }
+
+        if (seed == MAX_SEED) {
+            // Keys with identical hashes cannot be separated. This is not an error: configuration stays frozen and
+            // lookups keep using the chained table, so cleanup is reached with `error_code` still `MX_SUCCESS`.
+            goto cleanup;
+        }
+
+        displacements[bucket->index] = seed;
+    }
+
+    size_t offset = 0;
+
+    for (size_t i = 0; i < n_keys; i++) {
+        frozen_item *item = &table[positions[i]];
+
+        size_t length = strlen(items[i]->key);
+
+        item->value = items[i]->value;
+        item->offset = (uint32_t)offset;
+        item->length = (uint32_t)length;
+
+        memcpy(keys + offset, items[i]->key, length);
+        offset += length;
+
+        free(items[i]->key);
+        free(items[i]);
+    }
+
+    free(config->buckets);
+    config->buckets = NULL;
+    config->n_buckets = 0;
+    config->n_items = n_keys;
+    config->frozen_keys = keys;
+    config->frozen_items = table;
+    config->displacements = displacements;
+    config->n_displacements = n_displacements;
+
+    keys = NULL;
+    table = NULL;
+    displacements = NULL;
+
+cleanup:
+    if (error_code != MX_SUCCESS) {
+        config->frozen = false;
+    }
+
+    free(items);
+    free(hashes);
+    free(positions);
+    free(order);
+    free(starts);
+    free(buckets);
+    free(taken);
+    free(displacements);
+    free(table);
+    free(keys);
+
+    return error_code;
+}
+
+mx_error mx_enable_cache(mx_config *config, size_t max_entries, size_t max_bytes) {
+    mx_cache *cache = NULL;
+
+    if (max_entries > 0) {
+        cache = cache_create(max_entries, max_bytes);
+
+        if (cache == NULL) {
+            return MX_ERR_NO_MEMORY;
+        }
+    }
+
+    if (config->cache != NULL) {
+        cache_free(config->cache);
+    }
+
+    config->cache = cache;
+    return MX_SUCCESS;
+}
+
+void mx_get_cache_stats(const mx_config *config, mx_cache_stats *stats) {
+    if (config->cache != NULL) {
+        cache_stats(config->cache, stats);
+    } else {
+        memset(stats, 0, sizeof(mx_cache_stats));
+    }
+}
+
+mx_error mx_enable_stats(mx_config *config, mx_stats_flag flags) {
+    mx_counters *counters = NULL;
+
+#ifndef HAVE_CYCLE_COUNTER
+    if (flags & MX_STATS_TIMING) {
+        return MX_ERR_NOT_SUPPORTED;
+    }
+#endif
+
+    if (flags != MX_STATS_NONE) {
+        counters = counters_create(flags & MX_STATS_TIMING);
+
+        if (counters == NULL) {
+            return MX_ERR_NO_MEMORY;
+        }
+    }
+
+    if (config->counters != NULL) {
+        counters_free(config->counters);
+    }
+
+    config->counters = counters;
+    return MX_SUCCESS;
+}
+
+void mx_get_stats(const mx_config *config, mx_stats *stats) {
+    if (config->counters != NULL) {
+        counters_read(config->counters, stats);
+    } else {
+        memset(stats, 0, sizeof(mx_stats));
+    }
+}
+
 void mx_free(mx_config *config) {
     for (size_t i = 0; i < config->n_buckets; i++) {
         config_item *item = config->buckets[i];
@@ -265,6 +787,17 @@ void mx_free(mx_config *config) {
         }
     }
 
+    if (config->cache != NULL) {
+        cache_free(config->cache);
+    }
+
+    if (config->counters != NULL) {
+        counters_free(config->counters);
+    }
+
     free(config->buckets);
+    free(config->frozen_keys);
+    free(config->frozen_items);
+    free(config->displacements);
     free(config);
 }
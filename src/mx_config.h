@@ -24,6 +24,8 @@
 #define MATHEX_CONFIG_H
 
 #include "mathex.h"
+#include "mx_cache.h"
+#include "mx_stats.h"
 #include "mx_token.h"
 #include <stdbool.h>
 
@@ -31,6 +33,13 @@
 bool read_flag(const mx_config *config, mx_flag flag);
 
 // Lookup given string slice among inserted variables, functions or operators. NULL if not found.
-mx_token *lookup_id(const mx_config *config, const char *name, size_t length);
+// Adds number of compared entries to `probes`, unless it is NULL.
+mx_token *lookup_id(const mx_config *config, const char *name, size_t length, size_t *probes);
+
+// Returns cache of compiled expressions, or NULL if it is disabled.
+mx_cache *config_cache(const mx_config *config);
+
+// Returns statistics of the config, or NULL if they are disabled.
+mx_counters *config_counters(const mx_config *config);
 
 #endif /* MATHEX_CONFIG_H */
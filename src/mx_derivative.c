@@ -0,0 +1,505 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "mathex.h"
+#include "mx_program.h"
+#include "mx_token.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Value of the variable token, read from the frame if it is a frame variable.
+static double input_value(const mx_token *token, const double frame[]) {
+    return token->type == MX_FRAME_VARIABLE ? frame[token->d.index] : variable_value(token);
+}
+
+// Partial derivatives of built-in binary operator with respect to both operands, given the result of the operation.
+static void binary_partials(mx_opcode op, double a, double b, double value, double *da, double *db) {
+    switch (op) {
+    case MX_OP_ADD: {
+        *da = 1;
+        *db = 1;
+    } break;
+
+    case MX_OP_SUB: {
+        *da = 1;
+        *db = -1;
+    } break;
+
+    case MX_OP_MUL: {
+        *da = b;
+        *db = a;
+    } break;
+
+    case MX_OP_DIV: {
+        *da = 1 / b;
+        *db = -value / b;
+    } break;
+
+    case MX_OP_POW: {
+        // Zero exponent makes power constant, and zero base is treated as limit from positive side
+        *da = b == 0 ? 0 : b * pow(a, b - 1);
+        *db = a == 0 ? 0 : value * log(a);
+    } break;
+
+    case MX_OP_MOD: {
+        *da = 1;
+        *db = -trunc(a / b);
+    } break;
+
+    case MX_OP_MIN:
+    case MX_OP_MAX: {
+        // Derivative follows the operand that was chosen, which is the first one if they are equal
+        *da = value == a || isnan(b) ? 1 : 0;
+        *db = 1 - *da;
+    } break;
+
+    default: {
+        *da = NAN;
+        *db = NAN;
+    } break;
+    }
+}
+
+// Derivative of built-in unary operator, given its operand and the result of the operation.
+static double unary_partial(mx_opcode op, double a, double value) {
+    double partial;
+
+    switch (op) {
+    case MX_OP_NEG: {
+        partial = -1;
+    } break;
+
+    case MX_OP_SIN: {
+        partial = cos(a);
+    } break;
+
+    case MX_OP_COS: {
+        partial = -sin(a);
+    } break;
+
+    case MX_OP_EXP: {
+        partial = value;
+    } break;
+
+    case MX_OP_LOG: {
+        partial = 1 / a;
+    } break;
+
+    case MX_OP_SQRT: {
+        partial = 0.5 / value;
+    } break;
+
+    case MX_OP_ABS: {
+        partial = a > 0 ? 1 : a < 0 ? -1 : 0;
+    } break;
+
+    case MX_OP_FLOOR:
+    case MX_OP_CEIL: {
+        partial = 0;
+    } break;
+
+    default: {
+        partial = 1;
+    } break;
+    }
+
+    return partial;
+}
+
+// Calls the function and its derivative. Both get their own copy of arguments, since functions are allowed to modify them.
+static mx_error call_with_partials(const mx_token *token, const double args[], int args_num, double *value, double partials[], double scratch[]) {
+    mx_error error_code;
+
+    if (token->d.func.derivative == NULL) {
+        return MX_ERR_NOT_SUPPORTED;
+    }
+
+    memcpy(scratch, args, sizeof(double) * (size_t)args_num);
+    error_code = token->d.func.derivative(args_num > 0 ? scratch : NULL, args_num, partials, token->d.func.data);
+
+    if (error_code != MX_SUCCESS) {
+        return error_code;
+    }
+
+    memcpy(scratch, args, sizeof(double) * (size_t)args_num);
+    return call_function(token, args_num > 0 ? scratch : NULL, args_num, value);
+}
+
+static size_t max_args(const mx_program *program) {
+    size_t result = 1;
+
+    for (size_t i = 0; i < program->n_args; i++) {
+        if ((size_t)program->args[i] > result) {
+            result = (size_t)program->args[i];
+        }
+    }
+
+    return result;
+}
+
+// Finds which of the names each variable of the program has, or SIZE_MAX if none of them.
+static size_t *find_targets(const mx_program *program, const char *const names[], size_t n_names) {
+    size_t *targets = malloc(sizeof(size_t) * (program->n_vars + 1));
+
+    if (targets == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < program->n_vars; i++) {
+        targets[i] = SIZE_MAX;
+
+        for (size_t j = 0; j < n_names; j++) {
+            if (strcmp(program->vars[i].name, names[j]) == 0) {
+                targets[i] = j;
+                break;
+            }
+        }
+    }
+
+    return targets;
+}
+
+// Index of the name the variable token is differentiated with respect to, or SIZE_MAX if it is not.
+static size_t token_target(const mx_program *program, const size_t targets[], const mx_token *token) {
+    for (size_t i = 0; i < program->n_vars; i++) {
+        if (targets[i] != SIZE_MAX && same_variable(&program->vars[i], token)) {
+            return targets[i];
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+mx_error mx_program_eval_derivative(const mx_program *program, const double frame[], const char *name, double *result, double *derivative) {
+    mx_error error_code = MX_SUCCESS;
+    size_t size = program->depth + program->n_slots;
+    size_t n_args = max_args(program);
+    const int *args = program->args;
+    size_t top = 0;
+
+    if (program->frame_size > 0 && frame == NULL) {
+        return MX_ERR_UNDEFINED;
+    }
+
+    // Each value on the stack is paired with its derivative, stored in the same position of `tangents`
+    size_t *targets = find_targets(program, &name, 1);
+    double *values = malloc(sizeof(double) * (2 * size + 2 * n_args));
+    RETURN_ERROR_IF(targets == NULL || values == NULL, MX_ERR_NO_MEMORY);
+
+    double *tangents = values + size;
+    double *partials = tangents + size;
+    double *scratch = partials + n_args;
+    double *slots = values + program->depth;
+    double *slot_tangents = tangents + program->depth;
+
+    for (size_t i = 0; i < program->n_tokens; i++) {
+        mx_token token = program->tokens[i];
+
+        switch (token.type) {
+        case MX_CONSTANT: {
+            values[top] = token.d.number;
+            tangents[top++] = 0;
+        } break;
+
+        case MX_VARIABLE:
+        case MX_FLOAT_VARIABLE:
+        case MX_FRAME_VARIABLE: {
+            values[top] = input_value(&token, frame);
+            tangents[top++] = token_target(program, targets, &token) != SIZE_MAX ? 1 : 0;
+        } break;
+
+        case MX_BINARY_OPERATOR: {
+            top--;
+            double a = values[top - 1], b = values[top];
+            double ta = tangents[top - 1], tb = tangents[top];
+            double value = token.d.biop.call(a, b);
+            double da, db;
+
+            // Operands that do not depend on the variable are skipped, so that their undefined partials do not matter.
+            // Operands with zero partial are skipped as well, so that their undefined tangents do not matter either.
+            if (ta != 0 || tb != 0) {
+                binary_partials(token.d.biop.op, a, b, value, &da, &db);
+                tangents[top - 1] = (ta != 0 && da != 0 ? da * ta : 0) + (tb != 0 && db != 0 ? db * tb : 0);
+            }
+
+            values[top - 1] = value;
+        } break;
+
+        case MX_UNARY_OPERATOR: {
+            double a = values[top - 1];
+            double value = token.d.unop.call(a);
+
+            if (tangents[top - 1] != 0) {
+                double partial = unary_partial(token.d.unop.op, a, value);
+                tangents[top - 1] = partial != 0 ? partial * tangents[top - 1] : 0;
+            }
+
+            values[top - 1] = value;
+        } break;
+
+        case MX_STORE: {
+            slots[token.d.slot] = values[top - 1];
+            slot_tangents[token.d.slot] = tangents[top - 1];
+        } break;
+
+        case MX_LOAD: {
+            values[top] = slots[token.d.slot];
+            tangents[top++] = slot_tangents[token.d.slot];
+        } break;
+
+        case MX_FUNCTION: {
+            int args_num = *args++;
+            bool dependent = false;
+            double value;
+
+            top -= (size_t)args_num;
+
+            for (size_t j = 0; j < (size_t)args_num; j++) {
+                dependent = dependent || tangents[top + j] != 0;
+            }
+
+            if (dependent) {
+                error_code = call_with_partials(&token, &values[top], args_num, &value, partials, scratch);
+            } else {
+                error_code = call_function(&token, args_num > 0 ? &values[top] : NULL, args_num, &value);
+            }
+
+            if (error_code != MX_SUCCESS) {
+                goto cleanup;
+            }
+
+            double tangent = 0;
+
+            for (size_t j = 0; dependent && j < (size_t)args_num; j++) {
+                tangent += tangents[top + j] != 0 && partials[j] != 0 ? partials[j] * tangents[top + j] : 0;
+            }
+
+            values[top] = value;
+            tangents[top++] = tangent;
+        } break;
+
+        default: {
+        } break;
+        }
+    }
+
+    if (result != NULL) {
+        *result = values[0];
+    }
+
+    *derivative = tangents[0];
+
+cleanup:
+    free(targets);
+    free(values);
+
+    return error_code;
+}
+
+mx_error mx_program_eval_gradient(const mx_program *program, const double frame[], const char *const names[], size_t n_names, double *result, double gradient[]) {
+    mx_error error_code = MX_SUCCESS;
+    size_t size = program->depth + program->n_slots;
+    size_t n_tokens = program->n_tokens;
+    size_t n_args = max_args(program);
+    const int *args = program->args;
+    size_t top = 0;
+    size_t n_edges = 0;
+
+    if (program->frame_size > 0 && frame == NULL) {
+        return MX_ERR_UNDEFINED;
+    }
+
+    // Tape records partial derivative of each operation with respect to each of its operands that depend on
+    // any of the variables, as edges to tokens that produced the operands. Every operand is produced once,
+    // so there are at most as many edges as tokens. Loaded temporary values point to token that produced them.
+    size_t *targets = find_targets(program, names, n_names);
+    double *values = malloc(sizeof(double) * (size + 2 * n_args + 2 * n_tokens));
+    size_t *indices = malloc(sizeof(size_t) * (size + 3 * n_tokens + 1));
+    bool *active = malloc(sizeof(bool) * n_tokens);
+    RETURN_ERROR_IF(targets == NULL || values == NULL || indices == NULL || active == NULL, MX_ERR_NO_MEMORY);
+
+    double *partials = values + size;
+    double *scratch = partials + n_args;
+    double *edge_partials = scratch + n_args;
+    double *adjoints = edge_partials + n_tokens;
+    double *slots = values + program->depth;
+
+    size_t *producers = indices; // token that produced each value on the stack
+    size_t *slot_producers = producers + program->depth;
+    size_t *node_targets = indices + size;
+    size_t *edge_nodes = node_targets + n_tokens;
+    size_t *edge_start = edge_nodes + n_tokens;
+
+    for (size_t i = 0; i < n_tokens; i++) {
+        mx_token token = program->tokens[i];
+
+        edge_start[i] = n_edges;
+        node_targets[i] = SIZE_MAX;
+        active[i] = false;
+
+        switch (token.type) {
+        case MX_CONSTANT: {
+            values[top] = token.d.number;
+            producers[top++] = i;
+        } break;
+
+        case MX_VARIABLE:
+        case MX_FLOAT_VARIABLE:
+        case MX_FRAME_VARIABLE: {
+            node_targets[i] = token_target(program, targets, &token);
+            active[i] = node_targets[i] != SIZE_MAX;
+
+            values[top] = input_value(&token, frame);
+            producers[top++] = i;
+        } break;
+
+        case MX_BINARY_OPERATOR: {
+            top--;
+            size_t na = producers[top - 1], nb = producers[top];
+            double a = values[top - 1], b = values[top];
+            double value = token.d.biop.call(a, b);
+            double da, db;
+
+            active[i] = active[na] || active[nb];
+
+            if (active[i]) {
+                binary_partials(token.d.biop.op, a, b, value, &da, &db);
+
+                if (active[na]) {
+                    edge_nodes[n_edges] = na;
+                    edge_partials[n_edges++] = da;
+                }
+
+                if (active[nb]) {
+                    edge_nodes[n_edges] = nb;
+                    edge_partials[n_edges++] = db;
+                }
+            }
+
+            values[top - 1] = value;
+            producers[top - 1] = i;
+        } break;
+
+        case MX_UNARY_OPERATOR: {
+            size_t na = producers[top - 1];
+            active[i] = active[na];
+
+            double a = values[top - 1];
+            double value = token.d.unop.call(a);
+
+            if (active[i]) {
+                edge_nodes[n_edges] = na;
+                edge_partials[n_edges++] = unary_partial(token.d.unop.op, a, value);
+            }
+
+            values[top - 1] = value;
+            producers[top - 1] = i;
+        } break;
+
+        case MX_STORE: {
+            slots[token.d.slot] = values[top - 1];
+            slot_producers[token.d.slot] = producers[top - 1];
+        } break;
+
+        case MX_LOAD: {
+            values[top] = slots[token.d.slot];
+            producers[top++] = slot_producers[token.d.slot];
+        } break;
+
+        case MX_FUNCTION: {
+            int args_num = *args++;
+            double value;
+
+            top -= (size_t)args_num;
+
+            for (size_t j = 0; j < (size_t)args_num; j++) {
+                active[i] = active[i] || active[producers[top + j]];
+            }
+
+            if (active[i]) {
+                error_code = call_with_partials(&token, &values[top], args_num, &value, partials, scratch);
+            } else {
+                error_code = call_function(&token, args_num > 0 ? &values[top] : NULL, args_num, &value);
+            }
+
+            if (error_code != MX_SUCCESS) {
+                goto cleanup;
+            }
+
+            for (size_t j = 0; active[i] && j < (size_t)args_num; j++) {
+                if (active[producers[top + j]]) {
+                    edge_nodes[n_edges] = producers[top + j];
+                    edge_partials[n_edges++] = partials[j];
+                }
+            }
+
+            values[top] = value;
+            producers[top++] = i;
+        } break;
+
+        default: {
+        } break;
+        }
+    }
+
+    edge_start[n_tokens] = n_edges;
+
+    if (result != NULL) {
+        *result = values[0];
+    }
+
+    for (size_t j = 0; j < n_names; j++) {
+        gradient[j] = 0;
+    }
+
+    for (size_t i = 0; i < n_tokens; i++) {
+        adjoints[i] = 0;
+    }
+
+    // Operands are always produced by earlier tokens, so adjoint of each token is complete when it is reached
+    adjoints[producers[0]] = 1;
+
+    for (size_t i = n_tokens; i-- > 0;) {
+        if (!active[i] || adjoints[i] == 0) {
+            continue;
+        }
+
+        for (size_t e = edge_start[i]; e < edge_start[i + 1]; e++) {
+            adjoints[edge_nodes[e]] += adjoints[i] * edge_partials[e];
+        }
+
+        if (node_targets[i] != SIZE_MAX) {
+            gradient[node_targets[i]] += adjoints[i];
+        }
+    }
+
+cleanup:
+    free(targets);
+    free(values);
+    free(indices);
+    free(active);
+
+    return error_code;
+}
@@ -21,12 +21,14 @@
 */
 
 #include "mathex.h"
+#include "mx_cache.h"
 #include "mx_config.h"
+#include "mx_number.h"
+#include "mx_program.h"
+#include "mx_stats.h"
 #include "mx_token.h"
 #include "structures.h"
 #include <ctype.h>
-#include <float.h>
-#include <math.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,139 +37,127 @@
 #define UNARY_OPERATOR_ORDER (last_token == MX_EMPTY || last_token == MX_LEFT_PAREN || last_token == MX_COMMA || last_token == MX_UNARY_OPERATOR)
 #define BINARY_OPERATOR_ORDER (last_token == MX_CONSTANT || last_token == MX_VARIABLE || last_token == MX_RIGHT_PAREN)
 
-#define RETURN_ERROR(error) \
-    do {                    \
-        error_code = error; \
-        goto cleanup;       \
-    } while (0)
-
-#define RETURN_ERROR_IF(condition, error) \
-    do {                                  \
-        if (condition) {                  \
-            RETURN_ERROR(error);          \
-        }                                 \
-    } while (0)
-
-typedef enum conversion_state {
-    INTEGER_PART,  // Integer portion of decimal fraction. (before decimal point)
-    FRACTION_PART, // Fractional portion of decimal fraction. (after decimal point)
-    EXP_START,     // Separator of mantissa and exponent in scientific notation. (including sign)
-    EXP_VALUE,     // Exponent of scientific notation.
-} conversion_state;
+// Number of values that fit on evaluation stack without allocating memory.
+#define LOCAL_STACK_SIZE 64
 
-mx_error mx_evaluate(const mx_config *config, const char *expression, double *result) {
-    // https://en.wikipedia.org/wiki/Shunting_yard_algorithm#The_algorithm_in_detail
+struct mx_workspace {
+    token_stack *ops_stack;
+    token_queue *out_queue;
+    int_stack *arg_stack;
+    int_queue *arg_queue;
 
-    mx_error error_code = MX_SUCCESS;
-    mx_token_type last_token = MX_EMPTY;
+    mx_program program; // last evaluated expression
+    size_t tokens_capacity;
+    size_t args_capacity;
 
-    token_stack *ops_stack = token_stack_create();
-    token_queue *out_queue = token_queue_create();
-    double_stack *res_stack = double_stack_create();
+    double *stack; // evaluation stack
+    size_t stack_capacity;
+};
 
-    int arg_count = 0;
-    int_stack *arg_stack = int_stack_create();
-    int_queue *arg_queue = int_queue_create();
-
-    for (const char *character = expression; *character; character++) {
-        if (*character == ' ') {
-            continue;
+static bool add_variable(mx_program *program, const char *name, size_t length, const mx_token *token) {
+    for (size_t i = 0; i < program->n_vars; i++) {
+        if (strlen(program->vars[i].name) == length && strncmp(program->vars[i].name, name, length) == 0) {
+            return true;
         }
+    }
 
-        if (isdigit(*character) || *character == '.') {
-            // Two operands in a row are not allowed
-            // Operand should only either be first in expression or right after operator
-            RETURN_ERROR_IF(!OPERAND_ORDER, MX_ERR_SYNTAX);
+    program_variable *vars = realloc(program->vars, sizeof(program_variable) * (program->n_vars + 1));
 
-            if (arg_count == 0) {
-                arg_count++;
-            }
+    if (vars == NULL) {
+        return false;
+    }
 
-            double value = 0;
-            double decimal_place = 10;
-            double exponent = 0;
-            bool exponent_sign = true;
+    program->vars = vars;
 
-            conversion_state state = INTEGER_PART;
-            const char *last_character;
+    char *name_buff = malloc(length + 1);
 
-            for (last_character = character; *last_character; last_character++) {
-                switch (state) {
-                case INTEGER_PART: {
-                    if (isdigit(*last_character)) {
-                        value = (value * 10) + (double)(*last_character - '0');
-                        continue;
-                    }
+    if (name_buff == NULL) {
+        return false;
+    }
 
-                    if (*last_character == '.') {
-                        state = FRACTION_PART;
-                        continue;
-                    }
+    memcpy(name_buff, name, length);
+    name_buff[length] = '\0';
 
-                    if ((*last_character == 'e' || *last_character == 'E') && read_flag(config, MX_SCI_NOTATION)) {
-                        state = EXP_START;
-                        continue;
-                    }
-                } break;
+    program->vars[program->n_vars].name = name_buff;
+    program->vars[program->n_vars].value = token->type == MX_VARIABLE ? (const void *)token->d.var : token->type == MX_FLOAT_VARIABLE ? (const void *)token->d.fvar : NULL;
+    program->vars[program->n_vars].index = token->type == MX_FRAME_VARIABLE ? token->d.index : 0;
+    program->n_vars++;
 
-                case FRACTION_PART: {
-                    RETURN_ERROR_IF(*last_character == '.', MX_ERR_SYNTAX);
+    return true;
+}
 
-                    if (isdigit(*last_character)) {
-                        value += (double)(*last_character - '0') / decimal_place;
-                        decimal_place *= 10;
-                        continue;
-                    }
+// Number of times structures of the workspace allocated memory.
+static size_t workspace_allocations(const mx_workspace *workspace) {
+    return token_stack_allocations(workspace->ops_stack) + token_queue_allocations(workspace->out_queue) + int_stack_allocations(workspace->arg_stack) + int_queue_allocations(workspace->arg_queue);
+}
 
-                    if ((*last_character == 'e' || *last_character == 'E') && read_flag(config, MX_SCI_NOTATION)) {
-                        state = EXP_START;
-                        continue;
-                    }
-                } break;
+// Checks whether function accepts given number of arguments.
+static inline bool accepts_args(const mx_token *function, int args_num) {
+    return args_num >= function->d.func.min_args && (function->d.func.max_args < 0 || args_num <= function->d.func.max_args);
+}
 
-                case EXP_START: {
-                    RETURN_ERROR_IF(*last_character == '.', MX_ERR_SYNTAX);
+// Writes call to the function into the output. Built-in functions are written as operators they are compiled into.
+static bool enqueue_call(token_queue *out_queue, int_queue *arg_queue, const mx_token *function, int args_num) {
+    const mx_token *op = builtin_operator(function);
 
-                    if (isdigit(*last_character)) {
-                        exponent = (exponent * 10) + (double)(*last_character - '0');
-                        state = EXP_VALUE;
-                        continue;
-                    }
+    if (op == NULL) {
+        return token_queue_enqueue(out_queue, *function) && int_queue_enqueue(arg_queue, args_num);
+    }
 
-                    if (*last_character == '+' || *last_character == '-') {
-                        exponent_sign = (*last_character == '+');
-                        state = EXP_VALUE;
-                        continue;
-                    }
-                } break;
+    // Binary operator is applied once for each argument after the first one
+    for (int i = op->type == MX_BINARY_OPERATOR ? 1 : 0; i < args_num; i++) {
+        if (!token_queue_enqueue(out_queue, *op)) {
+            return false;
+        }
+    }
 
-                case EXP_VALUE: {
-                    RETURN_ERROR_IF(*last_character == '.', MX_ERR_SYNTAX);
+    return true;
+}
 
-                    if (isdigit(*last_character)) {
-                        exponent = (exponent * 10) + (double)(*last_character - '0');
-                        state = EXP_VALUE;
-                        continue;
-                    }
-                } break;
-                }
+// Converts expression into postfix notation, leaving tokens in `out_queue` and argument counts in `arg_queue` of the workspace.
+// Expression of given length does not have to be NULL-terminated.
+// Records variables used by the expression into `program`, unless it is NULL. Counts parsing into `stats`, unless it is NULL.
+static mx_error parse(const mx_config *config, const char *expression, size_t length, mx_workspace *workspace, mx_program *program, mx_stats *stats) {
+    // https://en.wikipedia.org/wiki/Shunting_yard_algorithm#The_algorithm_in_detail
 
-                // If reached here means number literal has ended
-                break;
-            }
+    mx_error error_code = MX_SUCCESS;
+    mx_token_type last_token = MX_EMPTY;
+    const char *expression_end = expression + length;
 
-            // Cannot have scientific notation separator without specifying exponent
-            if (state == EXP_START) {
-                last_character--;
-            }
+    token_stack *ops_stack = workspace->ops_stack;
+    token_queue *out_queue = workspace->out_queue;
+
+    int arg_count = 0;
+    int_stack *arg_stack = workspace->arg_stack;
+    int_queue *arg_queue = workspace->arg_queue;
+
+    size_t lookups = 0;
+    size_t probes = 0;
+    size_t allocations = workspace_allocations(workspace);
 
-            // ".1" => 0.1 and "1." => 1.0 but "." != 0.0
-            RETURN_ERROR_IF(last_character - character == 1 && *character == '.', MX_ERR_SYNTAX);
+    token_stack_clear(ops_stack);
+    token_queue_clear(out_queue);
+    int_stack_clear(arg_stack);
+    int_queue_clear(arg_queue);
 
-            if (exponent != 0) {
-                value *= pow(exponent_sign ? 10.0 : 0.1, exponent);
+    for (const char *character = expression; character < expression_end; character++) {
+        if (*character == ' ') {
+            continue;
+        }
+
+        if (isdigit(*character) || *character == '.') {
+            // Two operands in a row are not allowed
+            // Operand should only either be first in expression or right after operator
+            RETURN_ERROR_IF(!OPERAND_ORDER, MX_ERR_SYNTAX);
+
+            if (arg_count == 0) {
+                arg_count++;
             }
 
+            double value;
+            const char *last_character = scan_number(character, expression_end, read_flag(config, MX_SCI_NOTATION), &value);
+            RETURN_ERROR_IF(last_character == NULL, MX_ERR_SYNTAX);
+
             mx_token token = {.type = MX_CONSTANT, .d.number = value};
             RETURN_ERROR_IF(!token_queue_enqueue(out_queue, token), MX_ERR_NO_MEMORY);
 
@@ -205,22 +195,34 @@ mx_error mx_evaluate(const mx_config *config, const char *expression, double *re
 
             const char *last_character;
 
-            for (last_character = character + 1; *last_character; last_character++) {
+            for (last_character = character + 1; last_character < expression_end; last_character++) {
                 if (!isalnum(*last_character) && *last_character != '_') {
                     break;
                 }
             }
 
-            mx_token *fetched_token = lookup_id(config, character, (size_t)(last_character - character));
+            const mx_token *fetched_token = lookup_id(config, character, (size_t)(last_character - character), &probes);
+            lookups++;
+
+            if (fetched_token == NULL) {
+                fetched_token = lookup_builtin(config, character, (size_t)(last_character - character));
+            }
+
             RETURN_ERROR_IF(fetched_token == NULL, MX_ERR_UNDEFINED);
 
             switch (fetched_token->type) {
             case MX_FUNCTION: {
-                RETURN_ERROR_IF(*last_character != '(', MX_ERR_SYNTAX);
+                RETURN_ERROR_IF(last_character == expression_end || *last_character != '(', MX_ERR_SYNTAX);
                 RETURN_ERROR_IF(!token_stack_push(ops_stack, *fetched_token), MX_ERR_NO_MEMORY);
             } break;
 
-            case MX_VARIABLE: {
+            case MX_VARIABLE:
+            case MX_FLOAT_VARIABLE:
+            case MX_FRAME_VARIABLE: {
+                if (program != NULL) {
+                    RETURN_ERROR_IF(!add_variable(program, character, (size_t)(last_character - character), fetched_token), MX_ERR_NO_MEMORY);
+                }
+
                 RETURN_ERROR_IF(!token_queue_enqueue(out_queue, *fetched_token), MX_ERR_NO_MEMORY);
             } break;
 
@@ -234,7 +236,8 @@ mx_error mx_evaluate(const mx_config *config, const char *expression, double *re
             } break;
             }
 
-            last_token = fetched_token->type;
+            // Frame and single-precision variables follow the same grammar as other variables
+            last_token = fetched_token->type == MX_FRAME_VARIABLE || fetched_token->type == MX_FLOAT_VARIABLE ? MX_VARIABLE : fetched_token->type;
             character = last_character - 1;
             continue;
         }
@@ -361,8 +364,9 @@ mx_error mx_evaluate(const mx_config *config, const char *expression, double *re
                 token_stack_pop(ops_stack); // Discard left parenthesis
 
                 if (!token_stack_is_empty(ops_stack) && token_stack_peek(ops_stack).type == MX_FUNCTION) {
-                    RETURN_ERROR_IF(!token_queue_enqueue(out_queue, token_stack_pop(ops_stack)), MX_ERR_NO_MEMORY);
-                    RETURN_ERROR_IF(!int_queue_enqueue(arg_queue, arg_count), MX_ERR_NO_MEMORY);
+                    mx_token function = token_stack_pop(ops_stack);
+                    RETURN_ERROR_IF(!accepts_args(&function, arg_count), MX_ERR_ARGS_NUM);
+                    RETURN_ERROR_IF(!enqueue_call(out_queue, arg_queue, &function, arg_count), MX_ERR_NO_MEMORY);
                     arg_count = int_stack_pop(arg_stack);
                 } else if (last_token == MX_LEFT_PAREN) {
                     // Empty parentheses are not allowed, unless for zero-argument functions
@@ -421,67 +425,164 @@ mx_error mx_evaluate(const mx_config *config, const char *expression, double *re
         if (token.type == MX_FUNCTION) {
             // Implicit parentheses for zero argument functions are not allowed
             RETURN_ERROR_IF(arg_count == 0, MX_ERR_SYNTAX);
-            RETURN_ERROR_IF(!int_queue_enqueue(arg_queue, arg_count), MX_ERR_NO_MEMORY);
+            RETURN_ERROR_IF(!accepts_args(&token, arg_count), MX_ERR_ARGS_NUM);
+            RETURN_ERROR_IF(!enqueue_call(out_queue, arg_queue, &token, arg_count), MX_ERR_NO_MEMORY);
             arg_count = int_stack_pop(arg_stack);
+            continue;
         }
 
         RETURN_ERROR_IF(!token_queue_enqueue(out_queue, token), MX_ERR_NO_MEMORY);
     }
 
-    while (!token_queue_is_empty(out_queue)) {
-        mx_token token = token_queue_dequeue(out_queue);
+cleanup:
+    if (stats != NULL) {
+        stats->tokens += token_queue_length(out_queue);
+        stats->lookups += lookups;
+        stats->probes += probes;
+        stats->allocations += workspace_allocations(workspace) - allocations;
+    }
+
+    return error_code;
+}
+
+// Moves parsed expression from the workspace into arrays of the program, which have to be large enough to hold it.
+static mx_error emit_program(mx_workspace *workspace, mx_program *program) {
+    size_t depth = 0;
+
+    program->n_tokens = token_queue_length(workspace->out_queue);
+    program->n_args = int_queue_length(workspace->arg_queue);
+    program->depth = 0;
+    program->frame_size = 0;
+
+    for (size_t i = 0, j = 0; i < program->n_tokens; i++) {
+        mx_token token = token_queue_dequeue(workspace->out_queue);
 
         switch (token.type) {
-        case MX_CONSTANT: {
-            RETURN_ERROR_IF(!double_stack_push(res_stack, token.d.number), MX_ERR_NO_MEMORY);
+        case MX_CONSTANT:
+        case MX_VARIABLE:
+        case MX_FLOAT_VARIABLE: {
+            depth++;
         } break;
 
-        case MX_VARIABLE: {
-            RETURN_ERROR_IF(!double_stack_push(res_stack, *token.d.var), MX_ERR_NO_MEMORY);
+        case MX_FRAME_VARIABLE: {
+            if (token.d.index >= program->frame_size) {
+                program->frame_size = token.d.index + 1;
+            }
+
+            depth++;
         } break;
 
         case MX_BINARY_OPERATOR: {
-            double b = double_stack_pop(res_stack);
-            double a = double_stack_pop(res_stack);
+            if (depth < 2) {
+                return MX_ERR_SYNTAX;
+            }
 
-            RETURN_ERROR_IF(!double_stack_push(res_stack, token.d.biop.call(a, b)), MX_ERR_NO_MEMORY);
+            depth--;
         } break;
 
         case MX_UNARY_OPERATOR: {
-            double x = double_stack_pop(res_stack);
-
-            RETURN_ERROR_IF(!double_stack_push(res_stack, token.d.unop(x)), MX_ERR_NO_MEMORY);
+            if (depth < 1) {
+                return MX_ERR_SYNTAX;
+            }
         } break;
 
         case MX_FUNCTION: {
-            int args_num = int_queue_dequeue(arg_queue);
-            double func_result;
+            int args_num = int_queue_dequeue(workspace->arg_queue);
 
-            if (args_num == 0) {
-                error_code = token.d.func.call(NULL, 0, &func_result, token.d.func.data);
+            if (depth < (size_t)args_num) {
+                return MX_ERR_SYNTAX;
+            }
 
-                if (error_code != MX_SUCCESS) {
-                    goto cleanup;
-                }
+            depth = depth - (size_t)args_num + 1;
+            program->args[j++] = args_num;
+        } break;
 
-                RETURN_ERROR_IF(!double_stack_push(res_stack, func_result), MX_ERR_NO_MEMORY);
-            } else {
-                double *args = malloc(sizeof(double) * (size_t)args_num);
-                RETURN_ERROR_IF(args == NULL, MX_ERR_NO_MEMORY);
+        default: {
+        } break;
+        }
 
-                for (int i = 0; i < args_num; i++) {
-                    args[args_num - i - 1] = double_stack_pop(res_stack);
-                }
+        if (depth > program->depth) {
+            program->depth = depth;
+        }
 
-                error_code = token.d.func.call(args, args_num, &func_result, token.d.func.data);
-                free(args);
+        program->tokens[i] = token;
+    }
 
-                if (error_code != MX_SUCCESS) {
-                    goto cleanup;
-                }
+    // Exactly one value has to be left in results stack
+    return depth == 1 ? MX_SUCCESS : MX_ERR_SYNTAX;
+}
 
-                RETURN_ERROR_IF(!double_stack_push(res_stack, func_result), MX_ERR_NO_MEMORY);
+// Evaluates the program using given array as a stack, which has to fit at least `program->depth + program->n_slots` values.
+// Frame variables are read from `frame`, which can be NULL if program does not have any.
+static mx_error execute(const mx_program *program, double *stack, const double *frame, double *result) {
+    const int *args = program->args;
+    double *slots = stack + program->depth;
+    size_t top = 0;
+
+    if (program->frame_size > 0 && frame == NULL) {
+        return MX_ERR_UNDEFINED;
+    }
+
+    if (program->native != NULL) {
+        mx_error error_code = program->native(stack, frame);
+
+        if (error_code == MX_SUCCESS && result != NULL) {
+            *result = stack[0];
+        }
+
+        return error_code;
+    }
+
+    for (size_t i = 0; i < program->n_tokens; i++) {
+        mx_token token = program->tokens[i];
+
+        switch (token.type) {
+        case MX_CONSTANT: {
+            stack[top++] = token.d.number;
+        } break;
+
+        case MX_VARIABLE: {
+            stack[top++] = *token.d.var;
+        } break;
+
+        case MX_FLOAT_VARIABLE: {
+            stack[top++] = *token.d.fvar;
+        } break;
+
+        case MX_FRAME_VARIABLE: {
+            stack[top++] = frame[token.d.index];
+        } break;
+
+        case MX_BINARY_OPERATOR: {
+            top--;
+            stack[top - 1] = token.d.biop.call(stack[top - 1], stack[top]);
+        } break;
+
+        case MX_UNARY_OPERATOR: {
+            stack[top - 1] = token.d.unop.call(stack[top - 1]);
+        } break;
+
+        case MX_STORE: {
+            slots[token.d.slot] = stack[top - 1];
+        } break;
+
+        case MX_LOAD: {
+            stack[top++] = slots[token.d.slot];
+        } break;
+
+        case MX_FUNCTION: {
+            int args_num = *args++;
+            double func_result;
+
+            // Arguments are passed as a view into the stack, they are popped right after the call anyway
+            top -= (size_t)args_num;
+            mx_error error_code = call_function(&token, args_num > 0 ? &stack[top] : NULL, args_num, &func_result);
+
+            if (error_code != MX_SUCCESS) {
+                return error_code;
             }
+
+            stack[top++] = func_result;
         } break;
 
         default: {
@@ -489,20 +590,328 @@ mx_error mx_evaluate(const mx_config *config, const char *expression, double *re
         }
     }
 
-    // Exactly one value has to be left in results stack
-    double final_result = double_stack_pop(res_stack);
-    RETURN_ERROR_IF(!double_stack_is_empty(res_stack), MX_ERR_SYNTAX);
-
     if (result != NULL) {
-        *result = final_result;
+        *result = stack[0];
+    }
+
+    return MX_SUCCESS;
+}
+
+// Adds function calls and cycles spent executing the program to the statistics, unless they are NULL.
+static void count_execution(mx_stats *stats, const mx_program *program, mx_error error_code, unsigned long long start, bool timing) {
+    if (stats == NULL) {
+        return;
+    }
+
+    if (error_code == MX_SUCCESS) {
+        stats->calls += program->n_args;
     }
 
+    if (timing) {
+        stats->eval_cycles += read_cycles() - start;
+    }
+}
+
+// Counts failure with given error code.
+static void count_error(mx_stats *stats, mx_error error_code) {
+    if (error_code != MX_SUCCESS && (size_t)error_code < MX_STATS_ERRORS) {
+        stats->errors[error_code]++;
+    }
+}
+
+mx_workspace *mx_workspace_create(void) {
+    mx_workspace *workspace = calloc(1, sizeof(mx_workspace));
+
+    if (workspace == NULL) {
+        return NULL;
+    }
+
+    workspace->ops_stack = token_stack_create();
+    workspace->out_queue = token_queue_create();
+    workspace->arg_stack = int_stack_create();
+    workspace->arg_queue = int_queue_create();
+
+    if (workspace->ops_stack == NULL || workspace->out_queue == NULL || workspace->arg_stack == NULL || workspace->arg_queue == NULL) {
+        mx_workspace_free(workspace);
+        return NULL;
+    }
+
+    return workspace;
+}
+
+void mx_workspace_free(mx_workspace *workspace) {
+    if (workspace->ops_stack != NULL) {
+        token_stack_free(workspace->ops_stack);
+    }
+
+    if (workspace->out_queue != NULL) {
+        token_queue_free(workspace->out_queue);
+    }
+
+    if (workspace->arg_stack != NULL) {
+        int_stack_free(workspace->arg_stack);
+    }
+
+    if (workspace->arg_queue != NULL) {
+        int_queue_free(workspace->arg_queue);
+    }
+
+    free(workspace->program.tokens);
+    free(workspace->program.args);
+    free(workspace->stack);
+    free(workspace);
+}
+
+// Makes sure workspace stack fits at least given number of values.
+static bool reserve_stack(mx_workspace *workspace, size_t depth) {
+    if (depth > workspace->stack_capacity) {
+        double *stack = realloc(workspace->stack, sizeof(double) * depth);
+
+        if (stack == NULL) {
+            return false;
+        }
+
+        workspace->stack = stack;
+        workspace->stack_capacity = depth;
+    }
+
+    return true;
+}
+
+// Compiles expression into a new program. Counts parsing into `stats`, unless it is NULL.
+static mx_error compile(const mx_config *config, const char *expression, mx_program **program, mx_stats *stats) {
+    mx_error error_code = MX_SUCCESS;
+    mx_workspace *workspace = mx_workspace_create();
+    mx_program *new_program = calloc(1, sizeof(mx_program));
+
+    RETURN_ERROR_IF(workspace == NULL || new_program == NULL, MX_ERR_NO_MEMORY);
+
+    error_code = parse(config, expression, strlen(expression), workspace, new_program, stats);
+
+    if (error_code != MX_SUCCESS) {
+        goto cleanup;
+    }
+
+    size_t n_tokens = token_queue_length(workspace->out_queue);
+    size_t n_args = int_queue_length(workspace->arg_queue);
+
+    new_program->tokens = malloc(sizeof(mx_token) * n_tokens);
+    new_program->args = malloc(sizeof(int) * (n_args > 0 ? n_args : 1));
+    RETURN_ERROR_IF(new_program->tokens == NULL || new_program->args == NULL, MX_ERR_NO_MEMORY);
+
+    error_code = emit_program(workspace, new_program);
+
+    if (error_code != MX_SUCCESS) {
+        goto cleanup;
+    }
+
+    fold_constants(new_program);
+    eliminate_common_subexpressions(new_program);
+
+    *program = new_program;
+    new_program = NULL;
+
 cleanup:
-    token_stack_free(ops_stack);
-    token_queue_free(out_queue);
-    double_stack_free(res_stack);
-    int_stack_free(arg_stack);
-    int_queue_free(arg_queue);
+    if (workspace != NULL) {
+        mx_workspace_free(workspace);
+    }
+
+    if (new_program != NULL) {
+        mx_program_free(new_program);
+    }
+
+    return error_code;
+}
+
+mx_error mx_compile(const mx_config *config, const char *expression, mx_program **program) {
+    mx_counters *counters = config_counters(config);
+
+    if (counters == NULL) {
+        return compile(config, expression, program, NULL);
+    }
+
+    mx_stats stats;
+    memset(&stats, 0, sizeof(mx_stats));
+    stats.compilations = 1;
+
+    bool timing = counters_timing(counters);
+    unsigned long long start = timing ? read_cycles() : 0;
+    mx_error error_code = compile(config, expression, program, &stats);
+
+    if (timing) {
+        stats.parse_cycles = read_cycles() - start;
+    }
+
+    count_error(&stats, error_code);
+    counters_add(counters, &stats);
+
+    return error_code;
+}
+
+mx_error mx_program_eval(const mx_program *program, double *result) {
+    return mx_program_eval_frame(program, NULL, result);
+}
+
+mx_error mx_program_eval_frame(const mx_program *program, const double frame[], double *result) {
+    double local_stack[LOCAL_STACK_SIZE];
+
+    size_t size = program->depth + program->n_slots;
+
+    if (size <= LOCAL_STACK_SIZE) {
+        return execute(program, local_stack, frame, result);
+    }
+
+    double *stack = malloc(sizeof(double) * size);
+
+    if (stack == NULL) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    mx_error error_code = execute(program, stack, frame, result);
+    free(stack);
 
     return error_code;
 }
+
+mx_error mx_program_eval_ws(const mx_program *program, mx_workspace *workspace, double *result) {
+    if (!reserve_stack(workspace, program->depth + program->n_slots)) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    return execute(program, workspace->stack, NULL, result);
+}
+
+void mx_program_free(mx_program *program) {
+    program_release_native(program);
+
+    for (size_t i = 0; i < program->n_vars; i++) {
+        free(program->vars[i].name);
+    }
+
+    free(program->vars);
+    free(program->tokens);
+    free(program->args);
+    free(program);
+}
+
+// Evaluates expression using the cache of the config if it is enabled, otherwise parsing it in the workspace.
+// Temporary workspace is created if it is NULL. Statistics are collected into `stats`, unless it is NULL.
+static mx_error evaluate(const mx_config *config, mx_workspace *workspace, const char *expression, size_t length, double *result, mx_stats *stats, bool timing) {
+    mx_cache *cache = config_cache(config);
+
+    if (cache != NULL) {
+        cache_entry *entry;
+        mx_error error_code = cache_acquire(cache, config, expression, length, &entry);
+
+        if (error_code != MX_SUCCESS) {
+            return error_code;
+        }
+
+        const mx_program *program = cache_entry_program(entry);
+        unsigned long long start = timing ? read_cycles() : 0;
+
+        error_code = workspace != NULL ? mx_program_eval_ws(program, workspace, result) : mx_program_eval(program, result);
+        count_execution(stats, program, error_code, start, timing);
+        cache_release(entry);
+
+        return error_code;
+    }
+
+    if (workspace == NULL) {
+        workspace = mx_workspace_create();
+
+        if (workspace == NULL) {
+            return MX_ERR_NO_MEMORY;
+        }
+
+        mx_error error_code = evaluate(config, workspace, expression, length, result, stats, timing);
+        mx_workspace_free(workspace);
+
+        return error_code;
+    }
+
+    unsigned long long start = timing ? read_cycles() : 0;
+    mx_program *program = &workspace->program;
+    mx_error error_code = parse(config, expression, length, workspace, NULL, stats);
+
+    if (error_code != MX_SUCCESS) {
+        return error_code;
+    }
+
+    size_t n_tokens = token_queue_length(workspace->out_queue);
+    size_t n_args = int_queue_length(workspace->arg_queue);
+
+    if (n_tokens > workspace->tokens_capacity) {
+        mx_token *tokens = realloc(program->tokens, sizeof(mx_token) * n_tokens);
+
+        if (tokens == NULL) {
+            return MX_ERR_NO_MEMORY;
+        }
+
+        program->tokens = tokens;
+        workspace->tokens_capacity = n_tokens;
+    }
+
+    if (n_args > workspace->args_capacity) {
+        int *args = realloc(program->args, sizeof(int) * n_args);
+
+        if (args == NULL) {
+            return MX_ERR_NO_MEMORY;
+        }
+
+        program->args = args;
+        workspace->args_capacity = n_args;
+    }
+
+    error_code = emit_program(workspace, program);
+
+    if (error_code != MX_SUCCESS) {
+        return error_code;
+    }
+
+    if (!reserve_stack(workspace, program->depth)) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    if (timing) {
+        unsigned long long end = read_cycles();
+        stats->parse_cycles += end - start;
+        start = end;
+    }
+
+    error_code = execute(program, workspace->stack, NULL, result);
+    count_execution(stats, program, error_code, start, timing);
+
+    return error_code;
+}
+
+// Evaluates expression, adding statistics of the evaluation to the config if they are enabled.
+static mx_error evaluate_counted(const mx_config *config, mx_workspace *workspace, const char *expression, size_t length, double *result) {
+    mx_counters *counters = config_counters(config);
+
+    if (counters == NULL) {
+        return evaluate(config, workspace, expression, length, result, NULL, false);
+    }
+
+    mx_stats stats;
+    memset(&stats, 0, sizeof(mx_stats));
+    stats.evaluations = 1;
+
+    mx_error error_code = evaluate(config, workspace, expression, length, result, &stats, counters_timing(counters));
+    count_error(&stats, error_code);
+    counters_add(counters, &stats);
+
+    return error_code;
+}
+
+mx_error mx_evaluate_ws(const mx_config *config, mx_workspace *workspace, const char *expression, double *result) {
+    return evaluate_counted(config, workspace, expression, strlen(expression), result);
+}
+
+mx_error mx_evaluate_ws_n(const mx_config *config, mx_workspace *workspace, const char *expression, size_t length, double *result) {
+    return evaluate_counted(config, workspace, expression, length, result);
+}
+
+mx_error mx_evaluate(const mx_config *config, const char *expression, double *result) {
+    return evaluate_counted(config, NULL, expression, strlen(expression), result);
+}
@@ -0,0 +1,242 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+// Required for `mmap` and `madvise` in strict C99 mode
+#define _DEFAULT_SOURCE
+
+#include "mathex.h"
+#include "mx_program.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && (defined(__unix__) || defined(__APPLE__))
+#define HAVE_MMAP
+#endif
+
+#ifdef HAVE_MMAP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Number of rows evaluated before pages holding them are released. Keeps memory usage bounded
+// for files larger than memory, while amortizing the cost of starting parallel evaluation.
+#define WINDOW_SIZE ((size_t)1 << 20)
+
+typedef struct mapped_file {
+    int fd;
+    dev_t device; // identity of the file, to detect output overwriting one of the inputs
+    ino_t inode;
+    size_t size;
+    double *data; // mapped values, or NULL if the file is not used by the expression
+} mapped_file;
+
+static bool little_endian(void) {
+    const uint16_t one = 1;
+    return *(const uint8_t *)&one == 1;
+}
+
+static bool uses_variable(const mx_program *program, const char *name) {
+    for (size_t i = 0; i < program->n_vars; i++) {
+        if (strcmp(program->vars[i].name, name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Opens the file and finds number of rows in it, but maps it only if `map` is set.
+static mx_error map_file(mapped_file *file, const char *path, bool map, size_t *n_rows) {
+    struct stat info;
+
+    if ((file->fd = open(path, O_RDONLY)) < 0 || fstat(file->fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        return MX_ERR_IO;
+    }
+
+    if ((uintmax_t)info.st_size > SIZE_MAX) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    file->device = info.st_dev;
+    file->inode = info.st_ino;
+    file->size = (size_t)info.st_size;
+    *n_rows = file->size / sizeof(double);
+
+    if (file->size % sizeof(double) != 0) {
+        return MX_ERR_INVALID_ARGS;
+    }
+
+    if (map && file->size > 0) {
+        void *data = mmap(NULL, file->size, PROT_READ, MAP_SHARED, file->fd, 0);
+
+        if (data == MAP_FAILED) {
+            return MX_ERR_IO;
+        }
+
+        // Pages are read once in order, so they can be read ahead aggressively
+        madvise(data, file->size, MADV_SEQUENTIAL);
+        file->data = data;
+    }
+
+    return MX_SUCCESS;
+}
+
+mx_error mx_program_eval_files(const mx_program *program, mx_pool *pool, const mx_column_file files[], size_t n_files, const char *output) {
+    mx_error error_code = MX_SUCCESS;
+    mapped_file *inputs = NULL;
+    mx_column *columns = NULL;
+    mx_column *window = NULL;
+    size_t n_columns = 0;
+    size_t n_rows = 0;
+    int output_fd = -1;
+    double *results = NULL;
+    struct stat info;
+
+    if (n_files == 0) {
+        return MX_ERR_INVALID_ARGS;
+    }
+
+    // Values are read from files as they are
+    if (!little_endian()) {
+        return MX_ERR_NOT_SUPPORTED;
+    }
+
+    inputs = malloc(sizeof(mapped_file) * n_files);
+    columns = malloc(sizeof(mx_column) * n_files);
+    window = malloc(sizeof(mx_column) * n_files);
+    RETURN_ERROR_IF(inputs == NULL || columns == NULL || window == NULL, MX_ERR_NO_MEMORY);
+
+    for (size_t i = 0; i < n_files; i++) {
+        inputs[i].fd = -1;
+        inputs[i].data = NULL;
+    }
+
+    for (size_t i = 0; i < n_files; i++) {
+        size_t file_rows;
+
+        error_code = map_file(&inputs[i], files[i].path, uses_variable(program, files[i].name), &file_rows);
+
+        if (error_code != MX_SUCCESS) {
+            goto cleanup;
+        }
+
+        RETURN_ERROR_IF(i > 0 && file_rows != n_rows, MX_ERR_INVALID_ARGS);
+        n_rows = file_rows;
+
+        if (inputs[i].data != NULL) {
+            columns[n_columns].name = files[i].name;
+            columns[n_columns].values = inputs[i].data;
+            n_columns++;
+        }
+    }
+
+    // Truncating the output would destroy values that are still to be read
+    if (stat(output, &info) == 0) {
+        for (size_t i = 0; i < n_files; i++) {
+            RETURN_ERROR_IF(info.st_dev == inputs[i].device && info.st_ino == inputs[i].inode, MX_ERR_INVALID_ARGS);
+        }
+    }
+
+    output_fd = open(output, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    RETURN_ERROR_IF(output_fd < 0, MX_ERR_IO);
+    RETURN_ERROR_IF(n_rows > (size_t)INTMAX_MAX / sizeof(double), MX_ERR_NO_MEMORY);
+    RETURN_ERROR_IF(ftruncate(output_fd, (off_t)(n_rows * sizeof(double))) != 0, MX_ERR_IO);
+
+    if (n_rows == 0) {
+        goto cleanup;
+    }
+
+    results = mmap(NULL, n_rows * sizeof(double), PROT_READ | PROT_WRITE, MAP_SHARED, output_fd, 0);
+
+    if (results == MAP_FAILED) {
+        results = NULL;
+        RETURN_ERROR(MX_ERR_IO);
+    }
+
+    madvise(results, n_rows * sizeof(double), MADV_SEQUENTIAL);
+
+    for (size_t start = 0; start < n_rows; start += WINDOW_SIZE) {
+        size_t length = n_rows - start < WINDOW_SIZE ? n_rows - start : WINDOW_SIZE;
+        size_t bytes = length * sizeof(double);
+
+        for (size_t i = 0; i < n_columns; i++) {
+            window[i].name = columns[i].name;
+            window[i].values = columns[i].values + start;
+        }
+
+        error_code = mx_program_eval_parallel(program, pool, window, n_columns, length, results + start);
+
+        if (error_code != MX_SUCCESS) {
+            goto cleanup;
+        }
+
+        // Windows start at multiples of page size, so whole pages of evaluated rows are released
+        for (size_t i = 0; i < n_columns; i++) {
+            madvise((void *)(uintptr_t)window[i].values, bytes, MADV_DONTNEED);
+        }
+
+        msync(results + start, bytes, MS_ASYNC);
+    }
+
+cleanup:
+    if (results != NULL) {
+        munmap(results, n_rows * sizeof(double));
+    }
+
+    if (output_fd >= 0) {
+        close(output_fd);
+    }
+
+    for (size_t i = 0; inputs != NULL && i < n_files; i++) {
+        if (inputs[i].data != NULL) {
+            munmap(inputs[i].data, inputs[i].size);
+        }
+
+        if (inputs[i].fd >= 0) {
+            close(inputs[i].fd);
+        }
+    }
+
+    free(inputs);
+    free(columns);
+    free(window);
+
+    return error_code;
+}
+
+#else
+
+mx_error mx_program_eval_files(const mx_program *program, mx_pool *pool, const mx_column_file files[], size_t n_files, const char *output) {
+    (void)program;
+    (void)pool;
+    (void)files;
+    (void)n_files;
+    (void)output;
+
+    return MX_ERR_NOT_SUPPORTED;
+}
+
+#endif
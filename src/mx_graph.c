@@ -0,0 +1,419 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "mathex.h"
+#include "mx_config.h"
+#include "mx_pool.h"
+#include "mx_program.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of formulas of a level evaluated by a single task of the pool.
+#define CHUNK_SIZE 16
+
+typedef struct formula {
+    char *name;
+    char *expression;
+    mx_program *program; // NULL until compiled, or if compilation failed
+    mx_error error;      // result of the last evaluation
+    bool thread_safe;    // whether program can be evaluated by multiple threads at once with other formulas
+} formula;
+
+// Each formula is a frame variable of the config, indexed by its position in `formulas`. Values of
+// formulas are the frame every formula is evaluated with, so formulas read each other directly.
+struct mx_graph {
+    mx_config *config;
+    formula *formulas;
+    size_t n_formulas;
+    size_t capacity;
+    double *values;
+
+    bool dirty;          // whether formulas changed since order was found
+    size_t *order;       // formulas sorted by level, then by position
+    size_t *level_start; // start of each level in `order`, followed by end of the last one
+    size_t n_levels;
+    size_t n_ordered; // formulas that are not in a cycle
+};
+
+// Evaluation of one level of the graph, shared by all threads of the pool.
+typedef struct level_job {
+    mx_graph *graph;
+    const size_t *formulas;
+    size_t n_formulas;
+} level_job;
+
+mx_graph *mx_graph_create(mx_config *config) {
+    mx_graph *graph = calloc(1, sizeof(mx_graph));
+
+    if (graph == NULL) {
+        return NULL;
+    }
+
+    graph->config = config;
+    graph->dirty = true;
+
+    return graph;
+}
+
+// Finds formula that the frame variable of a program refers to, or SIZE_MAX if it is not a formula of the graph.
+static size_t find_formula(const mx_graph *graph, const program_variable *var) {
+    if (var->value != NULL || var->index >= graph->n_formulas || strcmp(graph->formulas[var->index].name, var->name) != 0) {
+        return SIZE_MAX;
+    }
+
+    return var->index;
+}
+
+static char *copy_string(const char *string) {
+    size_t length = strlen(string);
+    char *copy = malloc(length + 1);
+
+    if (copy != NULL) {
+        memcpy(copy, string, length + 1);
+    }
+
+    return copy;
+}
+
+mx_error mx_graph_define(mx_graph *graph, const char *name, const char *expression) {
+    mx_token *token = lookup_id(graph->config, name, strlen(name), NULL);
+    char *expression_copy = copy_string(expression);
+
+    if (expression_copy == NULL) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    // Redefined formula keeps its position, so that programs of other formulas still refer to it
+    if (token != NULL && token->type == MX_FRAME_VARIABLE && token->d.index < graph->n_formulas && strcmp(graph->formulas[token->d.index].name, name) == 0) {
+        formula *existing = &graph->formulas[token->d.index];
+
+        if (existing->program != NULL) {
+            mx_program_free(existing->program);
+            existing->program = NULL;
+        }
+
+        free(existing->expression);
+        existing->expression = expression_copy;
+        graph->dirty = true;
+
+        return MX_SUCCESS;
+    }
+
+    if (graph->n_formulas == graph->capacity) {
+        size_t capacity = graph->capacity > 0 ? 2 * graph->capacity : 16;
+        formula *formulas = realloc(graph->formulas, sizeof(formula) * capacity);
+
+        if (formulas != NULL) {
+            graph->formulas = formulas;
+        }
+
+        double *values = realloc(graph->values, sizeof(double) * capacity);
+
+        if (values != NULL) {
+            graph->values = values;
+        }
+
+        if (formulas == NULL || values == NULL) {
+            free(expression_copy);
+            return MX_ERR_NO_MEMORY;
+        }
+
+        graph->capacity = capacity;
+    }
+
+    formula *added = &graph->formulas[graph->n_formulas];
+    added->name = copy_string(name);
+
+    if (added->name == NULL) {
+        free(expression_copy);
+        return MX_ERR_NO_MEMORY;
+    }
+
+    mx_error error_code = mx_add_frame_variable(graph->config, name, graph->n_formulas);
+
+    if (error_code != MX_SUCCESS) {
+        free(added->name);
+        free(expression_copy);
+        return error_code;
+    }
+
+    added->expression = expression_copy;
+    added->program = NULL;
+    added->error = MX_ERR_UNDEFINED;
+    added->thread_safe = true;
+    graph->values[graph->n_formulas] = 0;
+    graph->n_formulas++;
+
+    // Formulas that failed to compile are compiled again, since they could have referred to the new name
+    graph->dirty = true;
+    return MX_SUCCESS;
+}
+
+static void compile_formula(mx_graph *graph, formula *target) {
+    target->error = mx_compile(graph->config, target->expression, &target->program);
+
+    if (target->error != MX_SUCCESS) {
+        target->program = NULL;
+        return;
+    }
+
+    target->thread_safe = true;
+
+    for (size_t i = 0; i < target->program->n_tokens; i++) {
+        const mx_token *token = &target->program->tokens[i];
+
+        if (token->type == MX_FUNCTION && !(token->d.func.flags & (MX_FUNC_PURE | MX_FUNC_THREAD_SAFE))) {
+            target->thread_safe = false;
+        }
+    }
+
+    // Frame variables that are not formulas of this graph have no value
+    for (size_t i = 0; i < target->program->n_vars; i++) {
+        if (target->program->vars[i].value == NULL && find_formula(graph, &target->program->vars[i]) == SIZE_MAX) {
+            mx_program_free(target->program);
+            target->program = NULL;
+            target->error = MX_ERR_UNDEFINED;
+            return;
+        }
+    }
+}
+
+// Compiles changed formulas and sorts them into levels, where each formula depends only on formulas of previous levels.
+static mx_error sort_formulas(mx_graph *graph) {
+    mx_error error_code = MX_SUCCESS;
+    size_t n = graph->n_formulas;
+    size_t n_edges = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (graph->formulas[i].program == NULL) {
+            compile_formula(graph, &graph->formulas[i]);
+        }
+
+        if (graph->formulas[i].program != NULL) {
+            n_edges += graph->formulas[i].program->n_vars;
+        }
+    }
+
+    size_t *order = malloc(sizeof(size_t) * (n + 1));
+    size_t *level_start = malloc(sizeof(size_t) * (n + 1));
+    size_t *remaining = calloc(n + 1, sizeof(size_t)); // number of dependencies not in the order yet
+    size_t *dependent_start = calloc(n + 2, sizeof(size_t));
+    size_t *dependents = malloc(sizeof(size_t) * (n_edges + 1));
+    RETURN_ERROR_IF(order == NULL || level_start == NULL || remaining == NULL || dependent_start == NULL || dependents == NULL, MX_ERR_NO_MEMORY);
+
+    // Dependents of each formula are grouped by counting them first
+    for (size_t i = 0; i < n; i++) {
+        const mx_program *program = graph->formulas[i].program;
+
+        for (size_t j = 0; program != NULL && j < program->n_vars; j++) {
+            size_t dependency = find_formula(graph, &program->vars[j]);
+
+            if (dependency != SIZE_MAX) {
+                dependent_start[dependency + 2]++;
+                remaining[i]++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        dependent_start[i + 2] += dependent_start[i + 1];
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const mx_program *program = graph->formulas[i].program;
+
+        for (size_t j = 0; program != NULL && j < program->n_vars; j++) {
+            size_t dependency = find_formula(graph, &program->vars[j]);
+
+            if (dependency != SIZE_MAX) {
+                dependents[dependent_start[dependency + 1]++] = i;
+            }
+        }
+    }
+
+    // Levels are found breadth-first, each one made of formulas whose last dependency is in the previous level
+    size_t n_ordered = 0, n_levels = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (remaining[i] == 0) {
+            order[n_ordered++] = i;
+        }
+    }
+
+    for (size_t begin = 0; begin < n_ordered;) {
+        size_t end = n_ordered;
+        level_start[n_levels++] = begin;
+
+        for (size_t k = begin; k < end; k++) {
+            size_t current = order[k];
+
+            for (size_t d = dependent_start[current]; d < dependent_start[current + 1]; d++) {
+                if (--remaining[dependents[d]] == 0) {
+                    order[n_ordered++] = dependents[d];
+                }
+            }
+        }
+
+        begin = end;
+    }
+
+    level_start[n_levels] = n_ordered;
+
+    // Formulas that were never ordered depend on each other in a cycle, or on a formula that does
+    for (size_t i = 0; i < n; i++) {
+        if (remaining[i] > 0) {
+            graph->formulas[i].error = MX_ERR_CYCLE;
+        }
+    }
+
+    free(graph->order);
+    free(graph->level_start);
+    graph->order = order;
+    graph->level_start = level_start;
+    graph->n_levels = n_levels;
+    graph->n_ordered = n_ordered;
+    graph->dirty = false;
+    order = NULL;
+    level_start = NULL;
+
+cleanup:
+    free(order);
+    free(level_start);
+    free(remaining);
+    free(dependent_start);
+    free(dependents);
+
+    return error_code;
+}
+
+static void evaluate_formula(mx_graph *graph, size_t index) {
+    formula *target = &graph->formulas[index];
+
+    if (target->program == NULL) {
+        return;
+    }
+
+    // Formulas depending on formulas that failed fail with the same error
+    for (size_t i = 0; i < target->program->n_vars; i++) {
+        size_t dependency = find_formula(graph, &target->program->vars[i]);
+
+        if (dependency != SIZE_MAX && graph->formulas[dependency].error != MX_SUCCESS) {
+            target->error = graph->formulas[dependency].error;
+            return;
+        }
+    }
+
+    target->error = mx_program_eval_frame(target->program, graph->values, &graph->values[index]);
+}
+
+static void evaluate_chunk(void *context, size_t worker, size_t index) {
+    level_job *job = context;
+    size_t end = (index + 1) * CHUNK_SIZE < job->n_formulas ? (index + 1) * CHUNK_SIZE : job->n_formulas;
+    (void)worker;
+
+    for (size_t i = index * CHUNK_SIZE; i < end; i++) {
+        if (job->graph->formulas[job->formulas[i]].thread_safe) {
+            evaluate_formula(job->graph, job->formulas[i]);
+        }
+    }
+}
+
+mx_error mx_graph_recompute(mx_graph *graph, mx_pool *pool) {
+    mx_error error_code = MX_SUCCESS;
+
+    if (graph->dirty && (error_code = sort_formulas(graph)) != MX_SUCCESS) {
+        return error_code;
+    }
+
+    for (size_t level = 0; level < graph->n_levels; level++) {
+        level_job job = {
+            .graph = graph,
+            .formulas = graph->order + graph->level_start[level],
+            .n_formulas = graph->level_start[level + 1] - graph->level_start[level],
+        };
+
+        // Levels too small to be split are not worth waking up the pool
+        if (job.n_formulas > CHUNK_SIZE && (pool != NULL || (pool = default_pool()) != NULL)) {
+            pool_run(pool, (job.n_formulas + CHUNK_SIZE - 1) / CHUNK_SIZE, evaluate_chunk, &job);
+        } else {
+            for (size_t i = 0; i < job.n_formulas; i++) {
+                if (graph->formulas[job.formulas[i]].thread_safe) {
+                    evaluate_formula(graph, job.formulas[i]);
+                }
+            }
+        }
+
+        // Functions that are not thread-safe are called only by the calling thread, after the rest of the level
+        for (size_t i = 0; i < job.n_formulas; i++) {
+            if (!graph->formulas[job.formulas[i]].thread_safe) {
+                evaluate_formula(graph, job.formulas[i]);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < graph->n_ordered && error_code == MX_SUCCESS; k++) {
+        error_code = graph->formulas[graph->order[k]].error;
+    }
+
+    if (error_code == MX_SUCCESS && graph->n_ordered < graph->n_formulas) {
+        error_code = MX_ERR_CYCLE;
+    }
+
+    return error_code;
+}
+
+mx_error mx_graph_value(const mx_graph *graph, const char *name, double *value) {
+    mx_token *token = lookup_id(graph->config, name, strlen(name), NULL);
+
+    if (token == NULL || token->type != MX_FRAME_VARIABLE || token->d.index >= graph->n_formulas || strcmp(graph->formulas[token->d.index].name, name) != 0) {
+        return MX_ERR_UNDEFINED;
+    }
+
+    const formula *target = &graph->formulas[token->d.index];
+
+    if (target->error == MX_SUCCESS) {
+        *value = graph->values[token->d.index];
+    }
+
+    return target->error;
+}
+
+void mx_graph_free(mx_graph *graph) {
+    for (size_t i = 0; i < graph->n_formulas; i++) {
+        mx_remove(graph->config, graph->formulas[i].name);
+
+        if (graph->formulas[i].program != NULL) {
+            mx_program_free(graph->formulas[i].program);
+        }
+
+        free(graph->formulas[i].name);
+        free(graph->formulas[i].expression);
+    }
+
+    free(graph->formulas);
+    free(graph->values);
+    free(graph->order);
+    free(graph->level_start);
+    free(graph);
+}
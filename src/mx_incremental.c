@@ -0,0 +1,360 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "mathex.h"
+#include "mx_program.h"
+#include "mx_token.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every token except temporary slots is a node of the expression graph, identified by its index in the program.
+// Operands of a node are nodes that produced them, so loads of temporary values refer to the stored node directly.
+// Nodes depending on functions that are not pure are recomputed on every evaluation, as if they read a variable
+// that always changes, stored after the variables of the program.
+struct mx_incremental {
+    const mx_program *program;
+    double *values;        // cached value of each node
+    size_t *operands;      // operand nodes of all nodes
+    size_t *operand_start; // start of operands of each node, followed by end of operands of the last one
+    size_t *dependents;    // nodes depending on each variable, in order of evaluation
+    size_t *dependent_start;
+    size_t root;   // node producing the result
+    bool *changed; // variables marked as changed since last evaluation
+    size_t n_changed;
+    bool complete;   // whether every cached value is up to date with unchanged variables
+    size_t *pending; // nodes to recompute on next evaluation
+    size_t *marks;   // merge of dependents at which each node was last added to `pending`
+    size_t generation;
+    double *args; // arguments of function calls
+};
+
+static int compare_nodes(const void *a, const void *b) {
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Finds operands of each node and which variables each node depends on, as bitsets of `words` words.
+static mx_error build_graph(mx_incremental *state, uint64_t *depends, size_t words) {
+    const mx_program *program = state->program;
+    const int *args = program->args;
+    size_t size = program->depth + program->n_slots;
+    size_t *producers = malloc(sizeof(size_t) * (size > 0 ? size : 1));
+    size_t *slot_producers = producers + program->depth;
+    size_t volatile_bit = program->n_vars;
+    size_t n_operands = 0;
+    size_t top = 0;
+
+    if (producers == NULL) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    for (size_t i = 0; i < program->n_tokens; i++) {
+        mx_token token = program->tokens[i];
+        uint64_t *bits = depends + i * words;
+        size_t n_args = 0;
+
+        state->operand_start[i] = n_operands;
+
+        switch (token.type) {
+        case MX_VARIABLE:
+        case MX_FLOAT_VARIABLE:
+        case MX_FRAME_VARIABLE: {
+            for (size_t k = 0; k < program->n_vars; k++) {
+                if (same_variable(&program->vars[k], &token)) {
+                    bits[k / 64] |= (uint64_t)1 << (k % 64);
+                }
+            }
+        } break;
+
+        case MX_BINARY_OPERATOR: {
+            n_args = 2;
+        } break;
+
+        case MX_UNARY_OPERATOR: {
+            n_args = 1;
+        } break;
+
+        case MX_FUNCTION: {
+            n_args = (size_t)*args++;
+
+            if (!(token.d.func.flags & MX_FUNC_PURE)) {
+                bits[volatile_bit / 64] |= (uint64_t)1 << (volatile_bit % 64);
+            }
+        } break;
+
+        case MX_STORE: {
+            slot_producers[token.d.slot] = producers[top - 1];
+        } break;
+
+        case MX_LOAD: {
+            producers[top++] = slot_producers[token.d.slot];
+        } break;
+
+        default: {
+        } break;
+        }
+
+        if (token.type == MX_STORE || token.type == MX_LOAD) {
+            continue;
+        }
+
+        top -= n_args;
+
+        for (size_t j = 0; j < n_args; j++) {
+            const uint64_t *operand_bits = depends + producers[top + j] * words;
+            state->operands[n_operands++] = producers[top + j];
+
+            for (size_t w = 0; w < words; w++) {
+                bits[w] |= operand_bits[w];
+            }
+        }
+
+        producers[top++] = i;
+    }
+
+    state->operand_start[program->n_tokens] = n_operands;
+    state->root = producers[0];
+
+    free(producers);
+    return MX_SUCCESS;
+}
+
+mx_incremental *mx_incremental_create(const mx_program *program) {
+    mx_error error_code = MX_SUCCESS;
+    size_t n_tokens = program->n_tokens;
+    size_t n_sets = program->n_vars + 1;
+    size_t words = (n_sets + 63) / 64;
+    size_t max_args = 1;
+    uint64_t *depends = NULL;
+    mx_incremental *state = calloc(1, sizeof(mx_incremental));
+
+    if (state == NULL) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < program->n_args; i++) {
+        if ((size_t)program->args[i] > max_args) {
+            max_args = (size_t)program->args[i];
+        }
+    }
+
+    state->program = program;
+    state->values = malloc(sizeof(double) * n_tokens);
+    state->operands = malloc(sizeof(size_t) * n_tokens);
+    state->operand_start = malloc(sizeof(size_t) * (n_tokens + 1));
+    state->dependent_start = malloc(sizeof(size_t) * (n_sets + 1));
+    state->changed = calloc(n_sets, sizeof(bool));
+    state->pending = malloc(sizeof(size_t) * n_tokens);
+    state->marks = calloc(n_tokens, sizeof(size_t));
+    state->args = malloc(sizeof(double) * max_args);
+    depends = calloc(n_tokens * words, sizeof(uint64_t));
+
+    RETURN_ERROR_IF(state->values == NULL || state->operands == NULL || state->operand_start == NULL, MX_ERR_NO_MEMORY);
+    RETURN_ERROR_IF(state->dependent_start == NULL || state->changed == NULL || state->pending == NULL, MX_ERR_NO_MEMORY);
+    RETURN_ERROR_IF(state->marks == NULL || state->args == NULL || depends == NULL, MX_ERR_NO_MEMORY);
+
+    error_code = build_graph(state, depends, words);
+
+    if (error_code != MX_SUCCESS) {
+        goto cleanup;
+    }
+
+    // Lists of dependents are laid out one after another, so that recomputing after a single change walks one array
+    size_t n_dependents = 0;
+
+    for (size_t k = 0; k < n_sets; k++) {
+        for (size_t i = 0; i < n_tokens; i++) {
+            n_dependents += (depends[i * words + k / 64] >> (k % 64)) & 1;
+        }
+    }
+
+    state->dependents = malloc(sizeof(size_t) * (n_dependents > 0 ? n_dependents : 1));
+    RETURN_ERROR_IF(state->dependents == NULL, MX_ERR_NO_MEMORY);
+
+    n_dependents = 0;
+
+    for (size_t k = 0; k < n_sets; k++) {
+        state->dependent_start[k] = n_dependents;
+
+        for (size_t i = 0; i < n_tokens; i++) {
+            if ((depends[i * words + k / 64] >> (k % 64)) & 1) {
+                state->dependents[n_dependents++] = i;
+            }
+        }
+    }
+
+    state->dependent_start[n_sets] = n_dependents;
+    state->complete = false;
+
+cleanup:
+    free(depends);
+
+    if (error_code != MX_SUCCESS) {
+        mx_incremental_free(state);
+        return NULL;
+    }
+
+    return state;
+}
+
+mx_error mx_incremental_mark(mx_incremental *state, const char *name) {
+    const mx_program *program = state->program;
+
+    for (size_t k = 0; k < program->n_vars; k++) {
+        if (!state->changed[k] && strcmp(program->vars[k].name, name) == 0) {
+            state->changed[k] = true;
+            state->n_changed++;
+        }
+    }
+
+    return MX_SUCCESS;
+}
+
+static mx_error compute_node(mx_incremental *state, size_t node, const double frame[]) {
+    const mx_token *token = &state->program->tokens[node];
+    const size_t *operands = state->operands + state->operand_start[node];
+    double *values = state->values;
+
+    switch (token->type) {
+    case MX_CONSTANT: {
+        values[node] = token->d.number;
+    } break;
+
+    case MX_VARIABLE: {
+        values[node] = *token->d.var;
+    } break;
+
+    case MX_FLOAT_VARIABLE: {
+        values[node] = *token->d.fvar;
+    } break;
+
+    case MX_FRAME_VARIABLE: {
+        values[node] = frame[token->d.index];
+    } break;
+
+    case MX_BINARY_OPERATOR: {
+        values[node] = token->d.biop.call(values[operands[0]], values[operands[1]]);
+    } break;
+
+    case MX_UNARY_OPERATOR: {
+        values[node] = token->d.unop.call(values[operands[0]]);
+    } break;
+
+    case MX_FUNCTION: {
+        size_t args_num = state->operand_start[node + 1] - state->operand_start[node];
+
+        for (size_t j = 0; j < args_num; j++) {
+            state->args[j] = values[operands[j]];
+        }
+
+        return call_function(token, args_num > 0 ? state->args : NULL, (int)args_num, &values[node]);
+    }
+
+    default: {
+    } break;
+    }
+
+    return MX_SUCCESS;
+}
+
+mx_error mx_incremental_eval(mx_incremental *state, const double frame[], double *result) {
+    const mx_program *program = state->program;
+    size_t volatile_set = program->n_vars;
+    size_t n_pending = 0;
+    mx_error error_code = MX_SUCCESS;
+
+    if (program->frame_size > 0 && frame == NULL) {
+        return MX_ERR_UNDEFINED;
+    }
+
+    if (!state->complete) {
+        for (size_t i = 0; i < program->n_tokens && error_code == MX_SUCCESS; i++) {
+            error_code = compute_node(state, i, frame);
+        }
+    } else {
+        bool volatile_changed = state->dependent_start[volatile_set] < state->dependent_start[volatile_set + 1];
+        size_t n_sets = state->n_changed + (volatile_changed ? 1 : 0);
+        const size_t *nodes = state->pending;
+
+        state->changed[volatile_set] = volatile_changed;
+
+        if (n_sets == 1) {
+            // Change of a single variable is recomputed straight from the list of its dependents
+            for (size_t k = 0; k <= volatile_set; k++) {
+                if (state->changed[k]) {
+                    nodes = state->dependents + state->dependent_start[k];
+                    n_pending = state->dependent_start[k + 1] - state->dependent_start[k];
+                    break;
+                }
+            }
+        } else if (n_sets > 1) {
+            state->generation++;
+
+            for (size_t k = 0; k <= volatile_set; k++) {
+                for (size_t d = state->dependent_start[k]; state->changed[k] && d < state->dependent_start[k + 1]; d++) {
+                    size_t node = state->dependents[d];
+
+                    if (state->marks[node] != state->generation) {
+                        state->marks[node] = state->generation;
+                        state->pending[n_pending++] = node;
+                    }
+                }
+            }
+
+            qsort(state->pending, n_pending, sizeof(size_t), compare_nodes);
+        }
+
+        for (size_t i = 0; i < n_pending && error_code == MX_SUCCESS; i++) {
+            error_code = compute_node(state, nodes[i], frame);
+        }
+    }
+
+    for (size_t k = 0; k <= volatile_set; k++) {
+        state->changed[k] = false;
+    }
+
+    state->n_changed = 0;
+
+    // Failed evaluation leaves some of the nodes stale, so the next one starts over
+    state->complete = error_code == MX_SUCCESS;
+
+    if (error_code == MX_SUCCESS && result != NULL) {
+        *result = state->values[state->root];
+    }
+
+    return error_code;
+}
+
+void mx_incremental_free(mx_incremental *state) {
+    free(state->values);
+    free(state->operands);
+    free(state->operand_start);
+    free(state->dependents);
+    free(state->dependent_start);
+    free(state->changed);
+    free(state->pending);
+    free(state->marks);
+    free(state->args);
+    free(state);
+}
@@ -0,0 +1,377 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+// Required for `mmap` and `MAP_ANONYMOUS` in strict C99 mode
+#define _DEFAULT_SOURCE
+
+#include "mathex.h"
+#include "mx_program.h"
+#include "mx_token.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(MX_NO_JIT) && defined(__x86_64__) && !defined(_WIN32) && (defined(__unix__) || defined(__APPLE__))
+#define HAVE_JIT
+#endif
+
+#ifdef HAVE_JIT
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+// Machine code is generated for System V AMD64 calling convention using only SSE2 instructions.
+// Generated function takes pointer to the evaluation stack followed by temporary slots in `rdi` and keeps it in `rbx`,
+// and pointer to the frame of variables in `rsi` and keeps it in `r12`.
+// Every stack slot has fixed offset from `rbx` known at compile time, so no stack pointer is maintained at runtime.
+
+typedef struct code_buffer {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} code_buffer;
+
+static void emit_bytes(code_buffer *code, const unsigned char *bytes, size_t length) {
+    if (code->length + length > code->capacity) {
+        size_t capacity = code->capacity > 0 ? 2 * code->capacity : 256;
+
+        while (capacity < code->length + length) {
+            capacity *= 2;
+        }
+
+        unsigned char *data = realloc(code->data, capacity);
+
+        if (data == NULL) {
+            code->failed = true;
+            return;
+        }
+
+        code->data = data;
+        code->capacity = capacity;
+    }
+
+    memcpy(code->data + code->length, bytes, length);
+    code->length += length;
+}
+
+#define EMIT(code, ...)                              \
+    do {                                             \
+        const unsigned char bytes[] = {__VA_ARGS__}; \
+        emit_bytes(code, bytes, sizeof(bytes));      \
+    } while (0)
+
+static void emit_u32(code_buffer *code, uint32_t value) {
+    unsigned char bytes[4];
+
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+
+    emit_bytes(code, bytes, sizeof(bytes));
+}
+
+static void emit_u64(code_buffer *code, uint64_t value) {
+    unsigned char bytes[8];
+
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+
+    emit_bytes(code, bytes, sizeof(bytes));
+}
+
+// mov rax, imm64
+static void emit_load_rax(code_buffer *code, uint64_t value) {
+    EMIT(code, 0x48, 0xB8);
+    emit_u64(code, value);
+}
+
+// mov rax, [rbx + slot]
+static void emit_load_rax_slot(code_buffer *code, size_t slot) {
+    EMIT(code, 0x48, 0x8B, 0x83);
+    emit_u32(code, (uint32_t)(slot * sizeof(double)));
+}
+
+// mov [rbx + slot], rax
+static void emit_store_rax(code_buffer *code, size_t slot) {
+    EMIT(code, 0x48, 0x89, 0x83);
+    emit_u32(code, (uint32_t)(slot * sizeof(double)));
+}
+
+// movsd xmm, [rbx + slot]
+static void emit_load_xmm(code_buffer *code, unsigned char xmm, size_t slot) {
+    EMIT(code, 0xF2, 0x0F, 0x10, (unsigned char)(0x83 | (xmm << 3)));
+    emit_u32(code, (uint32_t)(slot * sizeof(double)));
+}
+
+// movsd [rbx + slot], xmm0
+static void emit_store_xmm0(code_buffer *code, size_t slot) {
+    EMIT(code, 0xF2, 0x0F, 0x11, 0x83);
+    emit_u32(code, (uint32_t)(slot * sizeof(double)));
+}
+
+// mov rax, imm64; call rax
+static void emit_call(code_buffer *code, uint64_t address) {
+    emit_load_rax(code, address);
+    EMIT(code, 0xFF, 0xD0);
+}
+
+static uint64_t pointer_bits(const void *pointer) {
+    return (uint64_t)(uintptr_t)pointer;
+}
+
+static uint64_t function_bits(void (*function)(void)) {
+    uint64_t bits;
+    memcpy(&bits, &function, sizeof(bits));
+    return bits;
+}
+
+static uint64_t double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Generates machine code for the program. Returns false if ran out of memory.
+static bool generate(const mx_program *program, code_buffer *code) {
+    size_t *exits = malloc(sizeof(size_t) * (program->n_args > 0 ? program->n_args : 1));
+    size_t n_exits = 0;
+    const int *args = program->args;
+    size_t top = 0;
+
+    if (exits == NULL) {
+        return false;
+    }
+
+    // push rbx; push r12; mov rbx, rdi; mov r12, rsi; sub rsp, 8
+    EMIT(code, 0x53, 0x41, 0x54, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4, 0x48, 0x83, 0xEC, 0x08);
+
+    for (size_t i = 0; i < program->n_tokens; i++) {
+        mx_token token = program->tokens[i];
+
+        switch (token.type) {
+        case MX_CONSTANT: {
+            emit_load_rax(code, double_bits(token.d.number));
+            emit_store_rax(code, top++);
+        } break;
+
+        case MX_VARIABLE: {
+            // mov rax, [rax]
+            emit_load_rax(code, pointer_bits(token.d.var));
+            EMIT(code, 0x48, 0x8B, 0x00);
+            emit_store_rax(code, top++);
+        } break;
+
+        case MX_FLOAT_VARIABLE: {
+            // cvtss2sd xmm0, [rax]
+            emit_load_rax(code, pointer_bits(token.d.fvar));
+            EMIT(code, 0xF3, 0x0F, 0x5A, 0x00);
+            emit_store_xmm0(code, top++);
+        } break;
+
+        case MX_FRAME_VARIABLE: {
+            // mov rax, [r12 + index]
+            EMIT(code, 0x49, 0x8B, 0x84, 0x24);
+            emit_u32(code, (uint32_t)(token.d.index * sizeof(double)));
+            emit_store_rax(code, top++);
+        } break;
+
+        case MX_BINARY_OPERATOR: {
+            top--;
+            emit_load_xmm(code, 0, top - 1);
+
+            switch (token.d.biop.op) {
+            case MX_OP_ADD:
+            case MX_OP_SUB:
+            case MX_OP_MUL:
+            case MX_OP_DIV: {
+                // addsd/subsd/mulsd/divsd xmm0, [rbx + slot]
+                static const unsigned char opcodes[] = {[MX_OP_ADD] = 0x58, [MX_OP_SUB] = 0x5C, [MX_OP_MUL] = 0x59, [MX_OP_DIV] = 0x5E};
+                EMIT(code, 0xF2, 0x0F, opcodes[token.d.biop.op], 0x83);
+                emit_u32(code, (uint32_t)(top * sizeof(double)));
+            } break;
+
+            default: {
+                emit_load_xmm(code, 1, top);
+                emit_call(code, function_bits((void (*)(void))token.d.biop.call));
+            } break;
+            }
+
+            emit_store_xmm0(code, top - 1);
+        } break;
+
+        case MX_UNARY_OPERATOR: {
+            if (token.d.unop.op == MX_OP_NEG) {
+                // xor [rbx + slot], rax
+                emit_load_rax(code, 0x8000000000000000);
+                EMIT(code, 0x48, 0x31, 0x83);
+                emit_u32(code, (uint32_t)((top - 1) * sizeof(double)));
+            } else if (token.d.unop.op == MX_OP_ABS) {
+                // btr qword [rbx + slot], 63
+                EMIT(code, 0x48, 0x0F, 0xBA, 0xB3);
+                emit_u32(code, (uint32_t)((top - 1) * sizeof(double)));
+                EMIT(code, 0x3F);
+            } else if (token.d.unop.op == MX_OP_SQRT) {
+                // sqrtsd xmm0, [rbx + slot]
+                EMIT(code, 0xF2, 0x0F, 0x51, 0x83);
+                emit_u32(code, (uint32_t)((top - 1) * sizeof(double)));
+                emit_store_xmm0(code, top - 1);
+            } else if (token.d.unop.op != MX_OP_POS) {
+                emit_load_xmm(code, 0, top - 1);
+                emit_call(code, function_bits((void (*)(void))token.d.unop.call));
+                emit_store_xmm0(code, top - 1);
+            }
+        } break;
+
+        case MX_STORE: {
+            emit_load_rax_slot(code, top - 1);
+            emit_store_rax(code, program->depth + token.d.slot);
+        } break;
+
+        case MX_LOAD: {
+            emit_load_rax_slot(code, program->depth + token.d.slot);
+            emit_store_rax(code, top++);
+        } break;
+
+        case MX_FUNCTION: {
+            int args_num = *args++;
+            top -= (size_t)args_num;
+
+            if (args_num > 0) {
+                // lea rdi, [rbx + slot]
+                EMIT(code, 0x48, 0x8D, 0xBB);
+                emit_u32(code, (uint32_t)(top * sizeof(double)));
+            } else {
+                // xor edi, edi
+                EMIT(code, 0x31, 0xFF);
+            }
+
+            // mov esi, imm32; mov rdx, rsp; mov rcx, imm64
+            EMIT(code, 0xBE);
+            emit_u32(code, (uint32_t)args_num);
+            EMIT(code, 0x48, 0x89, 0xE2, 0x48, 0xB9);
+
+            // Single-precision functions are called through a wrapper converting the arguments, which takes the token as data
+            if (token.d.func.flags & FUNC_SINGLE) {
+                emit_u64(code, pointer_bits(&program->tokens[i]));
+                emit_call(code, function_bits((void (*)(void))call_single));
+            } else {
+                emit_u64(code, pointer_bits(token.d.func.data));
+                emit_call(code, function_bits((void (*)(void))token.d.func.call));
+            }
+
+            // test eax, eax; jnz exit
+            EMIT(code, 0x85, 0xC0, 0x0F, 0x85);
+            exits[n_exits++] = code->length;
+            emit_u32(code, 0);
+
+            // mov rax, [rsp]
+            EMIT(code, 0x48, 0x8B, 0x04, 0x24);
+            emit_store_rax(code, top++);
+        } break;
+
+        default: {
+        } break;
+        }
+    }
+
+    // xor eax, eax
+    EMIT(code, 0x31, 0xC0);
+
+    if (!code->failed) {
+        for (size_t i = 0; i < n_exits; i++) {
+            uint32_t offset = (uint32_t)(code->length - (exits[i] + 4));
+
+            for (int j = 0; j < 4; j++) {
+                code->data[exits[i] + (size_t)j] = (unsigned char)(offset >> (8 * j));
+            }
+        }
+    }
+
+    // add rsp, 8; pop r12; pop rbx; ret
+    EMIT(code, 0x48, 0x83, 0xC4, 0x08, 0x41, 0x5C, 0x5B, 0xC3);
+
+    free(exits);
+    return !code->failed;
+}
+#endif
+
+mx_error mx_program_jit(mx_program *program) {
+#ifdef HAVE_JIT
+    if (program->native != NULL) {
+        return MX_SUCCESS;
+    }
+
+    // Offsets of stack slots and frame variables are encoded as 32-bit displacements
+    if (program->depth + program->n_slots > INT32_MAX / sizeof(double) || program->frame_size > INT32_MAX / sizeof(double)) {
+        return MX_ERR_NOT_SUPPORTED;
+    }
+
+    code_buffer code = {.data = NULL, .length = 0, .capacity = 0, .failed = false};
+
+    if (!generate(program, &code)) {
+        free(code.data);
+        return MX_ERR_NO_MEMORY;
+    }
+
+    // Pages are never writable and executable at the same time
+    void *memory = mmap(NULL, code.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (memory == MAP_FAILED) {
+        free(code.data);
+        return MX_ERR_NO_MEMORY;
+    }
+
+    memcpy(memory, code.data, code.length);
+    free(code.data);
+
+    if (mprotect(memory, code.length, PROT_READ | PROT_EXEC) != 0) {
+        // Executable memory is forbidden by the system
+        munmap(memory, code.length);
+        return MX_ERR_NOT_SUPPORTED;
+    }
+
+    program->native_size = code.length;
+    memcpy(&program->native, &memory, sizeof(memory));
+
+    return MX_SUCCESS;
+#else
+    (void)program;
+    return MX_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void program_release_native(mx_program *program) {
+#ifdef HAVE_JIT
+    if (program->native != NULL) {
+        void *memory;
+        memcpy(&memory, &program->native, sizeof(memory));
+        munmap(memory, program->native_size);
+        program->native = NULL;
+    }
+#else
+    (void)program;
+#endif
+}
@@ -0,0 +1,528 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "mx_kernels.h"
+#include "mx_token.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#if !defined(MX_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// Scalar kernels of built-in functions call the C library for every element.
+
+#define LIBM_BINARY_KERNEL(name, type, function)                                \
+    static void name(type *restrict a, const type *restrict b, size_t length) { \
+        for (size_t i = 0; i < length; i++) {                                   \
+            a[i] = function(a[i], b[i]);                                        \
+        }                                                                       \
+    }
+
+#define LIBM_UNARY_KERNEL(name, type, function) \
+    static void name(type *x, size_t length) {  \
+        for (size_t i = 0; i < length; i++) {   \
+            x[i] = function(x[i]);              \
+        }                                       \
+    }
+
+LIBM_BINARY_KERNEL(min_scalar, double, fmin)
+LIBM_BINARY_KERNEL(max_scalar, double, fmax)
+LIBM_UNARY_KERNEL(sin_scalar, double, sin)
+LIBM_UNARY_KERNEL(cos_scalar, double, cos)
+LIBM_UNARY_KERNEL(exp_scalar, double, exp)
+LIBM_UNARY_KERNEL(log_scalar, double, log)
+LIBM_UNARY_KERNEL(sqrt_scalar, double, sqrt)
+LIBM_UNARY_KERNEL(abs_scalar, double, fabs)
+LIBM_UNARY_KERNEL(floor_scalar, double, floor)
+LIBM_UNARY_KERNEL(ceil_scalar, double, ceil)
+
+LIBM_BINARY_KERNEL(min_scalar_f, float, fminf)
+LIBM_BINARY_KERNEL(max_scalar_f, float, fmaxf)
+LIBM_UNARY_KERNEL(sin_scalar_f, float, sinf)
+LIBM_UNARY_KERNEL(cos_scalar_f, float, cosf)
+LIBM_UNARY_KERNEL(exp_scalar_f, float, expf)
+LIBM_UNARY_KERNEL(log_scalar_f, float, logf)
+LIBM_UNARY_KERNEL(sqrt_scalar_f, float, sqrtf)
+LIBM_UNARY_KERNEL(abs_scalar_f, float, fabsf)
+LIBM_UNARY_KERNEL(floor_scalar_f, float, floorf)
+LIBM_UNARY_KERNEL(ceil_scalar_f, float, ceilf)
+
+// Exponentiation and modulus have no vector instructions, so they share scalar kernels on every instruction set.
+
+LIBM_BINARY_KERNEL(pow_double, double, pow)
+LIBM_BINARY_KERNEL(mod_double, double, fmod)
+LIBM_BINARY_KERNEL(pow_float, float, powf)
+LIBM_BINARY_KERNEL(mod_float, float, fmodf)
+
+static void pos_double(double *x, size_t length) {
+    (void)x;
+    (void)length;
+}
+
+static void pos_float(float *x, size_t length) {
+    (void)x;
+    (void)length;
+}
+
+// Defines kernel processing `width` elements per iteration as vector of type `vector`.
+// Expression `expr` computes the result from `va` and `vb`, and has to be valid for both vectors and scalars.
+#define BINARY_KERNEL(name, attributes, type, vector, width, expr)                         \
+    attributes static void name(type *restrict a, const type *restrict b, size_t length) { \
+        size_t i = 0;                                                                      \
+                                                                                           \
+        for (; i + (width) <= length; i += (width)) {                                      \
+            vector va, vb;                                                                 \
+            memcpy(&va, a + i, sizeof(va));                                                \
+            memcpy(&vb, b + i, sizeof(vb));                                                \
+            va = (expr);                                                                   \
+            memcpy(a + i, &va, sizeof(va));                                                \
+        }                                                                                  \
+                                                                                           \
+        for (; i < length; i++) {                                                          \
+            type va = a[i], vb = b[i];                                                     \
+            a[i] = (expr);                                                                 \
+        }                                                                                  \
+    }
+
+#define UNARY_KERNEL(name, attributes, type, vector, width, expr) \
+    attributes static void name(type *x, size_t length) {         \
+        size_t i = 0;                                             \
+                                                                  \
+        for (; i + (width) <= length; i += (width)) {             \
+            vector va;                                            \
+            memcpy(&va, x + i, sizeof(va));                       \
+            va = (expr);                                          \
+            memcpy(x + i, &va, sizeof(va));                       \
+        }                                                         \
+                                                                  \
+        for (; i < length; i++) {                                 \
+            type va = x[i];                                       \
+            x[i] = (expr);                                        \
+        }                                                         \
+    }
+
+// Kernels applying vector function `function` to `width` elements at a time. Remaining elements are
+// padded into one more vector, so every element goes through the same approximation.
+#define VECTOR_BINARY_KERNEL(name, attributes, type, vector, width, function)              \
+    attributes static void name(type *restrict a, const type *restrict b, size_t length) { \
+        size_t i = 0;                                                                      \
+        vector va = {0}, vb = {0};                                                         \
+                                                                                           \
+        for (; i + (width) <= length; i += (width)) {                                      \
+            memcpy(&va, a + i, sizeof(va));                                                \
+            memcpy(&vb, b + i, sizeof(vb));                                                \
+            va = function(va, vb);                                                         \
+            memcpy(a + i, &va, sizeof(va));                                                \
+        }                                                                                  \
+                                                                                           \
+        if (i < length) {                                                                  \
+            memcpy(&va, a + i, sizeof(type) * (length - i));                               \
+            memcpy(&vb, b + i, sizeof(type) * (length - i));                               \
+            va = function(va, vb);                                                         \
+            memcpy(a + i, &va, sizeof(type) * (length - i));                               \
+        }                                                                                  \
+    }
+
+#define VECTOR_UNARY_KERNEL(name, attributes, type, vector, width, function) \
+    attributes static void name(type *x, size_t length) {                    \
+        size_t i = 0;                                                        \
+        vector va = {0};                                                     \
+                                                                             \
+        for (; i + (width) <= length; i += (width)) {                        \
+            memcpy(&va, x + i, sizeof(va));                                  \
+            va = function(va);                                               \
+            memcpy(x + i, &va, sizeof(va));                                  \
+        }                                                                    \
+                                                                             \
+        if (i < length) {                                                    \
+            memcpy(&va, x + i, sizeof(type) * (length - i));                 \
+            va = function(va);                                               \
+            memcpy(x + i, &va, sizeof(type) * (length - i));                 \
+        }                                                                    \
+    }
+
+// Polynomial approximations of built-in functions on vectors of type `vector`, with `ivector` being
+// vector of 64-bit integers of the same size. Results are within 1 ulp of correctly rounded value.
+// Comparisons of vectors give masks with all bits of matching elements set.
+// Integers are converted to and from doubles by adding 1.5 * 2^52, which leaves the integer in low bits.
+// `exp` reduces the argument with the split of ln 2 from fdlibm and evaluates Taylor series of exp(r) up to r^13.
+// `log` uses argument reduction and polynomial of fdlibm (coefficients Lg1 to Lg7).
+// `sin` and `cos` use medium-size argument reduction of fdlibm, with pi / 2 split into three parts, and its
+// polynomials (coefficients S1 to S6 and C1 to C6).
+#define MATH_FUNCTIONS(suffix, attributes, vector, ivector, width, sqrt_intrinsic)                                                                                                                                                    \
+    attributes static inline vector select_##suffix(ivector mask, vector a, vector b) {                                                                                                                                               \
+        return (vector)(((ivector)a & mask) | ((ivector)b & ~mask));                                                                                                                                                                  \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    attributes static inline vector min_vector_##suffix(vector a, vector b) {                                                                                                                                                         \
+        return select_##suffix((ivector)(a < b) | (ivector)(b != b), a, b);                                                                                                                                                           \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    attributes static inline vector max_vector_##suffix(vector a, vector b) {                                                                                                                                                         \
+        return select_##suffix((ivector)(a > b) | (ivector)(b != b), a, b);                                                                                                                                                           \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    attributes static inline vector abs_vector_##suffix(vector x) {                                                                                                                                                                   \
+        return (vector)((ivector)x & 0x7FFFFFFFFFFFFFFF);                                                                                                                                                                             \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    attributes static inline vector sqrt_vector_##suffix(vector x) {                                                                                                                                                                  \
+        return sqrt_intrinsic(x);                                                                                                                                                                                                     \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    /* Rounds to nearest integer, keeping sign of zero. Numbers from 2^52 up are integers already. */                                                                                                                                 \
+    attributes static inline vector round_vector_##suffix(vector x) {                                                                                                                                                                 \
+        vector ax = abs_vector_##suffix(x);                                                                                                                                                                                           \
+        vector rounded = (vector)((ivector)((ax + 0x1p52) - 0x1p52) | ((ivector)x & ~0x7FFFFFFFFFFFFFFF));                                                                                                                            \
+        return select_##suffix((ivector)(ax < 0x1p52), rounded, x);                                                                                                                                                                   \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    attributes static inline vector floor_vector_##suffix(vector x) {                                                                                                                                                                 \
+        vector rounded = round_vector_##suffix(x);                                                                                                                                                                                    \
+        return select_##suffix((ivector)(rounded > x), rounded - 1.0, rounded);                                                                                                                                                       \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    attributes static inline vector ceil_vector_##suffix(vector x) {                                                                                                                                                                  \
+        vector rounded = round_vector_##suffix(x);                                                                                                                                                                                    \
+        return select_##suffix((ivector)(rounded < x), rounded + 1.0, rounded);                                                                                                                                                       \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    /* exp(x) = 2^k * exp(r), where k = round(x / ln 2) and |r| <= ln 2 / 2 */                                                                                                                                                        \
+    attributes static inline vector exp_vector_##suffix(vector x) {                                                                                                                                                                   \
+        vector magic = (vector){0} + 0x1.8p52;                                                                                                                                                                                        \
+        vector clamped = select_##suffix((ivector)(x > 710.0), (vector){0} + 710.0, x);                                                                                                                                               \
+        clamped = select_##suffix((ivector)(clamped < -746.0), (vector){0} - 746.0, clamped);                                                                                                                                         \
+                                                                                                                                                                                                                                      \
+        vector t = clamped * 1.44269504088896338700e+00 + magic;                                                                                                                                                                      \
+        vector k = t - magic;                                                                                                                                                                                                         \
+        ivector ki = (ivector)t - (ivector)magic;                                                                                                                                                                                     \
+        vector r = (clamped - k * 6.93147180369123816490e-01) - k * 1.90821492927058770002e-10;                                                                                                                                       \
+                                                                                                                                                                                                                                      \
+        /* Taylor series up to r^13 */                                                                                                                                                                                                \
+        vector p = r * (1.0 / 6227020800.0) + 1.0 / 479001600.0;                                                                                                                                                                      \
+        p = p * r + 1.0 / 39916800.0;                                                                                                                                                                                                 \
+        p = p * r + 1.0 / 3628800.0;                                                                                                                                                                                                  \
+        p = p * r + 1.0 / 362880.0;                                                                                                                                                                                                   \
+        p = p * r + 1.0 / 40320.0;                                                                                                                                                                                                    \
+        p = p * r + 1.0 / 5040.0;                                                                                                                                                                                                     \
+        p = p * r + 1.0 / 720.0;                                                                                                                                                                                                      \
+        p = p * r + 1.0 / 120.0;                                                                                                                                                                                                      \
+        p = p * r + 1.0 / 24.0;                                                                                                                                                                                                       \
+        p = p * r + 1.0 / 6.0;                                                                                                                                                                                                        \
+        p = p * r + 0.5;                                                                                                                                                                                                              \
+        p = p * r + 1.0;                                                                                                                                                                                                              \
+        p = p * r + 1.0;                                                                                                                                                                                                              \
+                                                                                                                                                                                                                                      \
+        /* 2^k is applied in two halves, so that neither overflows or becomes subnormal */                                                                                                                                            \
+        ivector k1 = ki >> 1, k2 = ki - k1;                                                                                                                                                                                           \
+        vector y = p * (vector)((k1 + 1023) << 52) * (vector)((k2 + 1023) << 52);                                                                                                                                                     \
+        return select_##suffix((ivector)(x != x), x, y);                                                                                                                                                                              \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    /* log(x) = k * ln 2 + log(1 + f), where x = 2^k * (1 + f) and sqrt(2) / 2 <= 1 + f < sqrt(2) */                                                                                                                                  \
+    attributes static inline vector log_vector_##suffix(vector x) {                                                                                                                                                                   \
+        vector magic = (vector){0} + 0x1.8p52;                                                                                                                                                                                        \
+        ivector subnormal = (ivector)(x < 0x1p-1022);                                                                                                                                                                                 \
+        ivector bits = (ivector)select_##suffix(subnormal, x * 0x1p54, x);                                                                                                                                                            \
+        ivector ki = ((bits >> 52) & 0x7FF) - 1023 - (subnormal & 54);                                                                                                                                                                \
+        vector m = (vector)((bits & 0x000FFFFFFFFFFFFF) | 0x3FF0000000000000);                                                                                                                                                        \
+        ivector large = (ivector)(m > 1.41421356237309514547e+00);                                                                                                                                                                    \
+        m = select_##suffix(large, m * 0.5, m);                                                                                                                                                                                       \
+        ki = ki - large;                                                                                                                                                                                                              \
+                                                                                                                                                                                                                                      \
+        vector f = m - 1.0;                                                                                                                                                                                                           \
+        vector k = (vector)((ivector)magic + ki) - magic;                                                                                                                                                                             \
+        vector hfsq = 0.5 * f * f;                                                                                                                                                                                                    \
+        vector s = f / (2.0 + f);                                                                                                                                                                                                     \
+        vector z = s * s, w = z * z;                                                                                                                                                                                                  \
+        vector t1 = w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));                                                                                                                   \
+        vector t2 = z * (6.666666666666735130e-01 + w * (2.857142874366239149e-01 + w * (1.818357216161805012e-01 + w * 1.479819860511658591e-01)));                                                                                  \
+        vector R = t2 + t1;                                                                                                                                                                                                           \
+        vector y = k * 6.93147180369123816490e-01 - ((hfsq - (s * (hfsq + R) + k * 1.90821492927058770002e-10)) - f);                                                                                                                 \
+                                                                                                                                                                                                                                      \
+        y = select_##suffix((ivector)(x == 0.0), (vector){0} - INFINITY, y);                                                                                                                                                          \
+        y = select_##suffix((ivector)(x == INFINITY), x, y);                                                                                                                                                                          \
+        return select_##suffix((ivector)(x < 0.0) | (ivector)(x != x), (vector){0} + NAN, y);                                                                                                                                         \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    /* sin and cos of r = x - q * pi / 2, with |r| <= pi / 4 and pi / 2 split into three parts.                                                                                                                                       \
+       Reduction is exact while q * pi / 2 fits into 2^20 multiples, larger arguments are left to the C library. */                                                                                                                   \
+    attributes static inline vector sincos_vector_##suffix(vector x, int cosine) {                                                                                                                                                    \
+        vector magic = (vector){0} + 0x1.8p52;                                                                                                                                                                                        \
+        vector t = x * 6.36619772367581382433e-01 + magic;                                                                                                                                                                            \
+        vector q = t - magic;                                                                                                                                                                                                         \
+        ivector qi = (ivector)t - (ivector)magic + cosine;                                                                                                                                                                            \
+                                                                                                                                                                                                                                      \
+        vector a = x - q * 1.57079632673412561417e+00;                                                                                                                                                                                \
+        vector w1 = q * 6.07710050630396597660e-11;                                                                                                                                                                                   \
+        vector r = a - w1;                                                                                                                                                                                                            \
+        vector w = q * 2.02226624879595063154e-21 - ((a - r) - w1);                                                                                                                                                                   \
+        vector y0 = r - w;                                                                                                                                                                                                            \
+        vector y1 = (r - y0) - w;                                                                                                                                                                                                     \
+                                                                                                                                                                                                                                      \
+        vector z = y0 * y0, v = z * y0;                                                                                                                                                                                               \
+        vector rs = 8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06 + z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)));                                           \
+        vector ps = y0 - ((z * (0.5 * y1 - v * rs) - y1) - v * -1.66666666666666324348e-01);                                                                                                                                          \
+        vector rc = z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11))))); \
+        vector hz = 0.5 * z, wc = 1.0 - hz;                                                                                                                                                                                           \
+        vector pc = wc + (((1.0 - wc) - hz) + (z * rc - y0 * y1));                                                                                                                                                                    \
+                                                                                                                                                                                                                                      \
+        /* Odd quadrants swap sin and cos, quadrants 2 and 3 negate them */                                                                                                                                                           \
+        vector y = (vector)((ivector)select_##suffix(-(qi & 1), pc, ps) ^ ((qi & 2) << 62));                                                                                                                                          \
+        y = select_##suffix((ivector)(x == 0.0) & (cosine - 1), x, y);                                                                                                                                                                \
+                                                                                                                                                                                                                                      \
+        for (int j = 0; j < (width); j++) {                                                                                                                                                                                           \
+            if (!(fabs(x[j]) < 0x1p19)) {                                                                                                                                                                                             \
+                y[j] = cosine ? cos(x[j]) : sin(x[j]);                                                                                                                                                                                \
+            }                                                                                                                                                                                                                         \
+        }                                                                                                                                                                                                                             \
+                                                                                                                                                                                                                                      \
+        return y;                                                                                                                                                                                                                     \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    attributes static inline vector sin_vector_##suffix(vector x) {                                                                                                                                                                   \
+        return sincos_vector_##suffix(x, 0);                                                                                                                                                                                          \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    attributes static inline vector cos_vector_##suffix(vector x) {                                                                                                                                                                   \
+        return sincos_vector_##suffix(x, 1);                                                                                                                                                                                          \
+    }                                                                                                                                                                                                                                 \
+                                                                                                                                                                                                                                      \
+    VECTOR_BINARY_KERNEL(min_##suffix, attributes, double, vector, width, min_vector_##suffix)                                                                                                                                        \
+    VECTOR_BINARY_KERNEL(max_##suffix, attributes, double, vector, width, max_vector_##suffix)                                                                                                                                        \
+    VECTOR_UNARY_KERNEL(sin_##suffix, attributes, double, vector, width, sin_vector_##suffix)                                                                                                                                         \
+    VECTOR_UNARY_KERNEL(cos_##suffix, attributes, double, vector, width, cos_vector_##suffix)                                                                                                                                         \
+    VECTOR_UNARY_KERNEL(exp_##suffix, attributes, double, vector, width, exp_vector_##suffix)                                                                                                                                         \
+    VECTOR_UNARY_KERNEL(log_##suffix, attributes, double, vector, width, log_vector_##suffix)                                                                                                                                         \
+    VECTOR_UNARY_KERNEL(sqrt_##suffix, attributes, double, vector, width, sqrt_vector_##suffix)                                                                                                                                       \
+    VECTOR_UNARY_KERNEL(abs_##suffix, attributes, double, vector, width, abs_vector_##suffix)                                                                                                                                         \
+    VECTOR_UNARY_KERNEL(floor_##suffix, attributes, double, vector, width, floor_vector_##suffix)                                                                                                                                     \
+    VECTOR_UNARY_KERNEL(ceil_##suffix, attributes, double, vector, width, ceil_vector_##suffix)
+
+// Number of elements converted at once by single-precision kernels computed in double precision.
+#define WIDENED_LENGTH 64
+
+// Single-precision kernel converting elements to double and applying double-precision kernel `function` to them.
+// Whole blocks have constant length, so that the compiler vectorizes the conversions.
+#define WIDENED_UNARY_KERNEL(name, attributes, function)                             \
+    attributes static inline void name##_block(float *x, double *buffer, size_t n) { \
+        for (size_t i = 0; i < n; i++) {                                             \
+            buffer[i] = x[i];                                                        \
+        }                                                                            \
+                                                                                     \
+        function(buffer, n);                                                         \
+                                                                                     \
+        for (size_t i = 0; i < n; i++) {                                             \
+            x[i] = (float)buffer[i];                                                 \
+        }                                                                            \
+    }                                                                                \
+                                                                                     \
+    attributes static void name(float *x, size_t length) {                           \
+        double buffer[WIDENED_LENGTH];                                               \
+        size_t i = 0;                                                                \
+                                                                                     \
+        for (; i + WIDENED_LENGTH <= length; i += WIDENED_LENGTH) {                  \
+            name##_block(x + i, buffer, WIDENED_LENGTH);                             \
+        }                                                                            \
+                                                                                     \
+        if (i < length) {                                                            \
+            name##_block(x + i, buffer, length - i);                                 \
+        }                                                                            \
+    }
+
+// Built-in functions on vectors of floats, with `ivector` being vector of 32-bit integers of the same size.
+// Functions without exact vector implementation are computed by double-precision kernels of instruction set
+// `double_suffix`, whose results are within 1 ulp of double, so they round to nearly always correct float.
+#define SINGLE_FUNCTIONS(suffix, attributes, vector, ivector, width, sqrt_intrinsic, double_suffix)   \
+    attributes static inline vector select_##suffix(ivector mask, vector a, vector b) {               \
+        return (vector)(((ivector)a & mask) | ((ivector)b & ~mask));                                  \
+    }                                                                                                 \
+                                                                                                      \
+    attributes static inline vector min_vector_##suffix(vector a, vector b) {                         \
+        return select_##suffix((ivector)(a < b) | (ivector)(b != b), a, b);                           \
+    }                                                                                                 \
+                                                                                                      \
+    attributes static inline vector max_vector_##suffix(vector a, vector b) {                         \
+        return select_##suffix((ivector)(a > b) | (ivector)(b != b), a, b);                           \
+    }                                                                                                 \
+                                                                                                      \
+    attributes static inline vector abs_vector_##suffix(vector x) {                                   \
+        return (vector)((ivector)x & 0x7FFFFFFF);                                                     \
+    }                                                                                                 \
+                                                                                                      \
+    attributes static inline vector sqrt_vector_##suffix(vector x) {                                  \
+        return sqrt_intrinsic(x);                                                                     \
+    }                                                                                                 \
+                                                                                                      \
+    /* Rounds to nearest integer, keeping sign of zero. Numbers from 2^23 up are integers already. */ \
+    attributes static inline vector round_vector_##suffix(vector x) {                                 \
+        vector ax = abs_vector_##suffix(x);                                                           \
+        vector rounded = (vector)((ivector)((ax + 0x1p23f) - 0x1p23f) | ((ivector)x & ~0x7FFFFFFF));  \
+        return select_##suffix((ivector)(ax < 0x1p23f), rounded, x);                                  \
+    }                                                                                                 \
+                                                                                                      \
+    attributes static inline vector floor_vector_##suffix(vector x) {                                 \
+        vector rounded = round_vector_##suffix(x);                                                    \
+        return select_##suffix((ivector)(rounded > x), rounded - 1.0f, rounded);                      \
+    }                                                                                                 \
+                                                                                                      \
+    attributes static inline vector ceil_vector_##suffix(vector x) {                                  \
+        vector rounded = round_vector_##suffix(x);                                                    \
+        return select_##suffix((ivector)(rounded < x), rounded + 1.0f, rounded);                      \
+    }                                                                                                 \
+                                                                                                      \
+    VECTOR_BINARY_KERNEL(min_##suffix, attributes, float, vector, width, min_vector_##suffix)         \
+    VECTOR_BINARY_KERNEL(max_##suffix, attributes, float, vector, width, max_vector_##suffix)         \
+    VECTOR_UNARY_KERNEL(sqrt_##suffix, attributes, float, vector, width, sqrt_vector_##suffix)        \
+    VECTOR_UNARY_KERNEL(abs_##suffix, attributes, float, vector, width, abs_vector_##suffix)          \
+    VECTOR_UNARY_KERNEL(floor_##suffix, attributes, float, vector, width, floor_vector_##suffix)      \
+    VECTOR_UNARY_KERNEL(ceil_##suffix, attributes, float, vector, width, ceil_vector_##suffix)        \
+    WIDENED_UNARY_KERNEL(sin_##suffix, attributes, sin_##double_suffix)                               \
+    WIDENED_UNARY_KERNEL(cos_##suffix, attributes, cos_##double_suffix)                               \
+    WIDENED_UNARY_KERNEL(exp_##suffix, attributes, exp_##double_suffix)                               \
+    WIDENED_UNARY_KERNEL(log_##suffix, attributes, log_##double_suffix)
+
+// Kernels of built-in functions have to be defined for the instruction set before its kernel table.
+#define KERNEL_SET(suffix, attributes, table, type, vector, width)        \
+    BINARY_KERNEL(add_##suffix, attributes, type, vector, width, va + vb) \
+    BINARY_KERNEL(sub_##suffix, attributes, type, vector, width, va - vb) \
+    BINARY_KERNEL(mul_##suffix, attributes, type, vector, width, va * vb) \
+    BINARY_KERNEL(div_##suffix, attributes, type, vector, width, va / vb) \
+    UNARY_KERNEL(neg_##suffix, attributes, type, vector, width, -va)      \
+                                                                          \
+    static const table kernels_##suffix = {                               \
+        .binary = {                                                       \
+            [MX_OP_ADD] = add_##suffix,                                   \
+            [MX_OP_SUB] = sub_##suffix,                                   \
+            [MX_OP_MUL] = mul_##suffix,                                   \
+            [MX_OP_DIV] = div_##suffix,                                   \
+            [MX_OP_POW] = pow_##type,                                     \
+            [MX_OP_MOD] = mod_##type,                                     \
+            [MX_OP_MIN] = min_##suffix,                                   \
+            [MX_OP_MAX] = max_##suffix,                                   \
+        },                                                                \
+        .unary = {                                                        \
+            [MX_OP_POS] = pos_##type,                                     \
+            [MX_OP_NEG] = neg_##suffix,                                   \
+            [MX_OP_SIN] = sin_##suffix,                                   \
+            [MX_OP_COS] = cos_##suffix,                                   \
+            [MX_OP_EXP] = exp_##suffix,                                   \
+            [MX_OP_LOG] = log_##suffix,                                   \
+            [MX_OP_SQRT] = sqrt_##suffix,                                 \
+            [MX_OP_ABS] = abs_##suffix,                                   \
+            [MX_OP_FLOOR] = floor_##suffix,                               \
+            [MX_OP_CEIL] = ceil_##suffix,                                 \
+        },                                                                \
+    };
+
+KERNEL_SET(scalar, , kernel_table, double, double, 1)
+KERNEL_SET(scalar_f, , kernel_table_f, float, float, 1)
+
+#ifdef HAVE_X86_KERNELS
+typedef double sse2_vector __attribute__((vector_size(16)));
+typedef double avx2_vector __attribute__((vector_size(32)));
+typedef double avx512_vector __attribute__((vector_size(64)));
+typedef long long sse2_ivector __attribute__((vector_size(16)));
+typedef long long avx2_ivector __attribute__((vector_size(32)));
+typedef long long avx512_ivector __attribute__((vector_size(64)));
+
+MATH_FUNCTIONS(sse2, __attribute__((target("sse2"))), sse2_vector, sse2_ivector, 2, _mm_sqrt_pd)
+MATH_FUNCTIONS(avx2, __attribute__((target("avx2"))), avx2_vector, avx2_ivector, 4, _mm256_sqrt_pd)
+MATH_FUNCTIONS(avx512, __attribute__((target("avx512f"))), avx512_vector, avx512_ivector, 8, _mm512_sqrt_pd)
+
+KERNEL_SET(sse2, __attribute__((target("sse2"))), kernel_table, double, sse2_vector, 2)
+KERNEL_SET(avx2, __attribute__((target("avx2"))), kernel_table, double, avx2_vector, 4)
+KERNEL_SET(avx512, __attribute__((target("avx512f"))), kernel_table, double, avx512_vector, 8)
+
+typedef float sse2_vector_f __attribute__((vector_size(16)));
+typedef float avx2_vector_f __attribute__((vector_size(32)));
+typedef float avx512_vector_f __attribute__((vector_size(64)));
+typedef int sse2_ivector_f __attribute__((vector_size(16)));
+typedef int avx2_ivector_f __attribute__((vector_size(32)));
+typedef int avx512_ivector_f __attribute__((vector_size(64)));
+
+SINGLE_FUNCTIONS(sse2_f, __attribute__((target("sse2"))), sse2_vector_f, sse2_ivector_f, 4, _mm_sqrt_ps, sse2)
+SINGLE_FUNCTIONS(avx2_f, __attribute__((target("avx2"))), avx2_vector_f, avx2_ivector_f, 8, _mm256_sqrt_ps, avx2)
+SINGLE_FUNCTIONS(avx512_f, __attribute__((target("avx512f"))), avx512_vector_f, avx512_ivector_f, 16, _mm512_sqrt_ps, avx512)
+
+KERNEL_SET(sse2_f, __attribute__((target("sse2"))), kernel_table_f, float, sse2_vector_f, 4)
+KERNEL_SET(avx2_f, __attribute__((target("avx2"))), kernel_table_f, float, avx2_vector_f, 8)
+KERNEL_SET(avx512_f, __attribute__((target("avx512f"))), kernel_table_f, float, avx512_vector_f, 16)
+#endif
+
+// Set by tests to compare vector kernels with scalar ones on the same machine.
+static bool scalar_forced = false;
+
+void force_scalar_kernels(bool force) {
+    scalar_forced = force;
+}
+
+const kernel_table *select_kernels(void) {
+#ifdef HAVE_X86_KERNELS
+    if (scalar_forced) {
+        return &kernels_scalar;
+    }
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f")) {
+        return &kernels_avx512;
+    }
+
+    if (__builtin_cpu_supports("avx2")) {
+        return &kernels_avx2;
+    }
+
+    if (__builtin_cpu_supports("sse2")) {
+        return &kernels_sse2;
+    }
+#endif
+
+    return &kernels_scalar;
+}
+
+const kernel_table_f *select_kernels_f(void) {
+#ifdef HAVE_X86_KERNELS
+    if (scalar_forced) {
+        return &kernels_scalar_f;
+    }
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f")) {
+        return &kernels_avx512_f;
+    }
+
+    if (__builtin_cpu_supports("avx2")) {
+        return &kernels_avx2_f;
+    }
+
+    if (__builtin_cpu_supports("sse2")) {
+        return &kernels_sse2_f;
+    }
+#endif
+
+    return &kernels_scalar_f;
+}
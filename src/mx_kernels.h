@@ -0,0 +1,62 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef MATHEX_KERNELS_H
+#define MATHEX_KERNELS_H
+
+#include "mx_token.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Applies binary operator element-wise, writing results into `a`.
+typedef void (*binary_kernel)(double *restrict a, const double *restrict b, size_t length);
+
+// Applies unary operator element-wise in place.
+typedef void (*unary_kernel)(double *x, size_t length);
+
+// Array implementations of built-in operators, indexed by opcode.
+typedef struct kernel_table {
+    binary_kernel binary[MX_OP_COUNT];
+    unary_kernel unary[MX_OP_COUNT];
+} kernel_table;
+
+// Single-precision variants of kernels.
+typedef void (*binary_kernel_f)(float *restrict a, const float *restrict b, size_t length);
+typedef void (*unary_kernel_f)(float *x, size_t length);
+
+typedef struct kernel_table_f {
+    binary_kernel_f binary[MX_OP_COUNT];
+    unary_kernel_f unary[MX_OP_COUNT];
+} kernel_table_f;
+
+// Returns kernels for the widest instruction set supported by the CPU.
+// Always returns scalar kernels if compiled with `MX_NO_SIMD` defined.
+const kernel_table *select_kernels(void);
+
+// Returns single-precision kernels for the widest instruction set supported by the CPU.
+const kernel_table_f *select_kernels_f(void);
+
+// Makes both selection functions return scalar kernels regardless of the CPU, so tests can compare them with vector ones.
+// Takes effect from the next batch evaluation, as kernels are selected when evaluation starts.
+void force_scalar_kernels(bool force);
+
+#endif /* MATHEX_KERNELS_H */
@@ -0,0 +1,421 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include "mathex.h"
+#include "mx_program.h"
+#include "mx_token.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+size_t program_depth(const mx_program *program) {
+    const int *args = program->args;
+    size_t depth = 0;
+    size_t max_depth = 0;
+
+    for (size_t i = 0; i < program->n_tokens; i++) {
+        switch (program->tokens[i].type) {
+        case MX_CONSTANT:
+        case MX_VARIABLE:
+        case MX_FLOAT_VARIABLE:
+        case MX_FRAME_VARIABLE:
+        case MX_LOAD: {
+            depth++;
+        } break;
+
+        case MX_BINARY_OPERATOR: {
+            depth--;
+        } break;
+
+        case MX_FUNCTION: {
+            depth = depth - (size_t)*args++ + 1;
+        } break;
+
+        default: {
+        } break;
+        }
+
+        if (depth > max_depth) {
+            max_depth = depth;
+        }
+    }
+
+    return max_depth;
+}
+
+// Most arguments of pure function call that can be evaluated during folding.
+#define MAX_FOLDED_ARGS 16
+
+void fold_constants(mx_program *program) {
+    mx_token *tokens = program->tokens;
+    size_t length = 0;
+    size_t n_args = 0;
+    size_t args_read = 0;
+
+    // In postfix notation, operands of an operator are the last values pushed to the stack.
+    // If both of them are constants, they are exactly the last two tokens written to the output.
+    for (size_t i = 0; i < program->n_tokens; i++) {
+        mx_token token = tokens[i];
+
+        if (token.type == MX_BINARY_OPERATOR && length >= 2 && tokens[length - 1].type == MX_CONSTANT && tokens[length - 2].type == MX_CONSTANT) {
+            tokens[length - 2].d.number = token.d.biop.call(tokens[length - 2].d.number, tokens[length - 1].d.number);
+            length--;
+            continue;
+        }
+
+        if (token.type == MX_UNARY_OPERATOR && length >= 1 && tokens[length - 1].type == MX_CONSTANT) {
+            tokens[length - 1].d.number = token.d.unop.call(tokens[length - 1].d.number);
+            continue;
+        }
+
+        if (token.type == MX_FUNCTION) {
+            int args_num = program->args[args_read++];
+            bool constant = (token.d.func.flags & MX_FUNC_PURE) && args_num <= MAX_FOLDED_ARGS && length >= (size_t)args_num;
+
+            for (int j = 1; constant && j <= args_num; j++) {
+                constant = tokens[length - (size_t)j].type == MX_CONSTANT;
+            }
+
+            double args[MAX_FOLDED_ARGS];
+            double result;
+
+            for (int j = 0; constant && j < args_num; j++) {
+                args[j] = tokens[length - (size_t)(args_num - j)].d.number;
+            }
+
+            // Calls that fail are left to report the error when evaluated
+            if (constant && call_function(&token, args_num > 0 ? args : NULL, args_num, &result) == MX_SUCCESS) {
+                length -= (size_t)args_num;
+                tokens[length].type = MX_CONSTANT;
+                tokens[length].d.number = result;
+                length++;
+                continue;
+            }
+
+            program->args[n_args++] = args_num;
+        }
+
+        tokens[length++] = token;
+    }
+
+    program->n_tokens = length;
+    program->n_args = n_args;
+    program->depth = program_depth(program);
+}
+
+// Node of expression tree built from postfix tokens.
+typedef struct tree_node {
+    size_t id;       // equal for identical subtrees
+    size_t children; // offset of the first child in array of children
+    int n_children;
+} tree_node;
+
+static size_t hash_token(const mx_token *token) {
+    size_t hash = (size_t)token->type;
+    const unsigned char *bytes;
+    size_t length;
+
+    switch (token->type) {
+    case MX_CONSTANT: {
+        bytes = (const unsigned char *)&token->d.number;
+        length = sizeof(token->d.number);
+    } break;
+
+    case MX_VARIABLE: {
+        bytes = (const unsigned char *)&token->d.var;
+        length = sizeof(token->d.var);
+    } break;
+
+    case MX_FLOAT_VARIABLE: {
+        bytes = (const unsigned char *)&token->d.fvar;
+        length = sizeof(token->d.fvar);
+    } break;
+
+    case MX_FRAME_VARIABLE: {
+        bytes = (const unsigned char *)&token->d.index;
+        length = sizeof(token->d.index);
+    } break;
+
+    case MX_FUNCTION: {
+        bytes = (const unsigned char *)&token->d.func.data;
+        length = sizeof(token->d.func.data);
+    } break;
+
+    case MX_BINARY_OPERATOR: {
+        bytes = (const unsigned char *)&token->d.biop.op;
+        length = sizeof(token->d.biop.op);
+    } break;
+
+    case MX_UNARY_OPERATOR: {
+        bytes = (const unsigned char *)&token->d.unop.op;
+        length = sizeof(token->d.unop.op);
+    } break;
+
+    default: {
+        length = 0;
+    } break;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        hash = 37 * hash + bytes[i];
+    }
+
+    return hash;
+}
+
+static bool same_token(const mx_token *a, const mx_token *b) {
+    if (a->type != b->type) {
+        return false;
+    }
+
+    switch (a->type) {
+    case MX_CONSTANT:
+        return memcmp(&a->d.number, &b->d.number, sizeof(a->d.number)) == 0;
+
+    case MX_VARIABLE:
+        return a->d.var == b->d.var;
+
+    case MX_FLOAT_VARIABLE:
+        return a->d.fvar == b->d.fvar;
+
+    case MX_FRAME_VARIABLE:
+        return a->d.index == b->d.index;
+
+    case MX_FUNCTION:
+        // Impure functions have to be called every time they appear
+        return a->d.func.call == b->d.func.call && a->d.func.data == b->d.func.data && (a->d.func.flags & MX_FUNC_PURE);
+
+    case MX_BINARY_OPERATOR:
+        return a->d.biop.op == b->d.biop.op;
+
+    case MX_UNARY_OPERATOR:
+        return a->d.unop.op == b->d.unop.op;
+
+    default:
+        return false;
+    }
+}
+
+static bool same_node(const mx_program *program, const tree_node *nodes, const size_t *children, size_t a, size_t b) {
+    if (!same_token(&program->tokens[a], &program->tokens[b]) || nodes[a].n_children != nodes[b].n_children) {
+        return false;
+    }
+
+    for (int i = 0; i < nodes[a].n_children; i++) {
+        if (nodes[children[nodes[a].children + (size_t)i]].id != nodes[children[nodes[b].children + (size_t)i]].id) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Builds expression tree, assigning equal ids to identical subtrees. Returns number of distinct ids, or 0 if failed.
+static size_t build_tree(const mx_program *program, tree_node *nodes, size_t *children) {
+    size_t n = program->n_tokens;
+    size_t n_buckets = 2 * n;
+    size_t *buckets = malloc(sizeof(size_t) * n_buckets); // index of token representing the id plus one, or zero
+    size_t *operands = malloc(sizeof(size_t) * n);        // stack of subtree roots
+    size_t n_operands = 0;
+    size_t n_children = 0;
+    size_t n_ids = 0;
+    const int *args = program->args;
+
+    if (buckets == NULL || operands == NULL) {
+        free(buckets);
+        free(operands);
+        return 0;
+    }
+
+    memset(buckets, 0, sizeof(size_t) * n_buckets);
+
+    for (size_t i = 0; i < n; i++) {
+        const mx_token *token = &program->tokens[i];
+        int arity = 0;
+
+        switch (token->type) {
+        case MX_BINARY_OPERATOR: {
+            arity = 2;
+        } break;
+
+        case MX_UNARY_OPERATOR: {
+            arity = 1;
+        } break;
+
+        case MX_FUNCTION: {
+            arity = *args++;
+        } break;
+
+        default: {
+        } break;
+        }
+
+        n_operands -= (size_t)arity;
+        nodes[i].children = n_children;
+        nodes[i].n_children = arity;
+
+        size_t hash = hash_token(token);
+
+        for (int j = 0; j < arity; j++) {
+            size_t child = operands[n_operands + (size_t)j];
+            children[n_children++] = child;
+            hash = 37 * hash + nodes[child].id;
+        }
+
+        size_t bucket = hash % n_buckets;
+
+        while (buckets[bucket] != 0 && !same_node(program, nodes, children, buckets[bucket] - 1, i)) {
+            bucket = (bucket + 1) % n_buckets;
+        }
+
+        if (buckets[bucket] == 0) {
+            buckets[bucket] = i + 1;
+            nodes[i].id = n_ids++;
+        } else {
+            nodes[i].id = nodes[buckets[bucket] - 1].id;
+        }
+
+        operands[n_operands++] = i;
+    }
+
+    free(buckets);
+    free(operands);
+    return n_ids;
+}
+
+// Frame of depth-first traversal of expression tree.
+typedef struct visit_frame {
+    size_t node;
+    int next_child;
+} visit_frame;
+
+void eliminate_common_subexpressions(mx_program *program) {
+    size_t n = program->n_tokens;
+    tree_node *nodes = malloc(sizeof(tree_node) * n);
+    size_t *children = malloc(sizeof(size_t) * n);
+    visit_frame *frames = malloc(sizeof(visit_frame) * n);
+    size_t *uses = NULL;  // how many times subtree is reused after first evaluation
+    size_t *slots = NULL; // temporary slot of subtree plus one, or zero
+    bool *visited = NULL;
+    mx_token *tokens = NULL;
+    int *args = NULL;
+
+    if (nodes == NULL || children == NULL || frames == NULL) {
+        goto cleanup;
+    }
+
+    size_t n_ids = build_tree(program, nodes, children);
+
+    if (n_ids == 0 || n_ids == n) {
+        // Nothing to eliminate
+        goto cleanup;
+    }
+
+    uses = calloc(n_ids, sizeof(size_t));
+    slots = calloc(n_ids, sizeof(size_t));
+    visited = calloc(n_ids, sizeof(bool));
+    tokens = malloc(sizeof(mx_token) * 2 * n);
+    args = malloc(sizeof(int) * (program->n_args > 0 ? program->n_args : 1));
+
+    if (uses == NULL || slots == NULL || visited == NULL || tokens == NULL || args == NULL) {
+        goto cleanup;
+    }
+
+    // First pass counts reuses of subtrees, second pass emits tokens
+    for (int pass = 0; pass < 2; pass++) {
+        size_t n_frames = 0;
+        size_t n_tokens = 0;
+        size_t n_args = 0;
+        size_t n_slots = 0;
+
+        memset(visited, 0, sizeof(bool) * n_ids);
+        frames[n_frames++] = (visit_frame){.node = n - 1, .next_child = 0};
+
+        while (n_frames > 0) {
+            visit_frame *frame = &frames[n_frames - 1];
+            const tree_node *node = &nodes[frame->node];
+
+            if (frame->next_child == 0 && node->n_children > 0) {
+                if (visited[node->id]) {
+                    // Subtree was already evaluated
+                    if (pass == 0) {
+                        uses[node->id]++;
+                    } else {
+                        tokens[n_tokens++] = (mx_token){.type = MX_LOAD, .d.slot = slots[node->id] - 1};
+                    }
+
+                    n_frames--;
+                    continue;
+                }
+
+                visited[node->id] = true;
+            }
+
+            if (frame->next_child < node->n_children) {
+                size_t child = children[node->children + (size_t)frame->next_child++];
+                frames[n_frames++] = (visit_frame){.node = child, .next_child = 0};
+                continue;
+            }
+
+            if (pass == 1) {
+                tokens[n_tokens++] = program->tokens[frame->node];
+
+                if (program->tokens[frame->node].type == MX_FUNCTION) {
+                    args[n_args++] = node->n_children;
+                }
+
+                if (uses[node->id] > 0 && node->n_children > 0) {
+                    slots[node->id] = ++n_slots;
+                    tokens[n_tokens++] = (mx_token){.type = MX_STORE, .d.slot = n_slots - 1};
+                }
+            }
+
+            n_frames--;
+        }
+
+        if (pass == 1) {
+            free(program->tokens);
+            free(program->args);
+
+            program->tokens = tokens;
+            program->n_tokens = n_tokens;
+            program->args = args;
+            program->n_args = n_args;
+            program->n_slots = n_slots;
+            program->depth = program_depth(program);
+
+            tokens = NULL;
+            args = NULL;
+        }
+    }
+
+cleanup:
+    free(nodes);
+    free(children);
+    free(frames);
+    free(uses);
+    free(slots);
+    free(visited);
+    free(tokens);
+    free(args);
+}
@@ -0,0 +1,267 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+// Required for POSIX threads in strict C99 mode
+#define _DEFAULT_SOURCE
+
+#include "mathex.h"
+#include "mx_pool.h"
+#include "mx_thread.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define CACHE_LINE_SIZE 64
+
+// Remaining tasks of a thread, packed into one word so both ends can be updated with single compare-and-swap.
+// Owner takes tasks from the beginning of the range, and thieves take the upper half of it.
+typedef struct task_range {
+    uint64_t range;
+    unsigned char padding[CACHE_LINE_SIZE - sizeof(uint64_t)]; // keeps ranges of different threads in separate cache lines
+} task_range;
+
+#define RANGE(begin, end) (((uint64_t)(begin) << 32) | (uint64_t)(end))
+#define RANGE_BEGIN(range) ((size_t)((range) >> 32))
+#define RANGE_END(range) ((size_t)((range)&0xFFFFFFFF))
+
+typedef struct pool_worker {
+    mx_pool *pool;
+    size_t index;
+} pool_worker;
+
+struct mx_pool {
+    mx_thread *threads;
+    pool_worker *workers;
+    size_t n_threads;   // number of background threads, calling thread is not included
+    task_range *ranges; // one for each background thread, and the last one for the calling thread
+    mx_mutex lock;
+    mx_cond start;
+    mx_cond finish;
+    size_t generation; // incremented for every job
+    size_t n_running;  // number of background threads still working on the current job
+    bool stop;
+    pool_task task;
+    void *context;
+    mx_mutex submit; // allows only one job at a time
+};
+
+static mx_pool *shared_pool = NULL;
+
+static bool take_task(task_range *own, size_t *index) {
+    uint64_t range = ATOMIC_LOAD(&own->range);
+
+    while (RANGE_BEGIN(range) < RANGE_END(range)) {
+        if (ATOMIC_CAS(&own->range, &range, RANGE(RANGE_BEGIN(range) + 1, RANGE_END(range)))) {
+            *index = RANGE_BEGIN(range);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Moves upper half of tasks of the victim into empty range of the thief.
+static bool steal_tasks(task_range *victim, task_range *own) {
+    uint64_t range = ATOMIC_LOAD(&victim->range);
+
+    while (RANGE_BEGIN(range) < RANGE_END(range)) {
+        size_t begin = RANGE_BEGIN(range);
+        size_t end = RANGE_END(range);
+        size_t middle = end - (end - begin + 1) / 2;
+
+        if (ATOMIC_CAS(&victim->range, &range, RANGE(begin, middle))) {
+            ATOMIC_STORE(&own->range, RANGE(middle, end));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void run_tasks(mx_pool *pool, size_t worker) {
+    size_t n_ranges = pool->n_threads + 1;
+    task_range *own = &pool->ranges[worker];
+    size_t index;
+
+    for (;;) {
+        while (take_task(own, &index)) {
+            pool->task(pool->context, worker, index);
+        }
+
+        bool stolen = false;
+
+        for (size_t i = 1; i < n_ranges && !stolen; i++) {
+            stolen = steal_tasks(&pool->ranges[(worker + i) % n_ranges], own);
+        }
+
+        if (!stolen) {
+            return;
+        }
+    }
+}
+
+static THREAD_FUNCTION(worker_main, argument) {
+    pool_worker *worker = argument;
+    mx_pool *pool = worker->pool;
+    size_t generation = 0;
+
+    mutex_lock(&pool->lock);
+
+    for (;;) {
+        while (!pool->stop && pool->generation == generation) {
+            cond_wait(&pool->start, &pool->lock);
+        }
+
+        if (pool->stop) {
+            break;
+        }
+
+        generation = pool->generation;
+        mutex_unlock(&pool->lock);
+
+        run_tasks(pool, worker->index);
+
+        mutex_lock(&pool->lock);
+
+        if (--pool->n_running == 0) {
+            cond_signal(&pool->finish);
+        }
+    }
+
+    mutex_unlock(&pool->lock);
+    return THREAD_RETURN;
+}
+
+size_t pool_size(const mx_pool *pool) {
+    return pool->n_threads + 1;
+}
+
+void pool_run(mx_pool *pool, size_t n_tasks, pool_task task, void *context) {
+    uint64_t n_ranges = pool->n_threads + 1;
+    mutex_lock(&pool->submit);
+
+    for (uint64_t i = 0; i < n_ranges; i++) {
+        ATOMIC_STORE(&pool->ranges[i].range, RANGE(n_tasks * i / n_ranges, n_tasks * (i + 1) / n_ranges));
+    }
+
+    mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->n_running = pool->n_threads;
+    pool->generation++;
+    cond_broadcast(&pool->start);
+    mutex_unlock(&pool->lock);
+
+    run_tasks(pool, pool->n_threads);
+
+    mutex_lock(&pool->lock);
+
+    while (pool->n_running > 0) {
+        cond_wait(&pool->finish, &pool->lock);
+    }
+
+    mutex_unlock(&pool->lock);
+    mutex_unlock(&pool->submit);
+}
+
+mx_pool *default_pool(void) {
+    mx_pool *pool = ATOMIC_LOAD(&shared_pool);
+
+    if (pool == NULL) {
+        mx_pool *expected = NULL;
+        pool = mx_pool_create(0);
+
+        // Another thread may have created the pool meanwhile
+        if (pool != NULL && !ATOMIC_CAS(&shared_pool, &expected, pool)) {
+            mx_pool_free(pool);
+            pool = expected;
+        }
+    }
+
+    return pool;
+}
+
+mx_pool *mx_pool_create(size_t n_threads) {
+    mx_pool *pool = malloc(sizeof(mx_pool));
+
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    if (n_threads == 0) {
+        n_threads = processor_count();
+    }
+
+    pool->n_threads = 0;
+    pool->threads = malloc(sizeof(mx_thread) * n_threads);
+    pool->workers = malloc(sizeof(pool_worker) * n_threads);
+    pool->ranges = calloc(n_threads, sizeof(task_range));
+    pool->generation = 0;
+    pool->n_running = 0;
+    pool->stop = false;
+
+    if (pool->threads == NULL || pool->workers == NULL || pool->ranges == NULL) {
+        free(pool->threads);
+        free(pool->workers);
+        free(pool->ranges);
+        free(pool);
+        return NULL;
+    }
+
+    mutex_init(&pool->lock);
+    mutex_init(&pool->submit);
+    cond_init(&pool->start);
+    cond_init(&pool->finish);
+
+    // Calling thread also runs tasks, so one thread less is started
+    for (size_t i = 0; i + 1 < n_threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+
+        if (!thread_create(&pool->threads[i], worker_main, &pool->workers[i])) {
+            break;
+        }
+
+        pool->n_threads++;
+    }
+
+    return pool;
+}
+
+void mx_pool_free(mx_pool *pool) {
+    mutex_lock(&pool->lock);
+    pool->stop = true;
+    cond_broadcast(&pool->start);
+    mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->n_threads; i++) {
+        thread_join(pool->threads[i]);
+    }
+
+    mutex_destroy(&pool->lock);
+    mutex_destroy(&pool->submit);
+    cond_destroy(&pool->start);
+    cond_destroy(&pool->finish);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->ranges);
+    free(pool);
+}
@@ -0,0 +1,42 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef MATHEX_POOL_H
+#define MATHEX_POOL_H
+
+#include "mathex.h"
+#include <stddef.h>
+
+// Task executed for every index in range. `worker` is index of the thread running it, less than `pool_size`.
+typedef void (*pool_task)(void *context, size_t worker, size_t index);
+
+// Returns number of threads running tasks of the pool, including the calling thread.
+size_t pool_size(const mx_pool *pool);
+
+// Runs task for every index from 0 to `n_tasks`, returning once all of them finished. Tasks are distributed
+// evenly between threads, and threads that run out of tasks steal half of the remaining tasks from others.
+void pool_run(mx_pool *pool, size_t n_tasks, pool_task task, void *context);
+
+// Returns pool shared by the whole process, creating it on first use. NULL if out of memory.
+mx_pool *default_pool(void);
+
+#endif /* MATHEX_POOL_H */
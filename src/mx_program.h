@@ -0,0 +1,92 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef MATHEX_PROGRAM_H
+#define MATHEX_PROGRAM_H
+
+#include "mathex.h"
+#include "mx_token.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Sets `error_code` to given error and jumps to `cleanup` label of the calling function.
+#define RETURN_ERROR(error) \
+    do {                    \
+        error_code = error; \
+        goto cleanup;       \
+    } while (0)
+
+#define RETURN_ERROR_IF(condition, error) \
+    do {                                  \
+        if (condition) {                  \
+            RETURN_ERROR(error);          \
+        }                                 \
+    } while (0)
+
+// Variable referenced by a compiled expression.
+typedef struct program_variable {
+    char *name;
+    const void *value; // pointer to the value, `float` for single-precision variables, or NULL if variable is read from the frame
+    size_t index;      // index of the variable in the frame
+} program_variable;
+
+// Expression compiled into postfix notation.
+struct mx_program {
+    mx_token *tokens; // postfix token sequence
+    size_t n_tokens;
+    int *args; // number of arguments of each function call, in order of appearance in `tokens`
+    size_t n_args;
+    size_t depth;           // maximum number of values on evaluation stack
+    size_t n_slots;         // number of temporary values, stored right after evaluation stack
+    size_t frame_size;      // minimum number of values in the frame, zero if expression has no frame variables
+    program_variable *vars; // distinct variables, in order of first appearance in the expression
+    size_t n_vars;
+    mx_error (*native)(double *stack, const double *frame); // machine code generated by `mx_program_jit`, or NULL
+    size_t native_size;
+};
+
+// Checks whether the variable token reads given variable of the program.
+static inline bool same_variable(const program_variable *var, const mx_token *token) {
+    if (token->type == MX_FRAME_VARIABLE) {
+        return var->value == NULL && var->index == token->d.index;
+    }
+
+    if (token->type == MX_FLOAT_VARIABLE) {
+        return var->value == token->d.fvar;
+    }
+
+    return var->value == token->d.var;
+}
+
+// Frees machine code of the program, if it has any.
+void program_release_native(mx_program *program);
+
+// Returns maximum number of values on evaluation stack of the program.
+size_t program_depth(const mx_program *program);
+
+// Replaces operators and calls to pure functions applied only to constants with the result of the operation.
+void fold_constants(mx_program *program);
+
+// Evaluates identical subtrees only once, storing their values in temporary slots. Leaves program intact if failed.
+void eliminate_common_subexpressions(mx_program *program);
+
+#endif /* MATHEX_PROGRAM_H */
@@ -0,0 +1,212 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+// Required for POSIX threads in strict C99 mode
+#define _DEFAULT_SOURCE
+
+#include "mathex.h"
+#include "mx_thread.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Published configs are reclaimed using epoch-based reclamation. Every publication advances global epoch, and
+// replaced config is retired with the epoch it was replaced in. Reader entering read section announces the epoch
+// it observed before loading the config, so it can only hold configs retired in that epoch or later. Retired config
+// is freed once every active reader has announced a later epoch. Readers only write into their own records, so
+// read sections do not bounce cache lines between cores.
+
+#define CACHE_LINE_SIZE 64
+
+struct mx_reader {
+    size_t epoch; // global epoch observed when read section started
+    int active;   // whether reader is in read section
+    bool used;    // whether record is registered, accessed only under the lock
+    mx_shared *shared;
+    mx_reader *next;
+    unsigned char padding[CACHE_LINE_SIZE]; // keeps records of different readers in separate cache lines
+};
+
+typedef struct retired_config {
+    mx_config *config;
+    size_t epoch; // epoch in which the config was replaced
+} retired_config;
+
+struct mx_shared {
+    mx_config *current;
+    size_t epoch;
+    mx_mutex lock; // serializes writers and registration of readers
+    mx_reader *readers;
+    retired_config *retired;
+    size_t n_retired;
+    size_t retired_capacity;
+};
+
+// Frees retired configs that no reader can use anymore. Has to be called under the lock.
+static void reclaim(mx_shared *shared) {
+    size_t min_epoch = SIZE_MAX;
+
+    for (mx_reader *reader = shared->readers; reader != NULL; reader = reader->next) {
+        if (ATOMIC_LOAD(&reader->active)) {
+            size_t epoch = ATOMIC_LOAD(&reader->epoch);
+            min_epoch = epoch < min_epoch ? epoch : min_epoch;
+        }
+    }
+
+    size_t length = 0;
+
+    for (size_t i = 0; i < shared->n_retired; i++) {
+        if (shared->retired[i].epoch < min_epoch) {
+            mx_free(shared->retired[i].config);
+        } else {
+            shared->retired[length++] = shared->retired[i];
+        }
+    }
+
+    shared->n_retired = length;
+}
+
+mx_shared *mx_shared_create(mx_config *config) {
+    mx_shared *shared = malloc(sizeof(mx_shared));
+
+    if (shared != NULL) {
+        shared->current = config;
+        shared->epoch = 0;
+        shared->readers = NULL;
+        shared->retired = NULL;
+        shared->n_retired = 0;
+        shared->retired_capacity = 0;
+        mutex_init(&shared->lock);
+    }
+
+    return shared;
+}
+
+mx_config *mx_shared_edit(mx_shared *shared) {
+    mutex_lock(&shared->lock);
+
+    // Only writers free configs and they hold the lock, so current config cannot be freed meanwhile
+    mx_config *config = mx_clone(shared->current);
+    reclaim(shared);
+
+    mutex_unlock(&shared->lock);
+    return config;
+}
+
+mx_error mx_shared_publish(mx_shared *shared, mx_config *config) {
+    mutex_lock(&shared->lock);
+
+    if (shared->n_retired == shared->retired_capacity) {
+        size_t capacity = shared->retired_capacity > 0 ? 2 * shared->retired_capacity : 4;
+        retired_config *retired = realloc(shared->retired, sizeof(retired_config) * capacity);
+
+        if (retired == NULL) {
+            mutex_unlock(&shared->lock);
+            return MX_ERR_NO_MEMORY;
+        }
+
+        shared->retired = retired;
+        shared->retired_capacity = capacity;
+    }
+
+    // Readers that loaded previous config have observed epoch not later than the one before increment
+    mx_config *previous = ATOMIC_EXCHANGE(&shared->current, config);
+    size_t epoch = ATOMIC_FETCH_ADD(&shared->epoch, 1);
+
+    shared->retired[shared->n_retired].config = previous;
+    shared->retired[shared->n_retired].epoch = epoch;
+    shared->n_retired++;
+    reclaim(shared);
+
+    mutex_unlock(&shared->lock);
+    return MX_SUCCESS;
+}
+
+void mx_shared_free(mx_shared *shared) {
+    for (size_t i = 0; i < shared->n_retired; i++) {
+        mx_free(shared->retired[i].config);
+    }
+
+    mx_reader *reader = shared->readers;
+
+    while (reader != NULL) {
+        mx_reader *next = reader->next;
+        free(reader);
+        reader = next;
+    }
+
+    mutex_destroy(&shared->lock);
+    mx_free(shared->current);
+    free(shared->retired);
+    free(shared);
+}
+
+mx_reader *mx_reader_create(mx_shared *shared) {
+    mutex_lock(&shared->lock);
+    mx_reader *reader = shared->readers;
+
+    while (reader != NULL && reader->used) {
+        reader = reader->next;
+    }
+
+    if (reader == NULL) {
+        reader = malloc(sizeof(mx_reader));
+
+        if (reader != NULL) {
+            reader->epoch = 0;
+            reader->active = 0;
+            reader->shared = shared;
+            reader->next = shared->readers;
+            shared->readers = reader;
+        }
+    }
+
+    if (reader != NULL) {
+        reader->used = true;
+    }
+
+    mutex_unlock(&shared->lock);
+    return reader;
+}
+
+const mx_config *mx_read_begin(mx_reader *reader) {
+    mx_shared *shared = reader->shared;
+
+    ATOMIC_STORE(&reader->epoch, ATOMIC_LOAD(&shared->epoch));
+    ATOMIC_STORE(&reader->active, 1);
+
+    return ATOMIC_LOAD(&shared->current);
+}
+
+void mx_read_end(mx_reader *reader) {
+    ATOMIC_STORE(&reader->active, 0);
+}
+
+void mx_reader_free(mx_reader *reader) {
+    mx_shared *shared = reader->shared;
+    mutex_lock(&shared->lock);
+
+    reader->used = false;
+    reclaim(shared);
+
+    mutex_unlock(&shared->lock);
+}
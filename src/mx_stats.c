@@ -0,0 +1,93 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+// Required for POSIX threads in strict C99 mode
+#define _DEFAULT_SOURCE
+
+#include "mathex.h"
+#include "mx_stats.h"
+#include "mx_thread.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct mx_counters {
+    mx_stats values;
+    bool timing;
+};
+
+mx_counters *counters_create(bool timing) {
+    mx_counters *counters = calloc(1, sizeof(mx_counters));
+
+    if (counters != NULL) {
+        counters->timing = timing;
+    }
+
+    return counters;
+}
+
+bool counters_timing(const mx_counters *counters) {
+    return counters->timing;
+}
+
+// Counters that did not change are skipped, so that cache lines are not written without need.
+#define ADD_COUNTER(field)                                           \
+    do {                                                             \
+        if (stats->field != 0) {                                     \
+            ATOMIC_FETCH_ADD(&counters->values.field, stats->field); \
+        }                                                            \
+    } while (0)
+
+void counters_add(mx_counters *counters, const mx_stats *stats) {
+    ADD_COUNTER(evaluations);
+    ADD_COUNTER(compilations);
+    ADD_COUNTER(tokens);
+    ADD_COUNTER(lookups);
+    ADD_COUNTER(probes);
+    ADD_COUNTER(allocations);
+    ADD_COUNTER(calls);
+    ADD_COUNTER(parse_cycles);
+    ADD_COUNTER(eval_cycles);
+
+    for (size_t i = 0; i < MX_STATS_ERRORS; i++) {
+        ADD_COUNTER(errors[i]);
+    }
+}
+
+void counters_read(mx_counters *counters, mx_stats *stats) {
+    stats->evaluations = ATOMIC_LOAD(&counters->values.evaluations);
+    stats->compilations = ATOMIC_LOAD(&counters->values.compilations);
+    stats->tokens = ATOMIC_LOAD(&counters->values.tokens);
+    stats->lookups = ATOMIC_LOAD(&counters->values.lookups);
+    stats->probes = ATOMIC_LOAD(&counters->values.probes);
+    stats->allocations = ATOMIC_LOAD(&counters->values.allocations);
+    stats->calls = ATOMIC_LOAD(&counters->values.calls);
+    stats->parse_cycles = ATOMIC_LOAD(&counters->values.parse_cycles);
+    stats->eval_cycles = ATOMIC_LOAD(&counters->values.eval_cycles);
+
+    for (size_t i = 0; i < MX_STATS_ERRORS; i++) {
+        stats->errors[i] = ATOMIC_LOAD(&counters->values.errors[i]);
+    }
+}
+
+void counters_free(mx_counters *counters) {
+    free(counters);
+}
@@ -0,0 +1,64 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef MATHEX_STATS_H
+#define MATHEX_STATS_H
+
+#include "mathex.h"
+#include <stdbool.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+#define HAVE_CYCLE_COUNTER
+#endif
+
+// Statistics of a config, updated by concurrent evaluations using atomic operations.
+typedef struct mx_counters mx_counters;
+
+// Creates zeroed counters. NULL if out of memory.
+mx_counters *counters_create(bool timing);
+
+// Whether CPU cycles of each phase have to be measured.
+bool counters_timing(const mx_counters *counters);
+
+// Adds statistics of a single call to the counters.
+void counters_add(mx_counters *counters, const mx_stats *stats);
+
+// Writes current values of the counters.
+void counters_read(mx_counters *counters, mx_stats *stats);
+
+// Frees the counters. No evaluations may be using them.
+void counters_free(mx_counters *counters);
+
+// Reads CPU cycle counter, or returns zero if it is not available.
+static inline unsigned long long read_cycles(void) {
+#if defined(HAVE_CYCLE_COUNTER) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#elif defined(HAVE_CYCLE_COUNTER)
+    unsigned long long cycles;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(cycles));
+    return cycles;
+#else
+    return 0;
+#endif
+}
+
+#endif /* MATHEX_STATS_H */
@@ -0,0 +1,168 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#ifndef MATHEX_THREAD_H
+#define MATHEX_THREAD_H
+
+// Minimal portability layer over native threading primitives.
+// Atomic operations use GCC builtins, which are also provided by Clang, and are sequentially consistent.
+
+#define ATOMIC_LOAD(pointer) __atomic_load_n(pointer, __ATOMIC_SEQ_CST)
+#define ATOMIC_STORE(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_SEQ_CST)
+#define ATOMIC_EXCHANGE(pointer, value) __atomic_exchange_n(pointer, value, __ATOMIC_SEQ_CST)
+#define ATOMIC_FETCH_ADD(pointer, value) __atomic_fetch_add(pointer, value, __ATOMIC_SEQ_CST)
+#define ATOMIC_CAS(pointer, expected, desired) __atomic_compare_exchange_n(pointer, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef SRWLOCK mx_mutex;
+
+static inline void mutex_init(mx_mutex *mutex) {
+    InitializeSRWLock(mutex);
+}
+
+static inline void mutex_destroy(mx_mutex *mutex) {
+    (void)mutex;
+}
+
+static inline void mutex_lock(mx_mutex *mutex) {
+    AcquireSRWLockExclusive(mutex);
+}
+
+static inline void mutex_unlock(mx_mutex *mutex) {
+    ReleaseSRWLockExclusive(mutex);
+}
+
+typedef CONDITION_VARIABLE mx_cond;
+
+static inline void cond_init(mx_cond *cond) {
+    InitializeConditionVariable(cond);
+}
+
+static inline void cond_destroy(mx_cond *cond) {
+    (void)cond;
+}
+
+static inline void cond_wait(mx_cond *cond, mx_mutex *mutex) {
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+}
+
+static inline void cond_signal(mx_cond *cond) {
+    WakeConditionVariable(cond);
+}
+
+static inline void cond_broadcast(mx_cond *cond) {
+    WakeAllConditionVariable(cond);
+}
+
+typedef HANDLE mx_thread;
+
+#define THREAD_FUNCTION(name, argument) DWORD WINAPI name(LPVOID argument)
+#define THREAD_RETURN 0
+
+static inline bool thread_create(mx_thread *thread, LPTHREAD_START_ROUTINE start, void *argument) {
+    *thread = CreateThread(NULL, 0, start, argument, 0, NULL);
+    return *thread != NULL;
+}
+
+static inline void thread_join(mx_thread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+static inline size_t processor_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_mutex_t mx_mutex;
+
+static inline void mutex_init(mx_mutex *mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+static inline void mutex_destroy(mx_mutex *mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+static inline void mutex_lock(mx_mutex *mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+static inline void mutex_unlock(mx_mutex *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+typedef pthread_cond_t mx_cond;
+
+static inline void cond_init(mx_cond *cond) {
+    pthread_cond_init(cond, NULL);
+}
+
+static inline void cond_destroy(mx_cond *cond) {
+    pthread_cond_destroy(cond);
+}
+
+static inline void cond_wait(mx_cond *cond, mx_mutex *mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+
+static inline void cond_signal(mx_cond *cond) {
+    pthread_cond_signal(cond);
+}
+
+static inline void cond_broadcast(mx_cond *cond) {
+    pthread_cond_broadcast(cond);
+}
+
+typedef pthread_t mx_thread;
+
+#define THREAD_FUNCTION(name, argument) void *name(void *argument)
+#define THREAD_RETURN NULL
+
+static inline bool thread_create(mx_thread *thread, void *(*start)(void *), void *argument) {
+    return pthread_create(thread, NULL, start, argument) == 0;
+}
+
+static inline void thread_join(mx_thread thread) {
+    pthread_join(thread, NULL);
+}
+
+static inline size_t processor_count(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+#else
+    return 1;
+#endif
+}
+#endif
+
+#endif /* MATHEX_THREAD_H */
@@ -21,23 +21,152 @@
 */
 
 #include "mx_token.h"
+#include "mx_config.h"
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of arguments converted without allocating memory when calling function of other precision.
+#define CONVERTED_ARGS 16
 
 static double internal_add(double a, double b) { return a + b; }
 static double internal_sub(double a, double b) { return a - b; }
 static double internal_mul(double a, double b) { return a * b; }
 static double internal_div(double a, double b) { return a / b; }
 
-const mx_token builtin_add = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = internal_add, .prec = 2, .lassoc = true}};
-const mx_token builtin_sub = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = internal_sub, .prec = 2, .lassoc = true}};
-const mx_token builtin_mul = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = internal_mul, .prec = 3, .lassoc = true}};
-const mx_token builtin_div = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = internal_div, .prec = 3, .lassoc = true}};
+const mx_token builtin_add = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = internal_add, .prec = 2, .lassoc = true, .op = MX_OP_ADD}};
+const mx_token builtin_sub = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = internal_sub, .prec = 2, .lassoc = true, .op = MX_OP_SUB}};
+const mx_token builtin_mul = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = internal_mul, .prec = 3, .lassoc = true, .op = MX_OP_MUL}};
+const mx_token builtin_div = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = internal_div, .prec = 3, .lassoc = true, .op = MX_OP_DIV}};
 
-const mx_token builtin_pow = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = pow, .prec = 4, .lassoc = false}};
-const mx_token builtin_mod = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = fmod, .prec = 3, .lassoc = true}};
+const mx_token builtin_pow = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = pow, .prec = 4, .lassoc = false, .op = MX_OP_POW}};
+const mx_token builtin_mod = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = fmod, .prec = 3, .lassoc = true, .op = MX_OP_MOD}};
 
 static double internal_pos(double a) { return +a; }
 static double internal_neg(double a) { return -a; }
 
-const mx_token builtin_pos = {.type = MX_UNARY_OPERATOR, .d.unop = internal_pos};
-const mx_token builtin_neg = {.type = MX_UNARY_OPERATOR, .d.unop = internal_neg};
+const mx_token builtin_pos = {.type = MX_UNARY_OPERATOR, .d.unop = {.call = internal_pos, .op = MX_OP_POS}};
+const mx_token builtin_neg = {.type = MX_UNARY_OPERATOR, .d.unop = {.call = internal_neg, .op = MX_OP_NEG}};
+
+// Operators that named built-in functions are compiled into.
+static const mx_token op_min = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = fmin, .op = MX_OP_MIN}};
+static const mx_token op_max = {.type = MX_BINARY_OPERATOR, .d.biop = {.call = fmax, .op = MX_OP_MAX}};
+
+static const mx_token op_sin = {.type = MX_UNARY_OPERATOR, .d.unop = {.call = sin, .op = MX_OP_SIN}};
+static const mx_token op_cos = {.type = MX_UNARY_OPERATOR, .d.unop = {.call = cos, .op = MX_OP_COS}};
+static const mx_token op_exp = {.type = MX_UNARY_OPERATOR, .d.unop = {.call = exp, .op = MX_OP_EXP}};
+static const mx_token op_log = {.type = MX_UNARY_OPERATOR, .d.unop = {.call = log, .op = MX_OP_LOG}};
+static const mx_token op_sqrt = {.type = MX_UNARY_OPERATOR, .d.unop = {.call = sqrt, .op = MX_OP_SQRT}};
+static const mx_token op_abs = {.type = MX_UNARY_OPERATOR, .d.unop = {.call = fabs, .op = MX_OP_ABS}};
+static const mx_token op_floor = {.type = MX_UNARY_OPERATOR, .d.unop = {.call = floor, .op = MX_OP_FLOOR}};
+static const mx_token op_ceil = {.type = MX_UNARY_OPERATOR, .d.unop = {.call = ceil, .op = MX_OP_CEIL}};
+
+// Built-in functions are never called by compiled programs, but behave like any other function if they are.
+static mx_error call_unary(double args[], int argc, double *result, void *data) {
+    const mx_token *op = data;
+    *result = op->d.unop.call(args[0]);
+    (void)argc;
+    return MX_SUCCESS;
+}
+
+static mx_error call_binary(double args[], int argc, double *result, void *data) {
+    const mx_token *op = data;
+    *result = args[0];
+
+    for (int i = 1; i < argc; i++) {
+        *result = op->d.biop.call(*result, args[i]);
+    }
+
+    return MX_SUCCESS;
+}
+
+#define UNARY_FUNCTION(op) {.type = MX_FUNCTION, .d.func = {.call = call_unary, .data = (void *)&(op), .flags = MX_FUNC_PURE, .min_args = 1, .max_args = 1}}
+#define BINARY_FUNCTION(op) {.type = MX_FUNCTION, .d.func = {.call = call_binary, .data = (void *)&(op), .flags = MX_FUNC_PURE, .min_args = 1, .max_args = -1}}
+
+static const struct {
+    const char *name;
+    mx_flag flag;
+    mx_token token;
+} builtin_functions[] = {
+    {"sin", MX_ENABLE_SIN, UNARY_FUNCTION(op_sin)},
+    {"cos", MX_ENABLE_COS, UNARY_FUNCTION(op_cos)},
+    {"exp", MX_ENABLE_EXP, UNARY_FUNCTION(op_exp)},
+    {"log", MX_ENABLE_LOG, UNARY_FUNCTION(op_log)},
+    {"sqrt", MX_ENABLE_SQRT, UNARY_FUNCTION(op_sqrt)},
+    {"abs", MX_ENABLE_ABS, UNARY_FUNCTION(op_abs)},
+    {"min", MX_ENABLE_MIN, BINARY_FUNCTION(op_min)},
+    {"max", MX_ENABLE_MAX, BINARY_FUNCTION(op_max)},
+    {"floor", MX_ENABLE_FLOOR, UNARY_FUNCTION(op_floor)},
+    {"ceil", MX_ENABLE_CEIL, UNARY_FUNCTION(op_ceil)},
+};
+
+const mx_token *lookup_builtin(const mx_config *config, const char *name, size_t length) {
+    for (size_t i = 0; i < sizeof(builtin_functions) / sizeof(builtin_functions[0]); i++) {
+        if (read_flag(config, builtin_functions[i].flag) && strncmp(builtin_functions[i].name, name, length) == 0 && builtin_functions[i].name[length] == '\0') {
+            return &builtin_functions[i].token;
+        }
+    }
+
+    return NULL;
+}
+
+const mx_token *builtin_operator(const mx_token *function) {
+    if (function->d.func.call == call_unary || function->d.func.call == call_binary) {
+        return function->d.func.data;
+    }
+
+    return NULL;
+}
+
+mx_error call_single(double args[], int argc, double *result, void *function) {
+    const mx_token *token = function;
+    float buffer[CONVERTED_ARGS];
+    float *single_args = argc > CONVERTED_ARGS ? malloc(sizeof(float) * (size_t)argc) : buffer;
+    float single_result;
+
+    if (single_args == NULL) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        single_args[i] = (float)args[i];
+    }
+
+    mx_error error_code = ((single_function)(void (*)(void))token->d.func.call)(argc > 0 ? single_args : NULL, argc, &single_result, token->d.func.data);
+
+    if (error_code == MX_SUCCESS) {
+        *result = single_result;
+    }
+
+    if (single_args != buffer) {
+        free(single_args);
+    }
+
+    return error_code;
+}
+
+mx_error call_double(const mx_token *function, float args[], int argc, float *result) {
+    double buffer[CONVERTED_ARGS];
+    double *double_args = argc > CONVERTED_ARGS ? malloc(sizeof(double) * (size_t)argc) : buffer;
+    double double_result;
+
+    if (double_args == NULL) {
+        return MX_ERR_NO_MEMORY;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        double_args[i] = args[i];
+    }
+
+    mx_error error_code = function->d.func.call(argc > 0 ? double_args : NULL, argc, &double_result, function->d.func.data);
+
+    if (error_code == MX_SUCCESS) {
+        *result = (float)double_result;
+    }
+
+    if (double_args != buffer) {
+        free(double_args);
+    }
+
+    return error_code;
+}
@@ -24,6 +24,7 @@
 #define MATHEX_TOKEN_H
 
 #include "mathex.h"
+#include <stddef.h>
 
 // Type of expression token.
 typedef enum mx_token_type {
@@ -33,11 +34,38 @@ typedef enum mx_token_type {
     MX_COMMA,
     MX_CONSTANT,
     MX_VARIABLE,
+    MX_FLOAT_VARIABLE, // variable stored in single precision
+    MX_FRAME_VARIABLE, // variable read from the frame passed to evaluation
     MX_FUNCTION,
     MX_BINARY_OPERATOR,
     MX_UNARY_OPERATOR,
+    MX_STORE, // copy value on top of the stack into temporary slot
+    MX_LOAD,  // push value of temporary slot onto the stack
 } mx_token_type;
 
+// Built-in operator, used to dispatch to specialized implementations.
+typedef enum mx_opcode {
+    MX_OP_ADD = 0,
+    MX_OP_SUB,
+    MX_OP_MUL,
+    MX_OP_DIV,
+    MX_OP_POW,
+    MX_OP_MOD,
+    MX_OP_MIN,
+    MX_OP_MAX,
+    MX_OP_POS,
+    MX_OP_NEG,
+    MX_OP_SIN,
+    MX_OP_COS,
+    MX_OP_EXP,
+    MX_OP_LOG,
+    MX_OP_SQRT,
+    MX_OP_ABS,
+    MX_OP_FLOOR,
+    MX_OP_CEIL,
+    MX_OP_COUNT,
+} mx_opcode;
+
 // Value of expression token.
 // NOTE: `data` is discriminated union! Always check `type` before accessing its fields!!!
 typedef struct mx_token {
@@ -45,19 +73,68 @@ typedef struct mx_token {
     union {
         double number;     // value of a number literal
         const double *var; // pointer to value of a variable
+        const float *fvar; // pointer to value of a single-precision variable
         struct {
-            mx_error (*call)(double[], int, double *, void *); // function
+            mx_error (*call)(double[], int, double *, void *);       // function
+            mx_error (*derivative)(double[], int, double[], void *); // partial derivatives of function, or NULL
             void *data;
+            mx_func_flag flags;
+            short min_args; // fewest arguments accepted
+            short max_args; // most arguments accepted, or negative if unlimited
         } func;
         struct {
             double (*call)(double, double); // binary operator
             int prec;                       // precedence
             bool lassoc;                    // left associative
+            mx_opcode op;
         } biop;
-        double (*unop)(double); // unary operator
+        struct {
+            double (*call)(double); // unary operator
+            mx_opcode op;
+        } unop;
+        size_t slot;  // index of temporary value
+        size_t index; // index of frame variable in the frame
     } d;
 } mx_token;
 
+// Set in flags of functions added using `mx_add_function_f`, whose `call` takes and returns single-precision values.
+#define FUNC_SINGLE ((mx_func_flag)0x8000)
+
+// Function flags that callers of the public API are allowed to set.
+#define PUBLIC_FUNC_FLAGS (MX_FUNC_PURE | MX_FUNC_THREAD_SAFE)
+
+// Single-precision user-defined function.
+typedef mx_error (*single_function)(float[], int, float *, void *);
+
+// Calls single-precision function token with double-precision arguments. Takes the token as `data`, so it can be called like any other function.
+mx_error call_single(double args[], int argc, double *result, void *function);
+
+// Calls double-precision function token with single-precision arguments.
+mx_error call_double(const mx_token *function, float args[], int argc, float *result);
+
+// Calls function token with double-precision arguments, which it is allowed to modify.
+static inline mx_error call_function(const mx_token *function, double args[], int argc, double *result) {
+    if (function->d.func.flags & FUNC_SINGLE) {
+        return call_single(args, argc, result, (void *)function);
+    }
+
+    return function->d.func.call(args, argc, result, function->d.func.data);
+}
+
+// Calls function token with single-precision arguments, which it is allowed to modify.
+static inline mx_error call_function_f(const mx_token *function, float args[], int argc, float *result) {
+    if (function->d.func.flags & FUNC_SINGLE) {
+        return ((single_function)(void (*)(void))function->d.func.call)(args, argc, result, function->d.func.data);
+    }
+
+    return call_double(function, args, argc, result);
+}
+
+// Reads value of a variable token that is not read from the frame.
+static inline double variable_value(const mx_token *token) {
+    return token->type == MX_FLOAT_VARIABLE ? (double)*token->d.fvar : *token->d.var;
+}
+
 extern const mx_token builtin_add; // Addition operator.
 extern const mx_token builtin_sub; // Substraction operator.
 extern const mx_token builtin_mul; // Multiplication operator.
@@ -69,4 +146,12 @@ extern const mx_token builtin_mod; // Modulus operator.
 extern const mx_token builtin_pos; // Unary identity operator.
 extern const mx_token builtin_neg; // Unary negation operator.
 
+// Returns built-in function with given name if it is enabled in the config, or NULL otherwise.
+// Name does not have to be NULL-terminated.
+const mx_token *lookup_builtin(const mx_config *config, const char *name, size_t length);
+
+// Returns operator that call to built-in function is compiled into, or NULL if function is not built-in.
+// Calls with more than two arguments to functions compiled into binary operators apply the operator repeatedly.
+const mx_token *builtin_operator(const mx_token *function);
+
 #endif /* MATHEX_TOKEN_H */
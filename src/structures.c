@@ -25,13 +25,14 @@
 #include <stddef.h>
 #include <stdlib.h>
 
-typedef struct int_node {
-    int value;
-    struct int_node *next;
-} int_node;
+// Number of elements allocated on first insertion. Capacity doubles every time it is exceeded.
+#define INITIAL_CAPACITY 16
 
 struct int_stack {
-    int_node *top;
+    int *items;
+    size_t length;
+    size_t capacity;
+    size_t allocations;
 };
 
 int_stack *int_stack_create(void) {
@@ -39,49 +40,54 @@ int_stack *int_stack_create(void) {
 }
 
 bool int_stack_is_empty(int_stack *stack) {
-    return stack->top == NULL;
+    return stack->length == 0;
 }
 
 int int_stack_peek(const int_stack *stack) {
-    return stack->top->value;
+    return stack->items[stack->length - 1];
 }
 
 bool int_stack_push(int_stack *stack, int value) {
-    int_node *new_node = malloc(sizeof(int_node));
+    if (stack->length == stack->capacity) {
+        size_t capacity = stack->capacity > 0 ? 2 * stack->capacity : INITIAL_CAPACITY;
+        int *items = realloc(stack->items, sizeof(int) * capacity);
 
-    if (new_node == NULL) {
-        return false;
-    }
+        if (items == NULL) {
+            return false;
+        }
 
-    new_node->value = value;
-    new_node->next = stack->top;
+        stack->items = items;
+        stack->capacity = capacity;
+        stack->allocations++;
+    }
 
-    stack->top = new_node;
+    stack->items[stack->length++] = value;
     return true;
 }
 
 int int_stack_pop(int_stack *stack) {
-    int value = stack->top->value;
-    int_node *temp = stack->top;
-    stack->top = stack->top->next;
+    return stack->items[--stack->length];
+}
 
-    free(temp);
-    return value;
+size_t int_stack_allocations(const int_stack *stack) {
+    return stack->allocations;
 }
 
-void int_stack_free(int_stack *stack) {
-    while (stack->top != NULL) {
-        int_node *temp = stack->top;
-        stack->top = stack->top->next;
-        free(temp);
-    }
+void int_stack_clear(int_stack *stack) {
+    stack->length = 0;
+}
 
+void int_stack_free(int_stack *stack) {
+    free(stack->items);
     free(stack);
 }
 
 struct int_queue {
-    int_node *front;
-    int_node *rear;
+    int *items;
+    size_t front;
+    size_t length;
+    size_t capacity;
+    size_t allocations;
 };
 
 int_queue *int_queue_create(void) {
@@ -89,114 +95,62 @@ int_queue *int_queue_create(void) {
 }
 
 bool int_queue_is_empty(int_queue *queue) {
-    return queue->front == NULL;
+    return queue->front == queue->length;
 }
 
-bool int_queue_enqueue(int_queue *queue, int value) {
-    int_node *new_node = malloc(sizeof(int_node));
+size_t int_queue_length(const int_queue *queue) {
+    return queue->length - queue->front;
+}
 
-    if (new_node == NULL) {
-        return false;
-    }
+bool int_queue_enqueue(int_queue *queue, int value) {
+    if (queue->length == queue->capacity) {
+        size_t capacity = queue->capacity > 0 ? 2 * queue->capacity : INITIAL_CAPACITY;
+        int *items = realloc(queue->items, sizeof(int) * capacity);
 
-    new_node->value = value;
-    new_node->next = NULL;
+        if (items == NULL) {
+            return false;
+        }
 
-    if (queue->rear == NULL) {
-        queue->front = new_node;
-        queue->rear = new_node;
-    } else {
-        queue->rear->next = new_node;
-        queue->rear = new_node;
+        queue->items = items;
+        queue->capacity = capacity;
+        queue->allocations++;
     }
 
+    queue->items[queue->length++] = value;
     return true;
 }
 
 int int_queue_dequeue(int_queue *queue) {
-    int value = queue->front->value;
-    int_node *temp = queue->front;
-    queue->front = queue->front->next;
+    int value = queue->items[queue->front++];
 
-    if (queue->front == NULL) {
-        queue->rear = NULL;
+    if (queue->front == queue->length) {
+        // Start over from the beginning once emptied
+        queue->front = 0;
+        queue->length = 0;
     }
 
-    free(temp);
     return value;
 }
 
-void int_queue_free(int_queue *queue) {
-    while (queue->front != NULL) {
-        int_node *temp = queue->front;
-        queue->front = queue->front->next;
-        free(temp);
-    }
-
-    free(queue);
-}
-
-typedef struct double_node {
-    double value;
-    struct double_node *next;
-} double_node;
-
-struct double_stack {
-    double_node *top;
-};
-
-double_stack *double_stack_create(void) {
-    return calloc(1, sizeof(double_stack));
-}
-
-bool double_stack_is_empty(double_stack *stack) {
-    return stack->top == NULL;
-}
-
-double double_stack_peek(const double_stack *stack) {
-    return stack->top->value;
-}
-
-bool double_stack_push(double_stack *stack, double value) {
-    double_node *new_node = malloc(sizeof(double_node));
-
-    if (new_node == NULL) {
-        return false;
-    }
-
-    new_node->value = value;
-    new_node->next = stack->top;
-
-    stack->top = new_node;
-    return true;
+size_t int_queue_allocations(const int_queue *queue) {
+    return queue->allocations;
 }
 
-double double_stack_pop(double_stack *stack) {
-    double value = stack->top->value;
-    double_node *temp = stack->top;
-    stack->top = stack->top->next;
-
-    free(temp);
-    return value;
+void int_queue_clear(int_queue *queue) {
+    queue->front = 0;
+    queue->length = 0;
 }
 
-void double_stack_free(double_stack *stack) {
-    while (stack->top != NULL) {
-        double_node *temp = stack->top;
-        stack->top = stack->top->next;
-        free(temp);
-    }
-
-    free(stack);
+void int_queue_free(int_queue *queue) {
+    free(queue->items);
+    free(queue);
 }
 
-typedef struct token_node {
-    mx_token value;
-    struct token_node *next;
-} token_node;
-
 struct token_stack {
-    token_node *top;
+    mx_token *items;
+    size_t length;
+    size_t capacity;
+    size_t allocations;
 };
 
 token_stack *token_stack_create(void) {
@@ -204,49 +158,54 @@ token_stack *token_stack_create(void) {
 }
 
 bool token_stack_is_empty(token_stack *stack) {
-    return stack->top == NULL;
+    return stack->length == 0;
 }
 
 mx_token token_stack_peek(const token_stack *stack) {
-    return stack->top->value;
+    return stack->items[stack->length - 1];
 }
 
 bool token_stack_push(token_stack *stack, mx_token value) {
-    token_node *new_node = malloc(sizeof(token_node));
+    if (stack->length == stack->capacity) {
+        size_t capacity = stack->capacity > 0 ? 2 * stack->capacity : INITIAL_CAPACITY;
+        mx_token *items = realloc(stack->items, sizeof(mx_token) * capacity);
 
-    if (new_node == NULL) {
-        return false;
-    }
+        if (items == NULL) {
+            return false;
+        }
 
-    new_node->value = value;
-    new_node->next = stack->top;
+        stack->items = items;
+        stack->capacity = capacity;
+        stack->allocations++;
+    }
 
-    stack->top = new_node;
+    stack->items[stack->length++] = value;
     return true;
 }
 
 mx_token token_stack_pop(token_stack *stack) {
-    mx_token value = stack->top->value;
-    token_node *temp = stack->top;
-    stack->top = stack->top->next;
+    return stack->items[--stack->length];
+}
 
-    free(temp);
-    return value;
+size_t token_stack_allocations(const token_stack *stack) {
+    return stack->allocations;
 }
 
-void token_stack_free(token_stack *stack) {
-    while (stack->top != NULL) {
-        token_node *temp = stack->top;
-        stack->top = stack->top->next;
-        free(temp);
-    }
+void token_stack_clear(token_stack *stack) {
+    stack->length = 0;
+}
 
+void token_stack_free(token_stack *stack) {
+    free(stack->items);
     free(stack);
 }
 
 struct token_queue {
-    token_node *front;
-    token_node *rear;
+    mx_token *items;
+    size_t front;
+    size_t length;
+    size_t capacity;
+    size_t allocations;
 };
 
 token_queue *token_queue_create(void) {
@@ -254,49 +213,53 @@ token_queue *token_queue_create(void) {
 }
 
 bool token_queue_is_empty(token_queue *queue) {
-    return queue->front == NULL;
+    return queue->front == queue->length;
 }
 
-bool token_queue_enqueue(token_queue *queue, mx_token value) {
-    token_node *new_node = malloc(sizeof(token_node));
+size_t token_queue_length(const token_queue *queue) {
+    return queue->length - queue->front;
+}
 
-    if (new_node == NULL) {
-        return false;
-    }
+bool token_queue_enqueue(token_queue *queue, mx_token value) {
+    if (queue->length == queue->capacity) {
+        size_t capacity = queue->capacity > 0 ? 2 * queue->capacity : INITIAL_CAPACITY;
+        mx_token *items = realloc(queue->items, sizeof(mx_token) * capacity);
 
-    new_node->value = value;
-    new_node->next = NULL;
+        if (items == NULL) {
+            return false;
+        }
 
-    if (queue->rear == NULL) {
-        queue->front = new_node;
-        queue->rear = new_node;
-    } else {
-        queue->rear->next = new_node;
-        queue->rear = new_node;
+        queue->items = items;
+        queue->capacity = capacity;
+        queue->allocations++;
     }
 
+    queue->items[queue->length++] = value;
     return true;
 }
 
 mx_token token_queue_dequeue(token_queue *queue) {
-    mx_token value = queue->front->value;
-    token_node *temp = queue->front;
-    queue->front = queue->front->next;
+    mx_token value = queue->items[queue->front++];
 
-    if (queue->front == NULL) {
-        queue->rear = NULL;
+    if (queue->front == queue->length) {
+        // Start over from the beginning once emptied
+        queue->front = 0;
+        queue->length = 0;
     }
 
-    free(temp);
     return value;
 }
 
-void token_queue_free(token_queue *queue) {
-    while (queue->front != NULL) {
-        token_node *temp = queue->front;
-        queue->front = queue->front->next;
-        free(temp);
-    }
+size_t token_queue_allocations(const token_queue *queue) {
+    return queue->allocations;
+}
 
+void token_queue_clear(token_queue *queue) {
+    queue->front = 0;
+    queue->length = 0;
+}
+
+void token_queue_free(token_queue *queue) {
+    free(queue->items);
     free(queue);
 }
@@ -24,6 +24,7 @@
 #include <criterion/new/assert.h>
 #include <math.h>
 #include <mathex.h>
+#include <stdio.h>
 
 mx_error foo_wrapper(double args[], int argc, double *result, void *data) {
     if (argc != 0) {
@@ -43,6 +44,22 @@ mx_error abs_wrapper(double args[], int argc, double *result, void *data) {
     return MX_SUCCESS;
 }
 
+mx_error clamp_wrapper(double args[], int argc, double *result, void *data) {
+    (*(int *)data)++;
+    *result = args[0] < args[1] ? args[1] : args[0] > args[2] ? args[2] : args[0];
+    return MX_SUCCESS;
+}
+
+mx_error max_wrapper(double args[], int argc, double *result, void *data) {
+    *result = args[0];
+
+    for (int i = 1; i < argc; i++) {
+        *result = args[i] > *result ? args[i] : *result;
+    }
+
+    return MX_SUCCESS;
+}
+
 Test(mx_config, mx_create) {
     mx_config *config = mx_create(MX_DEFAULT);
     cr_assert(config != NULL, "mx_create should return not NULL.");
@@ -113,3 +130,115 @@ Test(mx_config, mx_add_function, .init = suite_setup, .fini = suite_teardown) {
     cr_assert(mx_remove(config, "رطانة") == MX_ERR_UNDEFINED);
     cr_assert(mx_evaluate(config, "abs(foo()) + 1.12", NULL) == MX_ERR_UNDEFINED);
 }
+
+Test(mx_config, mx_add_function_ex, .init = suite_setup, .fini = suite_teardown) {
+    double x = 5;
+    int calls = 0;
+
+    cr_assert(mx_add_variable(config, "x", &x) == MX_SUCCESS);
+    cr_assert(mx_add_function_ex(config, "clamp", clamp_wrapper, &calls, 3, 3, MX_FUNC_PURE) == MX_SUCCESS, "successfully inserted function with fixed arity");
+    cr_assert(mx_add_function_ex(config, "max", max_wrapper, NULL, 1, -1, MX_FUNC_THREAD_SAFE) == MX_SUCCESS, "successfully inserted variadic function");
+    cr_assert(mx_add_function_ex(config, "clamp", clamp_wrapper, NULL, 3, 3, MX_FUNC_PURE) == MX_ERR_ALREADY_DEF, "cannot redefine a function");
+    cr_assert(mx_add_function_ex(config, "foo", foo_wrapper, NULL, 2, 1, MX_FUNC_NONE) == MX_ERR_INVALID_ARGS, "did not accept empty range of arguments");
+    cr_assert(mx_add_function_ex(config, "foo", foo_wrapper, NULL, -1, 0, MX_FUNC_NONE) == MX_ERR_INVALID_ARGS, "did not accept negative number of arguments");
+
+    cr_assert(mx_evaluate(config, "clamp(x, 0, 1) + max(x, 2, 7, 3)", &result) == MX_SUCCESS);
+    cr_assert(ieee_ulp_eq(dbl, result, 8, 4));
+    cr_assert(mx_evaluate(config, "max(x)", &result) == MX_SUCCESS);
+    cr_assert(ieee_ulp_eq(dbl, result, 5, 4));
+
+    // Flags not defined in the header are ignored, so they cannot change how the function is called
+    cr_assert(mx_add_function_ex(config, "abs", abs_wrapper, NULL, 1, 1, (mx_func_flag)0xFFFF) == MX_SUCCESS);
+    cr_assert(mx_evaluate(config, "abs(-2.5)", &result) == MX_SUCCESS);
+    cr_assert(ieee_ulp_eq(dbl, result, 2.5, 4));
+    cr_assert(mx_set_function_flags(config, "abs", (mx_func_flag)0xFFFF) == MX_SUCCESS);
+    cr_assert(mx_evaluate(config, "abs(-2.5)", &result) == MX_SUCCESS);
+    cr_assert(ieee_ulp_eq(dbl, result, 2.5, 4));
+    cr_assert(mx_remove(config, "abs") == MX_SUCCESS);
+
+    calls = 0;
+    cr_assert(mx_evaluate(config, "clamp(x, 0)", NULL) == MX_ERR_ARGS_NUM, "too few arguments are rejected when parsing");
+    cr_assert(mx_evaluate(config, "clamp(x, 0, 1, 2)", NULL) == MX_ERR_ARGS_NUM, "too many arguments are rejected when parsing");
+    cr_assert(mx_evaluate(config, "max()", NULL) == MX_ERR_ARGS_NUM);
+    cr_assert(calls == 0, "function is not called with wrong number of arguments");
+
+    mx_program *program;
+    cr_assert(mx_compile(config, "x * clamp(2 * 3, 0, 4)", &program) == MX_SUCCESS);
+    cr_assert(calls == 1, "pure function with constant arguments is called when compiling");
+    cr_assert(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_assert(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_assert(ieee_ulp_eq(dbl, result, 20, 4));
+    cr_assert(calls == 1, "folded call is not evaluated again");
+    mx_program_free(program);
+
+    cr_assert(mx_remove(config, "clamp") == MX_SUCCESS);
+    cr_assert(mx_remove(config, "max") == MX_SUCCESS);
+    cr_assert(mx_remove(config, "x") == MX_SUCCESS);
+}
+
+Test(mx_config, prefixed_names, .init = suite_setup, .fini = suite_teardown) {
+    double values[1000];
+    char name[16];
+
+    // Longer names are added first, so that they come before shorter names in the same bucket
+    for (int i = 999; i >= 0; i--) {
+        values[i] = i;
+        snprintf(name, sizeof(name), "var%d", i);
+        cr_assert(mx_add_variable(config, name, &values[i]) == MX_SUCCESS);
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "var%d", i);
+        cr_assert(mx_evaluate(config, name, &result) == MX_SUCCESS);
+        cr_assert(ieee_ulp_eq(dbl, result, i, 4), "name is not confused with longer name starting with it");
+    }
+
+    cr_assert(mx_remove(config, "var1") == MX_SUCCESS);
+
+    for (int i = 10; i < 20; i++) {
+        snprintf(name, sizeof(name), "var%d", i);
+        cr_assert(mx_evaluate(config, name, &result) == MX_SUCCESS, "removing name keeps longer names starting with it");
+        cr_assert(ieee_ulp_eq(dbl, result, i, 4));
+    }
+
+    cr_assert(mx_evaluate(config, "var1", NULL) == MX_ERR_UNDEFINED);
+}
+
+Test(mx_config, mx_freeze, .init = suite_setup, .fini = suite_teardown) {
+    double values[1000];
+    char name[16];
+
+    for (int i = 0; i < 1000; i++) {
+        values[i] = i;
+        snprintf(name, sizeof(name), "var%d", i);
+        cr_assert(mx_add_variable(config, name, &values[i]) == MX_SUCCESS);
+    }
+
+    cr_assert(mx_add_function(config, "abs", abs_wrapper, NULL) == MX_SUCCESS);
+    cr_assert(mx_freeze(config) == MX_SUCCESS);
+    cr_assert(mx_freeze(config) == MX_SUCCESS, "freezing twice has no effect");
+
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "var%d", i);
+        cr_assert(mx_evaluate(config, name, &result) == MX_SUCCESS, "all names are found after freezing");
+        cr_assert(ieee_ulp_eq(dbl, result, i, 4));
+    }
+
+    cr_assert(mx_evaluate(config, "abs(var1 - var20)", &result) == MX_SUCCESS);
+    cr_assert(ieee_ulp_eq(dbl, result, 19, 4));
+    cr_assert(mx_evaluate(config, "var1000", NULL) == MX_ERR_UNDEFINED);
+    cr_assert(mx_evaluate(config, "var", NULL) == MX_ERR_UNDEFINED);
+
+    cr_assert(mx_add_constant(config, "e", 2.71) == MX_ERR_FROZEN);
+    cr_assert(mx_add_variable(config, "x", &result) == MX_ERR_FROZEN);
+    cr_assert(mx_add_function(config, "foo", foo_wrapper, NULL) == MX_ERR_FROZEN);
+    cr_assert(mx_set_function_flags(config, "abs", MX_FUNC_PURE) == MX_ERR_FROZEN);
+    cr_assert(mx_remove(config, "var1") == MX_ERR_FROZEN);
+
+    mx_config *clone = mx_clone(config);
+    cr_assert(clone != NULL);
+    cr_assert(mx_add_constant(clone, "e", 2.71) == MX_SUCCESS, "copy of frozen config is modifiable");
+    cr_assert(mx_evaluate(clone, "var999 + e", &result) == MX_SUCCESS);
+    cr_assert(ieee_ulp_eq(dbl, result, 1001.71, 4));
+    mx_free(clone);
+}
@@ -22,8 +22,13 @@
 
 #include <criterion/criterion.h>
 #include <criterion/new/assert.h>
+#include "../src/mx_kernels.h"
 #include <math.h>
 #include <mathex.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 mx_error foo_wrapper(double args[], int argc, double *result, void *data) {
     if (argc != 2) {
@@ -70,6 +75,27 @@ mx_error h_wrapper(double args[], int argc, double *result, void *data) {
     return MX_SUCCESS;
 }
 
+mx_error count_wrapper(double args[], int argc, double *result, void *data) {
+    if (argc != 1) {
+        return MX_ERR_ARGS_NUM;
+    }
+
+    (*(int *)data)++;
+    *result = 2 * args[0];
+    return MX_SUCCESS;
+}
+
+mx_error bump_wrapper(double args[], int argc, double *result, void *data) {
+    (*(double *)data)++;
+    *result = args[0];
+    return MX_SUCCESS;
+}
+
+mx_error f_derivative(double args[], int argc, double partials[], void *data) {
+    partials[0] = 2 * args[0];
+    return MX_SUCCESS;
+}
+
 mx_config *config;
 double result;
 
@@ -183,6 +209,23 @@ Test(mx_evaluate, number_format) {
     cr_expect(mx_evaluate(config, "1.6e4.3", NULL) == MX_ERR_SYNTAX);
 }
 
+Test(mx_evaluate, correctly_rounded_numbers) {
+    // Literals are compared with ones converted by the compiler, so results have to be bit-exact
+    const char *literals[] = {"0.1", "0.30000000000000004", "1e-300", "1e23", "9007199254740993", "2.2250738585072011e-308", "4.9406564584124654e-324", "1.7976931348623157e308", "0.1000000000000000055511151231257827021181583404541015625", "123456789012345678901234567890.5e-10"};
+    const double values[] = {0.1, 0.30000000000000004, 1e-300, 1e23, 9007199254740993, 2.2250738585072011e-308, 4.9406564584124654e-324, 1.7976931348623157e308, 0.1000000000000000055511151231257827021181583404541015625, 123456789012345678901234567890.5e-10};
+
+    for (size_t i = 0; i < sizeof(literals) / sizeof(*literals); i++) {
+        cr_expect(mx_evaluate(config, literals[i], &result) == MX_SUCCESS);
+        cr_expect(result == values[i], "%s is converted exactly", literals[i]);
+    }
+
+    cr_expect(mx_evaluate(config, "1e400", &result) == MX_SUCCESS);
+    cr_expect(isinf(result));
+
+    cr_expect(mx_evaluate(config, "1e-400", &result) == MX_SUCCESS);
+    cr_expect(result == 0);
+}
+
 Test(mx_evaluate, variables) {
     cr_expect(mx_evaluate(config, "x + 5", &result) == MX_SUCCESS);
     cr_expect(ieee_ulp_eq(dbl, result, 10, 4));
@@ -254,3 +297,1000 @@ Test(mx_evaluate, functions) {
     cr_expect(mx_evaluate(config, "3^2 + f(2x - g(3^1))", &result) == MX_SUCCESS);
     cr_expect(ieee_ulp_eq(dbl, result, 13, 4));
 }
+
+Test(mx_evaluate, builtin_functions) {
+    mx_config *math = mx_create(MX_DEFAULT | MX_ENABLE_MATH);
+    cr_assert(math != NULL);
+
+    cr_expect(mx_evaluate(math, "sin(0) + cos(0) + exp(0) + log(1) + sqrt(4) + abs(-3) + floor(2.5) + ceil(2.5)", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 12, 4));
+    cr_expect(mx_evaluate(math, "min(3, 1, 2) + max(3, 1, 2) * 10 + min(4)", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 35, 4));
+
+    cr_expect(mx_evaluate(math, "sin(1, 2)", NULL) == MX_ERR_ARGS_NUM);
+    cr_expect(mx_evaluate(math, "max()", NULL) == MX_ERR_ARGS_NUM);
+    cr_expect(mx_evaluate(math, "sin", NULL) == MX_ERR_SYNTAX);
+    cr_expect(mx_evaluate(config, "sin(0)", NULL) == MX_ERR_UNDEFINED, "built-in functions are disabled by default");
+
+    cr_assert(mx_add_function(math, "abs", bar_wrapper, NULL) == MX_SUCCESS, "built-in functions can be replaced");
+    cr_expect(mx_evaluate(math, "abs()", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 5.43, 4));
+    cr_assert(mx_remove(math, "abs") == MX_SUCCESS);
+
+    double var = 0;
+    mx_add_variable(math, "var", &var);
+
+    double values[1003];
+    double results[1003];
+
+    for (int i = 0; i < 1003; i++) {
+        values[i] = (i - 500) * 0.37;
+    }
+
+    mx_column column = {.name = "var", .values = values};
+    mx_program *program;
+
+    // Batch evaluation uses its own implementations, which are within 1 ulp of the C library
+    cr_assert(mx_compile(math, "sin(var) * cos(var / 3) + exp(-abs(var) / 8) - log(1 + var * var) / sqrt(2 + abs(var)) + max(floor(var), ceil(-var), -2)", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval_batch(program, &column, 1, 1003, results) == MX_SUCCESS);
+
+    for (int i = 0; i < 1003; i++) {
+        var = values[i];
+        cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+        cr_expect(ieee_ulp_eq(dbl, results[i], result, 64));
+    }
+
+    cr_expect(mx_program_jit(program) == MX_SUCCESS || mx_program_jit(program) == MX_ERR_NOT_SUPPORTED);
+    var = values[17];
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, results[17], result, 64));
+
+    mx_program_free(program);
+
+    cr_assert(mx_compile(math, "sin(var) * exp(var) + sqrt(var) - floor(var)", &program) == MX_SUCCESS);
+    var = 0.5;
+
+    double derivative;
+    cr_expect(mx_program_eval_derivative(program, NULL, "var", &result, &derivative) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, derivative, (cos(0.5) + sin(0.5)) * exp(0.5) + 0.5 / sqrt(0.5), 4));
+
+    mx_program_free(program);
+    mx_free(math);
+}
+
+Test(mx_evaluate, compiled_programs) {
+    double var = 2;
+    mx_add_variable(config, "var", &var);
+
+    mx_program *program;
+    cr_assert(mx_compile(config, "3 * var + f(var) - bar()", &program) == MX_SUCCESS);
+
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 4.57, 4));
+
+    var = 5;
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 34.57, 4));
+
+    mx_program_free(program);
+    mx_remove(config, "var");
+
+    cr_expect(mx_compile(config, "2 +", &program) == MX_ERR_SYNTAX);
+    cr_expect(mx_compile(config, "var + 2", &program) == MX_ERR_UNDEFINED);
+
+    cr_assert(mx_compile(config, "f()", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval(program, NULL) == MX_ERR_ARGS_NUM);
+    mx_program_free(program);
+}
+
+Test(mx_evaluate, batch_evaluation) {
+    double var = 0;
+    double scale = 2;
+    mx_add_variable(config, "var", &var);
+    mx_add_variable(config, "scale", &scale);
+
+    double values[1000];
+    double results[1000];
+
+    for (int i = 0; i < 1000; i++) {
+        values[i] = i * 0.5;
+    }
+
+    mx_column columns[] = {{.name = "var", .values = values}, {.name = "unused", .values = NULL}};
+    mx_program *program;
+
+    cr_assert(mx_compile(config, "scale * var - h(var, 1) / 2 + bar() - (-var)^3 / 3", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval_batch(program, columns, 2, 1000, results) == MX_SUCCESS);
+
+    for (int i = 0; i < 1000; i++) {
+        var = values[i];
+        cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+        cr_expect(ieee_ulp_eq(dbl, results[i], result, 4));
+    }
+
+    mx_program_free(program);
+
+    cr_assert(mx_compile(config, "f(var, var)", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval_batch(program, columns, 1, 1000, results) == MX_ERR_ARGS_NUM);
+    mx_program_free(program);
+
+    // Variables without a column are read once, even if they change during the call
+    cr_assert(mx_add_function(config, "bump", bump_wrapper, &scale) == MX_SUCCESS);
+    cr_assert(mx_compile(config, "bump(var) + scale", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval_batch(program, columns, 1, 1000, results) == MX_SUCCESS);
+
+    for (int i = 0; i < 1000; i++) {
+        cr_expect(ieee_ulp_eq(dbl, results[i], values[i] + 2, 4));
+    }
+
+    mx_program_free(program);
+
+    mx_remove(config, "bump");
+    mx_remove(config, "var");
+    mx_remove(config, "scale");
+}
+
+Test(mx_evaluate, scalar_kernels) {
+    mx_config *math = mx_create(MX_DEFAULT | MX_ENABLE_POW | MX_ENABLE_MOD | MX_ENABLE_MATH);
+    cr_assert(math != NULL);
+    mx_add_frame_variable(math, "u", 0);
+    mx_add_frame_variable(math, "v", 1);
+
+    size_t n_rows = 1003;
+    double u[1003], v[1003], vector[1003], scalar[1003];
+    float u_f[1003], v_f[1003], vector_f[1003], scalar_f[1003];
+
+    for (size_t i = 0; i < n_rows; i++) {
+        u[i] = (double)i / 16 - 30;
+        v[i] = (double)i / 8 + 0.25;
+        u_f[i] = (float)u[i];
+        v_f[i] = (float)v[i];
+    }
+
+    mx_column columns[] = {{.name = "u", .values = u}, {.name = "v", .values = v}};
+    mx_column_f columns_f[] = {{.name = "u", .values = u_f}, {.name = "v", .values = v_f}};
+    mx_program *program;
+
+    // Every built-in operator has a kernel, so both sets are compared on all of them
+    cr_assert(mx_compile(math,
+                         "sin(u) * cos(v) + exp(u / 8) / sqrt(v) - log(v) + abs(u) * (-v) + max(u, v) - min(u, v) + floor(u) * ceil(v) + u^2 % v + (+u)",
+                         &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval_batch(program, columns, 2, n_rows, vector) == MX_SUCCESS);
+    cr_expect(mx_program_eval_batch_f(program, columns_f, 2, n_rows, vector_f) == MX_SUCCESS);
+
+    force_scalar_kernels(true);
+    cr_expect(mx_program_eval_batch(program, columns, 2, n_rows, scalar) == MX_SUCCESS);
+    cr_expect(mx_program_eval_batch_f(program, columns_f, 2, n_rows, scalar_f) == MX_SUCCESS);
+    force_scalar_kernels(false);
+
+    for (size_t i = 0; i < n_rows; i++) {
+        cr_expect(ieee_ulp_eq(dbl, vector[i], scalar[i], 4));
+        cr_expect(ieee_ulp_eq(flt, vector_f[i], scalar_f[i], 4));
+    }
+
+    mx_program_free(program);
+    mx_free(math);
+}
+
+Test(mx_evaluate, workspace) {
+    mx_workspace *workspace = mx_workspace_create();
+    cr_assert(workspace != NULL);
+
+    cr_expect(mx_evaluate_ws(config, workspace, "3^2 + f(2x - g(3^1))", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 13, 4));
+
+    cr_expect(mx_evaluate_ws(config, workspace, "4 + 6 + * 2", NULL) == MX_ERR_SYNTAX);
+    cr_expect(mx_evaluate_ws(config, workspace, "f()", NULL) == MX_ERR_ARGS_NUM);
+
+    cr_expect(mx_evaluate_ws(config, workspace, "h(x, y) + z", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 34, 4));
+
+    mx_program *program;
+    cr_assert(mx_compile(config, "2 * g(y) - f(x)", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval_ws(program, workspace, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, -9, 4));
+
+    mx_program_free(program);
+    mx_workspace_free(workspace);
+}
+
+Test(mx_evaluate, expression_slices) {
+    mx_workspace *workspace = mx_workspace_create();
+    cr_assert(workspace != NULL);
+
+    // Characters after the given length are never read
+    cr_expect(mx_evaluate_ws_n(config, workspace, "1 + 2xyz", 5, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 3, 4));
+
+    cr_expect(mx_evaluate_ws_n(config, workspace, "f(x)y", 4, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 25, 4));
+
+    cr_expect(mx_evaluate_ws_n(config, workspace, "2.5e3", 3, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 2.5, 4));
+
+    cr_expect(mx_evaluate_ws_n(config, workspace, "x + foo", 5, NULL) == MX_ERR_SYNTAX);
+    cr_expect(mx_evaluate_ws_n(config, workspace, "x + yz", 5, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 8, 4));
+
+    cr_expect(mx_evaluate_ws_n(config, workspace, "x + y", 0, NULL) == MX_ERR_SYNTAX);
+
+    mx_workspace_free(workspace);
+}
+
+Test(mx_evaluate, native_code) {
+    double var = 1.5;
+    mx_add_variable(config, "var", &var);
+
+    const char *expressions[] = {"3^2 + f(2x - g(3^1))", "-var * (var - 4) / 2 + bar()", "h(var, -var^2) - foo(var, 1) / z", "2pi * var + y"};
+    double expected[4];
+    mx_program *programs[4];
+
+    for (int i = 0; i < 4; i++) {
+        cr_assert(mx_compile(config, expressions[i], &programs[i]) == MX_SUCCESS);
+        cr_expect(mx_program_eval(programs[i], &expected[i]) == MX_SUCCESS);
+
+        mx_error error = mx_program_jit(programs[i]);
+        cr_expect(error == MX_SUCCESS || error == MX_ERR_NOT_SUPPORTED);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        cr_expect(mx_program_eval(programs[i], &result) == MX_SUCCESS);
+        cr_expect(ieee_ulp_eq(dbl, result, expected[i], 0));
+        mx_program_free(programs[i]);
+    }
+
+    mx_program *program;
+    cr_assert(mx_compile(config, "2 * f(var, var)", &program) == MX_SUCCESS);
+    mx_program_jit(program);
+    cr_expect(mx_program_eval(program, NULL) == MX_ERR_ARGS_NUM);
+    mx_program_free(program);
+
+    mx_remove(config, "var");
+}
+
+Test(mx_evaluate, constant_folding) {
+    double var = 4;
+    mx_add_variable(config, "var", &var);
+
+    const char *expressions[] = {"2 * pi * var", "(1 / 3) * var", "-(2^3) + var * (-z) / (x - 1)", "f(2 * 3) + var"};
+    const double expected[] = {2 * pi * 4, (1.0 / 3) * 4, -8 + 4 * -z / (x - 1), 40};
+
+    for (int i = 0; i < 4; i++) {
+        mx_program *program;
+        cr_assert(mx_compile(config, expressions[i], &program) == MX_SUCCESS);
+        cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+        cr_expect(ieee_ulp_eq(dbl, result, expected[i], 0));
+        mx_program_free(program);
+    }
+
+    mx_program *program;
+    cr_assert(mx_compile(config, "var + 1 / 0", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_expect(isinf(result) && result > 0);
+    mx_program_free(program);
+
+    cr_assert(mx_compile(config, "(0 / 0) * var", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_expect(isnan(result));
+    mx_program_free(program);
+
+    cr_assert(mx_compile(config, "2 + 3", &program) == MX_SUCCESS);
+    cr_expect(mx_program_jit(program) == MX_SUCCESS || mx_program_jit(program) == MX_ERR_NOT_SUPPORTED);
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 5, 0));
+    mx_program_free(program);
+
+    mx_remove(config, "var");
+}
+
+Test(mx_evaluate, common_subexpressions) {
+    double var = 7;
+    int calls = 0;
+    mx_add_variable(config, "var", &var);
+    mx_add_function(config, "count", count_wrapper, &calls);
+
+    mx_program *program;
+    cr_assert(mx_compile(config, "count(var - x) * count(var - x) + count(var - x)", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 20, 0));
+    cr_expect(calls == 3, "impure functions are called every time");
+    mx_program_free(program);
+
+    cr_expect(mx_set_function_flags(config, "count", MX_FUNC_PURE) == MX_SUCCESS);
+    cr_expect(mx_set_function_flags(config, "var", MX_FUNC_PURE) == MX_ERR_UNDEFINED);
+    cr_expect(mx_set_function_flags(config, "undefined", MX_FUNC_PURE) == MX_ERR_UNDEFINED);
+
+    calls = 0;
+    cr_assert(mx_compile(config, "count(var - x) * count(var - x) + count(var - x)", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 20, 0));
+    cr_expect(calls == 1, "pure functions are called once for identical arguments");
+    mx_program_free(program);
+
+    const char *expression = "((var - x) / y)^2 + h((var - x) / y, count(var - x)) - ((var - x) / y)^2 * (var - x)";
+    double expected = pow((7 - x) / y, 2) + (pow((7 - x) / y, 2) + 2 * (7 - x)) - pow((7 - x) / y, 2) * (7 - x);
+
+    cr_assert(mx_compile(config, expression, &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, expected, 4));
+
+    double values[] = {7, 7, 7};
+    double results[3];
+    mx_column column = {.name = "var", .values = values};
+    cr_expect(mx_program_eval_batch(program, &column, 1, 3, results) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, results[2], expected, 4));
+
+    mx_program_jit(program);
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, expected, 4));
+    mx_program_free(program);
+
+    mx_remove(config, "var");
+    mx_remove(config, "count");
+}
+
+Test(mx_evaluate, expression_cache) {
+    mx_cache_stats stats;
+    double var = 2;
+
+    mx_add_variable(config, "var", &var);
+    cr_assert(mx_enable_cache(config, 2, 1 << 20) == MX_SUCCESS);
+
+    cr_expect(mx_evaluate(config, "var * x + 1", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 11, 4));
+    var = 3;
+    cr_expect(mx_evaluate(config, "var * x + 1", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 16, 4));
+    cr_expect(mx_evaluate(config, "var *", &result) == MX_ERR_SYNTAX);
+
+    mx_get_cache_stats(config, &stats);
+    cr_expect(stats.hits == 1);
+    cr_expect(stats.misses == 2);
+    cr_expect(stats.entries == 1);
+    cr_expect(stats.bytes > 0);
+
+    // Changes of the config invalidate cached expressions
+    cr_expect(mx_evaluate(config, "var + w", &result) == MX_ERR_UNDEFINED);
+    mx_add_constant(config, "w", 10);
+    cr_expect(mx_evaluate(config, "var + w", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 13, 4));
+    mx_remove(config, "w");
+    cr_expect(mx_evaluate(config, "var + w", &result) == MX_ERR_UNDEFINED);
+
+    mx_get_cache_stats(config, &stats);
+    cr_expect(stats.entries == 0);
+
+    // Least recently used expressions are evicted
+    mx_workspace *workspace = mx_workspace_create();
+    cr_assert(workspace != NULL);
+
+    cr_expect(mx_evaluate_ws(config, workspace, "1 + 2", &result) == MX_SUCCESS);
+    cr_expect(mx_evaluate_ws(config, workspace, "3 + 4", &result) == MX_SUCCESS);
+    cr_expect(mx_evaluate_ws(config, workspace, "5 + 6", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 11, 4));
+
+    mx_get_cache_stats(config, &stats);
+    cr_expect(stats.entries <= 2);
+    cr_expect(stats.evictions >= 1);
+    mx_workspace_free(workspace);
+
+    cr_expect(mx_enable_cache(config, 0, 0) == MX_SUCCESS);
+    mx_get_cache_stats(config, &stats);
+    cr_expect(stats.hits == 0 && stats.misses == 0 && stats.entries == 0);
+    cr_expect(mx_evaluate(config, "var * x + 1", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 16, 4));
+
+    mx_remove(config, "var");
+}
+
+void *evaluate_concurrently(void *data) {
+    const char *expressions[] = {"x + 1", "x + 2", "x + 3", "x + 4", "x + 5", "x + 6", "x + 7", "x + 8"};
+    bool *failed = data;
+
+    for (int i = 0; i < 1000; i++) {
+        double value;
+        int j = i % 8;
+
+        if (mx_evaluate(config, expressions[j], &value) != MX_SUCCESS || value != x + j + 1) {
+            *failed = true;
+        }
+    }
+
+    return NULL;
+}
+
+Test(mx_evaluate, concurrent_cache) {
+    pthread_t threads[4];
+    bool failed[4] = {false};
+    mx_cache_stats stats;
+
+    cr_assert(mx_enable_cache(config, 4, 1 << 20) == MX_SUCCESS);
+
+    for (int i = 0; i < 4; i++) {
+        cr_assert(pthread_create(&threads[i], NULL, evaluate_concurrently, &failed[i]) == 0);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+        cr_expect(!failed[i]);
+    }
+
+    mx_get_cache_stats(config, &stats);
+    cr_expect(stats.hits + stats.misses == 4000);
+    cr_expect(stats.entries <= 4);
+}
+
+Test(mx_evaluate, shared_config) {
+    mx_config *initial = mx_clone(config);
+    cr_assert(initial != NULL);
+    mx_add_constant(initial, "version", 0);
+
+    mx_shared *shared = mx_shared_create(initial);
+    mx_reader *reader = mx_reader_create(shared);
+    cr_assert(shared != NULL && reader != NULL);
+
+    const mx_config *snapshot = mx_read_begin(reader);
+    cr_expect(mx_evaluate(snapshot, "version + x", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 5, 4));
+
+    mx_config *edited = mx_shared_edit(shared);
+    cr_assert(edited != NULL);
+    mx_remove(edited, "version");
+    mx_add_constant(edited, "version", 1);
+    cr_expect(mx_shared_publish(shared, edited) == MX_SUCCESS);
+
+    // Snapshot stays valid and unchanged until the end of read section
+    cr_expect(mx_evaluate(snapshot, "version + x", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 5, 4));
+    mx_read_end(reader);
+
+    snapshot = mx_read_begin(reader);
+    cr_expect(mx_evaluate(snapshot, "version + x", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 6, 4));
+    mx_read_end(reader);
+
+    mx_reader_free(reader);
+    mx_shared_free(shared);
+}
+
+typedef struct shared_reader_state {
+    mx_shared *shared;
+    bool failed;
+} shared_reader_state;
+
+void *read_concurrently(void *data) {
+    shared_reader_state *state = data;
+    mx_reader *reader = mx_reader_create(state->shared);
+    double last = 0;
+
+    for (int i = 0; i < 2000; i++) {
+        double value;
+        const mx_config *snapshot = mx_read_begin(reader);
+
+        if (mx_evaluate(snapshot, "version", &value) != MX_SUCCESS || value < last) {
+            state->failed = true;
+        }
+
+        last = value;
+        mx_read_end(reader);
+    }
+
+    mx_reader_free(reader);
+    return NULL;
+}
+
+Test(mx_evaluate, concurrent_shared_config) {
+    mx_config *initial = mx_create(MX_DEFAULT);
+    mx_add_constant(initial, "version", 0);
+
+    mx_shared *shared = mx_shared_create(initial);
+    pthread_t threads[4];
+    shared_reader_state states[4];
+
+    for (int i = 0; i < 4; i++) {
+        states[i].shared = shared;
+        states[i].failed = false;
+        cr_assert(pthread_create(&threads[i], NULL, read_concurrently, &states[i]) == 0);
+    }
+
+    for (int version = 1; version <= 200; version++) {
+        mx_config *edited = mx_shared_edit(shared);
+        mx_remove(edited, "version");
+        mx_add_constant(edited, "version", version);
+        cr_expect(mx_shared_publish(shared, edited) == MX_SUCCESS);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+        cr_expect(!states[i].failed);
+    }
+
+    mx_shared_free(shared);
+}
+
+mx_error sum_wrapper(double args[], int argc, double *result, void *data) {
+    (*(int *)data)++;
+    *result = 0;
+
+    for (int i = 0; i < argc; i++) {
+        *result += args[i];
+    }
+
+    return MX_SUCCESS;
+}
+
+mx_error positive_wrapper(double args[], int argc, double *result, void *data) {
+    if (argc != 1) {
+        return MX_ERR_ARGS_NUM;
+    }
+
+    if (args[0] < 0) {
+        return MX_ERR_INVALID_ARGS;
+    }
+
+    *result = args[0];
+    return MX_SUCCESS;
+}
+
+Test(mx_evaluate, parallel_evaluation) {
+    double var = 0;
+    int calls = 0;
+    mx_add_variable(config, "var", &var);
+    mx_add_function(config, "sum", sum_wrapper, &calls);
+    mx_add_function(config, "positive", positive_wrapper, NULL);
+    mx_set_function_flags(config, "positive", MX_FUNC_THREAD_SAFE);
+
+    size_t n_rows = 100003;
+    double *values = malloc(sizeof(double) * n_rows);
+    double *results = malloc(sizeof(double) * n_rows);
+    double *expected = malloc(sizeof(double) * n_rows);
+    cr_assert(values != NULL && results != NULL && expected != NULL);
+
+    for (size_t i = 0; i < n_rows; i++) {
+        values[i] = (double)i;
+    }
+
+    mx_column column = {.name = "var", .values = values};
+    mx_program *program;
+    cr_assert(mx_compile(config, "sum(var, x) * positive(var - y / 2 + 2) + var^2 / 4", &program) == MX_SUCCESS);
+    cr_assert(mx_program_eval_batch(program, &column, 1, n_rows, expected) == MX_SUCCESS);
+
+    mx_pool *pool = mx_pool_create(4);
+    cr_assert(pool != NULL);
+
+    for (int i = 0; i < 2; i++) {
+        calls = 0;
+        cr_expect(mx_program_eval_parallel(program, i == 0 ? pool : NULL, &column, 1, n_rows, results) == MX_SUCCESS);
+        cr_expect(memcmp(results, expected, sizeof(double) * n_rows) == 0);
+        cr_expect(calls == (int)n_rows, "every call of functions that are not thread-safe is counted");
+    }
+
+    values[n_rows / 2] = -10;
+    cr_expect(mx_program_eval_parallel(program, pool, &column, 1, n_rows, results) == MX_ERR_INVALID_ARGS);
+
+    mx_pool_free(pool);
+    mx_program_free(program);
+    free(values);
+    free(results);
+    free(expected);
+
+    mx_remove(config, "var");
+    mx_remove(config, "sum");
+    mx_remove(config, "positive");
+}
+
+mx_error halve_wrapper(float args[], int argc, float *result, void *data) {
+    *result = args[0] / 2;
+    return MX_SUCCESS;
+}
+
+Test(mx_evaluate, single_precision) {
+    float level = 1.5f;
+    mx_add_variable_f(config, "level", &level);
+    mx_add_frame_variable(config, "var", 0);
+    cr_assert(mx_add_function_f(config, "halve", halve_wrapper, NULL, 1, 1, MX_FUNC_NONE) == MX_SUCCESS);
+    cr_assert(mx_set_function_flags(config, "halve", MX_FUNC_PURE) == MX_SUCCESS);
+
+    size_t n_rows = 10007;
+    float *values = malloc(sizeof(float) * n_rows);
+    float *results = malloc(sizeof(float) * n_rows);
+    float *parallel = malloc(sizeof(float) * n_rows);
+    cr_assert(values != NULL && results != NULL && parallel != NULL);
+
+    for (size_t i = 0; i < n_rows; i++) {
+        values[i] = (float)i / 64 - 50;
+    }
+
+    mx_column_f column = {.name = "var", .values = values};
+    mx_program *program;
+    cr_assert(mx_compile(config, "halve(var) * level + f(var) - y", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval_batch_f(program, &column, 1, n_rows, results) == MX_SUCCESS);
+    cr_expect(mx_program_eval_parallel_f(program, NULL, &column, 1, n_rows, parallel) == MX_SUCCESS);
+    cr_expect(memcmp(results, parallel, sizeof(float) * n_rows) == 0);
+
+    for (size_t i = 0; i < n_rows; i++) {
+        float expected = values[i] / 2 * level + values[i] * values[i] - 3;
+        cr_expect(ieee_ulp_eq(flt, results[i], expected, 2));
+    }
+
+    // Evaluation of compiled programs converts single-precision values to double
+    double frame[] = {3.25};
+    cr_expect(mx_program_eval_frame(program, frame, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 3.25 / 2 * 1.5 + 3.25 * 3.25 - 3, 4));
+
+    if (mx_program_jit(program) == MX_SUCCESS) {
+        cr_expect(mx_program_eval_frame(program, frame, &result) == MX_SUCCESS);
+        cr_expect(ieee_ulp_eq(dbl, result, 3.25 / 2 * 1.5 + 3.25 * 3.25 - 3, 4));
+    }
+
+    mx_program_free(program);
+
+    // Precision does not depend on which column array is given, even if there are no columns
+    double unbound[2];
+    float unbound_f[2];
+    mx_pool *pool = mx_pool_create(2);
+    cr_assert(pool != NULL);
+    cr_assert(mx_compile(config, "y * 2", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval_batch(program, NULL, 0, 2, unbound) == MX_SUCCESS);
+    cr_expect(unbound[0] == 6 && unbound[1] == 6);
+    cr_expect(mx_program_eval_parallel(program, pool, NULL, 0, 2, unbound) == MX_SUCCESS);
+    cr_expect(unbound[0] == 6 && unbound[1] == 6);
+    cr_expect(mx_program_eval_batch_f(program, NULL, 0, 2, unbound_f) == MX_SUCCESS);
+    cr_expect(unbound_f[0] == 6 && unbound_f[1] == 6);
+    cr_expect(mx_program_eval_parallel_f(program, pool, NULL, 0, 2, unbound_f) == MX_SUCCESS);
+    cr_expect(unbound_f[0] == 6 && unbound_f[1] == 6);
+    mx_program_free(program);
+    mx_pool_free(pool);
+
+    cr_expect(mx_evaluate(config, "halve(level) + halve(1, 2)", NULL) == MX_ERR_ARGS_NUM);
+
+    free(values);
+    free(results);
+    free(parallel);
+
+    mx_remove(config, "level");
+    mx_remove(config, "var");
+    mx_remove(config, "halve");
+}
+
+static void write_column(const char *path, const double values[], size_t n_rows) {
+    FILE *file = fopen(path, "wb");
+    cr_assert(file != NULL);
+    cr_assert(fwrite(values, sizeof(double), n_rows, file) == n_rows);
+    fclose(file);
+}
+
+Test(mx_evaluate, column_files) {
+    const size_t n_rows = 3000000;
+    double *values = malloc(sizeof(double) * n_rows);
+    double *results = malloc(sizeof(double) * n_rows);
+    cr_assert(values != NULL && results != NULL);
+
+    for (size_t i = 0; i < n_rows; i++) {
+        values[i] = (double)i;
+    }
+
+    write_column("mx_column_a.f64", values, n_rows);
+    write_column("mx_column_b.f64", values, n_rows - 1);
+
+    cr_assert(mx_add_frame_variable(config, "col", 0) == MX_SUCCESS);
+    mx_program *program;
+    cr_assert(mx_compile(config, "2col - y", &program) == MX_SUCCESS);
+
+    mx_column_file files[] = {{"col", "mx_column_a.f64"}, {"unused", "mx_column_a.f64"}};
+    mx_error error_code = mx_program_eval_files(program, NULL, files, 2, "mx_column_out.f64");
+
+    if (error_code != MX_ERR_NOT_SUPPORTED) {
+        cr_expect(error_code == MX_SUCCESS);
+
+        FILE *output = fopen("mx_column_out.f64", "rb");
+        cr_assert(output != NULL);
+        cr_expect(fread(results, sizeof(double), n_rows, output) == n_rows);
+        cr_expect(fgetc(output) == EOF, "output has exactly one value per row");
+        fclose(output);
+
+        for (size_t i = 0; i < n_rows; i += 1009) {
+            cr_expect(ieee_ulp_eq(dbl, results[i], 2 * values[i] - 3, 4));
+        }
+
+        files[1].path = "mx_column_b.f64";
+        cr_expect(mx_program_eval_files(program, NULL, files, 2, "mx_column_out.f64") == MX_ERR_INVALID_ARGS);
+        cr_expect(mx_program_eval_files(program, NULL, files, 1, "mx_column_a.f64") == MX_ERR_INVALID_ARGS, "output cannot replace input");
+
+        files[0].path = "mx_column_missing.f64";
+        cr_expect(mx_program_eval_files(program, NULL, files, 1, "mx_column_out.f64") == MX_ERR_IO);
+    }
+
+    remove("mx_column_a.f64");
+    remove("mx_column_b.f64");
+    remove("mx_column_out.f64");
+
+    mx_program_free(program);
+    free(values);
+    free(results);
+
+    mx_remove(config, "col");
+}
+
+Test(mx_evaluate, frame_variables) {
+    cr_assert(mx_add_frame_variable(config, "px", 0) == MX_SUCCESS);
+    cr_assert(mx_add_frame_variable(config, "py", 2) == MX_SUCCESS);
+    cr_expect(mx_add_frame_variable(config, "1px", 1) == MX_ERR_ILLEGAL_NAME);
+
+    mx_program *program;
+    cr_assert(mx_compile(config, "(px + py) * (px + py) - px / 2", &program) == MX_SUCCESS);
+
+    double first[] = {1, -100, 3};
+    double second[] = {4, -100, 2};
+    double result;
+
+    cr_expect(mx_program_eval_frame(program, first, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 15.5, 4));
+    cr_expect(mx_program_eval_frame(program, second, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 34.0, 4));
+
+    cr_expect(mx_program_eval(program, &result) == MX_ERR_UNDEFINED, "frame variables have no value without a frame");
+    cr_expect(mx_evaluate(config, "px", &result) == MX_ERR_UNDEFINED);
+
+    if (mx_program_jit(program) == MX_SUCCESS) {
+        cr_expect(mx_program_eval_frame(program, second, &result) == MX_SUCCESS);
+        cr_expect(ieee_ulp_eq(dbl, result, 34.0, 4));
+    }
+
+    double xs[] = {1, 4, 0};
+    double ys[] = {3, 2, 1};
+    double results[3];
+    mx_column columns[] = {{.name = "px", .values = xs}, {.name = "py", .values = ys}};
+
+    cr_expect(mx_program_eval_batch(program, columns, 2, 3, results) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, results[0], 15.5, 4));
+    cr_expect(ieee_ulp_eq(dbl, results[1], 34.0, 4));
+    cr_expect(ieee_ulp_eq(dbl, results[2], 1.0, 4));
+    cr_expect(mx_program_eval_batch(program, columns, 1, 3, results) == MX_ERR_UNDEFINED, "every frame variable needs a column");
+
+    mx_program_free(program);
+
+    mx_remove(config, "px");
+    mx_remove(config, "py");
+}
+
+Test(mx_evaluate, derivatives) {
+    cr_assert(mx_add_frame_variable(config, "px", 0) == MX_SUCCESS);
+    cr_assert(mx_add_frame_variable(config, "py", 1) == MX_SUCCESS);
+    cr_assert(mx_set_function_derivative(config, "f", f_derivative) == MX_SUCCESS);
+    cr_expect(mx_set_function_derivative(config, "x", f_derivative) == MX_ERR_UNDEFINED);
+
+    mx_program *program;
+    cr_assert(mx_compile(config, "x * px^2 + f(py) / px - (px * py)^2 / (px * py)", &program) == MX_SUCCESS);
+
+    const double frame[] = {2, 3};
+    const char *names[] = {"py", "unused", "px", "x"};
+    double derivative, gradient[4];
+
+    cr_expect(mx_program_eval_derivative(program, frame, "px", &result, &derivative) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 18.5, 4));
+    cr_expect(ieee_ulp_eq(dbl, derivative, 14.75, 4));
+
+    cr_expect(mx_program_eval_gradient(program, frame, names, 4, &result, gradient) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 18.5, 4));
+    cr_expect(ieee_ulp_eq(dbl, gradient[0], 1.0, 4));
+    cr_expect(ieee_ulp_eq(dbl, gradient[2], 14.75, 4));
+    cr_expect(gradient[1] == 0 && gradient[3] == 0, "constants and unused names have zero derivative");
+
+    mx_program_free(program);
+
+    // Function without derivative cannot be differentiated only with respect to variables its arguments depend on
+    cr_assert(mx_compile(config, "g(py) * px", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval_derivative(program, frame, "px", &result, &derivative) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, derivative, 8.0, 4));
+    cr_expect(mx_program_eval_derivative(program, frame, "py", &result, &derivative) == MX_ERR_NOT_SUPPORTED);
+    cr_expect(mx_program_eval_gradient(program, frame, names, 4, &result, gradient) == MX_ERR_NOT_SUPPORTED);
+    cr_expect(mx_program_eval_gradient(program, NULL, names, 4, &result, gradient) == MX_ERR_UNDEFINED);
+
+    mx_program_free(program);
+
+    // Operand discarded by min and max does not affect the derivative, even if its derivative is undefined
+    mx_config *math = mx_create(MX_DEFAULT | MX_ENABLE_MATH);
+    cr_assert(math != NULL);
+    cr_assert(mx_add_frame_variable(math, "px", 0) == MX_SUCCESS);
+    const char *expressions[] = {"max(px, sqrt(0 - px))", "max(px, px / 0 * 0)", "min(-px, -sqrt(0 - px))"};
+
+    for (size_t i = 0; i < sizeof(expressions) / sizeof(expressions[0]); i++) {
+        double expected = i < 2 ? 1 : -1;
+        cr_assert(mx_compile(math, expressions[i], &program) == MX_SUCCESS);
+        cr_expect(mx_program_eval_derivative(program, frame, "px", &result, &derivative) == MX_SUCCESS);
+        cr_expect(derivative == expected, "%s", expressions[i]);
+        cr_expect(mx_program_eval_gradient(program, frame, names, 4, &result, gradient) == MX_SUCCESS);
+        cr_expect(gradient[2] == expected, "%s", expressions[i]);
+        mx_program_free(program);
+    }
+
+    mx_free(math);
+
+    mx_set_function_derivative(config, "f", NULL);
+    mx_remove(config, "px");
+    mx_remove(config, "py");
+}
+
+Test(mx_evaluate, incremental_evaluation) {
+    double a = 1, b = 2;
+    int pure_calls = 0, impure_calls = 0;
+
+    cr_assert(mx_add_variable(config, "va", &a) == MX_SUCCESS);
+    cr_assert(mx_add_variable(config, "vb", &b) == MX_SUCCESS);
+    cr_assert(mx_add_function(config, "counted", count_wrapper, &pure_calls) == MX_SUCCESS);
+    cr_assert(mx_add_function(config, "impure", count_wrapper, &impure_calls) == MX_SUCCESS);
+    cr_assert(mx_set_function_flags(config, "counted", MX_FUNC_PURE) == MX_SUCCESS);
+
+    mx_program *program;
+    cr_assert(mx_compile(config, "counted(va) + counted(vb) * vb + x", &program) == MX_SUCCESS);
+
+    mx_incremental *state = mx_incremental_create(program);
+    cr_assert(state != NULL);
+
+    cr_expect(mx_incremental_eval(state, NULL, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 15.0, 4));
+    cr_expect(pure_calls == 2);
+
+    a = 3;
+    cr_expect(mx_incremental_mark(state, "va") == MX_SUCCESS);
+    cr_expect(mx_incremental_mark(state, "unused") == MX_SUCCESS);
+    cr_expect(mx_incremental_eval(state, NULL, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 19.0, 4));
+    cr_expect(pure_calls == 3, "only operations depending on changed variable are recomputed");
+
+    cr_expect(mx_incremental_eval(state, NULL, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 19.0, 4));
+    cr_expect(pure_calls == 3);
+
+    a = 1;
+    b = 4;
+    mx_incremental_mark(state, "va");
+    mx_incremental_mark(state, "vb");
+    cr_expect(mx_incremental_eval(state, NULL, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 39.0, 4));
+    cr_expect(pure_calls == 5);
+
+    mx_incremental_free(state);
+    mx_program_free(program);
+
+    // Functions that are not pure are called on every evaluation
+    cr_assert(mx_compile(config, "impure(vb) + va", &program) == MX_SUCCESS);
+    state = mx_incremental_create(program);
+    cr_assert(state != NULL);
+
+    cr_expect(mx_incremental_eval(state, NULL, &result) == MX_SUCCESS);
+    cr_expect(mx_incremental_eval(state, NULL, &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 9.0, 4));
+    cr_expect(impure_calls == 2);
+
+    mx_incremental_free(state);
+    mx_program_free(program);
+
+    mx_remove(config, "va");
+    mx_remove(config, "vb");
+    mx_remove(config, "counted");
+    mx_remove(config, "impure");
+}
+
+Test(mx_evaluate, formula_graph) {
+    mx_graph *graph = mx_graph_create(config);
+    cr_assert(graph != NULL);
+
+    // Formulas can refer to formulas defined after them
+    cr_expect(mx_graph_define(graph, "total", "part1 + part2") == MX_SUCCESS);
+    cr_expect(mx_graph_define(graph, "part1", "x * 2") == MX_SUCCESS);
+    cr_expect(mx_graph_define(graph, "part2", "part1 / 4 + y") == MX_SUCCESS);
+    cr_expect(mx_graph_define(graph, "x", "1") == MX_ERR_ALREADY_DEF);
+    cr_expect(mx_graph_value(graph, "total", &result) == MX_ERR_UNDEFINED, "formulas are not computed before recompute");
+
+    cr_expect(mx_graph_recompute(graph, NULL) == MX_SUCCESS);
+    cr_expect(mx_graph_value(graph, "total", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 15.5, 4));
+    cr_expect(mx_graph_value(graph, "part2", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 5.5, 4));
+    cr_expect(mx_graph_value(graph, "x", &result) == MX_ERR_UNDEFINED);
+
+    cr_expect(mx_graph_define(graph, "loop1", "loop2 + 1") == MX_SUCCESS);
+    cr_expect(mx_graph_define(graph, "loop2", "loop1 * 2") == MX_SUCCESS);
+    cr_expect(mx_graph_define(graph, "broken", "part1 +") == MX_SUCCESS);
+    cr_expect(mx_graph_recompute(graph, NULL) == MX_ERR_SYNTAX);
+    cr_expect(mx_graph_value(graph, "loop1", &result) == MX_ERR_CYCLE);
+    cr_expect(mx_graph_value(graph, "broken", &result) == MX_ERR_SYNTAX);
+    cr_expect(mx_graph_value(graph, "total", &result) == MX_SUCCESS, "failed formulas do not stop the rest");
+
+    cr_expect(mx_graph_define(graph, "broken", "part1 + 1") == MX_SUCCESS);
+    cr_expect(mx_graph_recompute(graph, NULL) == MX_ERR_CYCLE);
+
+    cr_expect(mx_graph_define(graph, "loop2", "total - 0.5") == MX_SUCCESS);
+    cr_expect(mx_graph_recompute(graph, NULL) == MX_SUCCESS);
+    cr_expect(mx_graph_value(graph, "loop1", &result) == MX_SUCCESS);
+    cr_expect(ieee_ulp_eq(dbl, result, 16.0, 4));
+
+    // Wide levels are split between threads of the pool
+    mx_pool *pool = mx_pool_create(2);
+    cr_assert(pool != NULL);
+
+    char name[32], expression[64];
+
+    for (int i = 0; i < 500; i++) {
+        snprintf(name, sizeof(name), "wide%d", i);
+        snprintf(expression, sizeof(expression), i % 2 == 0 ? "total * %d" : "wide%d + 1", i - i % 2);
+        cr_expect(mx_graph_define(graph, name, expression) == MX_SUCCESS);
+    }
+
+    cr_expect(mx_graph_recompute(graph, pool) == MX_SUCCESS);
+
+    for (int i = 0; i < 500; i++) {
+        snprintf(name, sizeof(name), "wide%d", i);
+        cr_expect(mx_graph_value(graph, name, &result) == MX_SUCCESS);
+        cr_expect(ieee_ulp_eq(dbl, result, 15.5 * (i - i % 2) + i % 2, 4));
+    }
+
+    mx_pool_free(pool);
+    mx_graph_free(graph);
+
+    cr_expect(mx_evaluate(config, "total", NULL) == MX_ERR_UNDEFINED, "names of formulas are removed with the graph");
+}
+
+Test(mx_evaluate, statistics) {
+    mx_stats stats;
+
+    mx_get_stats(config, &stats);
+    cr_expect(stats.evaluations == 0, "statistics are disabled by default");
+
+    cr_assert(mx_enable_stats(config, MX_STATS_COUNT) == MX_SUCCESS);
+    cr_expect(mx_evaluate(config, "x + y * f(2)", &result) == MX_SUCCESS);
+    cr_expect(mx_evaluate(config, "x +", &result) == MX_ERR_SYNTAX);
+    cr_expect(mx_evaluate(config, "unknown", &result) == MX_ERR_UNDEFINED);
+
+    mx_get_stats(config, &stats);
+    cr_expect(stats.evaluations == 3);
+    cr_expect(stats.compilations == 0);
+    cr_expect(stats.tokens == 7, "tokens of successfully parsed expression and the operand of failed one");
+    cr_expect(stats.lookups == 5);
+    cr_expect(stats.probes >= 4, "every defined identifier is compared at least once");
+    cr_expect(stats.calls == 1);
+    cr_expect(stats.errors[MX_SUCCESS] == 0);
+    cr_expect(stats.errors[MX_ERR_SYNTAX] == 1);
+    cr_expect(stats.errors[MX_ERR_UNDEFINED] == 1);
+    cr_expect(stats.parse_cycles == 0 && stats.eval_cycles == 0, "timing is not enabled");
+
+    // Warmed up workspace does not allocate
+    mx_workspace *workspace = mx_workspace_create();
+    cr_assert(workspace != NULL);
+    cr_expect(mx_evaluate_ws(config, workspace, "1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 10 + 11 + 12", &result) == MX_SUCCESS);
+
+    size_t allocations = stats.allocations;
+    mx_get_stats(config, &stats);
+    cr_expect(stats.allocations > allocations);
+
+    allocations = stats.allocations;
+    cr_expect(mx_evaluate_ws(config, workspace, "1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 10 + 11 + 12", &result) == MX_SUCCESS);
+    mx_get_stats(config, &stats);
+    cr_expect(stats.allocations == allocations);
+    mx_workspace_free(workspace);
+
+    mx_program *program;
+    cr_assert(mx_compile(config, "g(x) + pi", &program) == MX_SUCCESS);
+    cr_expect(mx_program_eval(program, &result) == MX_SUCCESS);
+
+    mx_get_stats(config, &stats);
+    cr_expect(stats.compilations == 1);
+    cr_expect(stats.evaluations == 5, "evaluation of compiled expressions is not counted");
+    mx_program_free(program);
+
+    mx_error error_code = mx_enable_stats(config, MX_STATS_TIMING);
+    cr_expect(error_code == MX_SUCCESS || error_code == MX_ERR_NOT_SUPPORTED);
+
+    if (error_code == MX_SUCCESS) {
+        cr_expect(mx_evaluate(config, "x + y * f(2)", &result) == MX_SUCCESS);
+        mx_get_stats(config, &stats);
+        cr_expect(stats.evaluations == 1, "previous statistics are replaced");
+        cr_expect(stats.parse_cycles > 0);
+    }
+
+    cr_assert(mx_enable_stats(config, MX_STATS_NONE) == MX_SUCCESS);
+    mx_get_stats(config, &stats);
+    cr_expect(stats.evaluations == 0);
+}
@@ -0,0 +1,122 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+#include <criterion/criterion.h>
+#include <cstring>
+#include <mathex.hpp>
+
+using mathex::bind;
+using mathex::Flags;
+using mathex::StaticExpression;
+
+constexpr Flags AllFlags = static_cast<Flags>(MX_DEFAULT | MX_ENABLE_POW | MX_ENABLE_MOD | MX_ENABLE_MATH);
+
+double x = 1.5;
+double y = -2.25;
+
+// Checks that expression parsed at compile time evaluates to exactly the same value as parsed at runtime.
+template <mathex::detail::FixedString Expression, Flags ExpressionFlags = AllFlags>
+static void expect_same() {
+    mx_config *config = mx_create(static_cast<mx_flag>(ExpressionFlags));
+    cr_assert(config != NULL);
+    mx_add_variable(config, "x", &x);
+    mx_add_variable(config, "y", &y);
+
+    double expected;
+    cr_assert(mx_evaluate(config, Expression.data, &expected) == MX_SUCCESS, "%s", Expression.data);
+
+    double actual = StaticExpression<Expression, ExpressionFlags>::evaluate(bind<"x">(x), bind<"y">(y));
+    cr_expect(std::memcmp(&actual, &expected, sizeof(double)) == 0, "%s: %.17g != %.17g", Expression.data, actual, expected);
+
+    mx_free(config);
+}
+
+// Returns error of parsing expression at compile time, which fails to compile if it is not a success.
+template <mathex::detail::FixedString Expression, Flags ExpressionFlags = AllFlags>
+constexpr mathex::Error static_error() {
+    return mathex::detail::parseStatic(Expression, ExpressionFlags).error;
+}
+
+Test(mx_static, number_literals) {
+    expect_same<"0.1">();
+    expect_same<"3.14159265358979323846264338327950288">();
+    expect_same<"123456789012345678901234567890">();
+    expect_same<"9007199254740993">();
+    expect_same<"1.00000000000000011102230246251565404236316680908203125">();
+    expect_same<"1.00000000000000011102230246251565404236316680908203126">();
+    expect_same<"1.7976931348623157e308">();
+    expect_same<"1.7976931348623159e308">();
+    expect_same<"2.2250738585072011e-308">();
+    expect_same<"4.9406564584124654e-324">();
+    expect_same<"2.4703282292062327e-324">();
+    expect_same<"2.4703282292062328e-324">();
+    expect_same<"1e-400 + 1e400">();
+    expect_same<".5e1 + 5. + 0.000001E+6">();
+}
+
+Test(mx_static, operators) {
+    expect_same<"-2^2">();
+    expect_same<"2^3^2">();
+    expect_same<"1 + 2 * 3 - 4 / 5">();
+    expect_same<"x - y % 2 * 3">();
+    expect_same<"-x^y + y">();
+    expect_same<"(x + y) * (x - y) / 7">();
+}
+
+Test(mx_static, functions) {
+    expect_same<"min(x, y, 3)">();
+    expect_same<"max(1, min(x, 2, y), 3, -4)">();
+    expect_same<"sin(x) + cos(y) * exp(-x) - log(x) / sqrt(abs(y))">();
+    expect_same<"floor(y) + ceil(x) + max(x)">();
+}
+
+Test(mx_static, implicit_rules) {
+    expect_same<"2x - 0.5y">();
+    expect_same<"2 * (x + y">();
+    expect_same<"x + y) * 2">();
+    expect_same<"sqrt(abs(y * (x + 1">();
+}
+
+Test(mx_static, bindings) {
+    // Bindings are matched by name, in any order and of any arithmetic type
+    static_assert(StaticExpression<"x * y + 2">::evaluate(bind<"y">(4), bind<"x">(3.0f), bind<"z">(1)) == 14);
+
+    constexpr StaticExpression<"speed * time", mathex::DefaultFlags> distance;
+    double value = distance(bind<"time">(2.5), bind<"speed">(x));
+    cr_expect(value == x * 2.5);
+
+    // Built-in functions are variables if they are not enabled
+    value = StaticExpression<"sin + 1", mathex::DefaultFlags>::evaluate(bind<"sin">(y));
+    cr_expect(value == y + 1);
+}
+
+Test(mx_static, rejected_expressions) {
+    // Each of these would fail to compile as `StaticExpression`
+    static_assert(static_error<"x +">() == mathex::Error::SyntaxError);
+    static_assert(static_error<"(x + y)(x)">() == mathex::Error::SyntaxError);
+    static_assert(static_error<"1..2">() == mathex::Error::SyntaxError);
+    static_assert(static_error<"x - -y">() == mathex::Error::SyntaxError);
+    static_assert(static_error<"x * (y", mathex::Flags::Multiplication>() == mathex::Error::SyntaxError);
+    static_assert(static_error<"sin(x, y)">() == mathex::Error::IncorrectArgsNum);
+    static_assert(static_error<"max()">() == mathex::Error::IncorrectArgsNum);
+    static_assert(static_error<"x ^ y", mathex::DefaultFlags>() == mathex::Error::SyntaxError);
+}
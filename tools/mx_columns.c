@@ -0,0 +1,175 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+// Required for `getopt` in strict C99 mode
+#define _DEFAULT_SOURCE
+
+#include <mathex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Evaluates an expression over files of raw little-endian `double` values, one file per variable,
+// and writes results to a file of the same format. Files are memory-mapped and never copied.
+
+#define USAGE                                                                                         \
+    "usage: mx_columns [options] -o output expression name=file...\n"                                 \
+    "\n"                                                                                              \
+    "Evaluates the expression for every row of column files and writes results to the output file.\n" \
+    "Each column file holds raw little-endian doubles, one for each row, and is named after the\n"    \
+    "variable it holds values of. Every column file has to have the same number of rows.\n"           \
+    "\n"                                                                                              \
+    "options:\n"                                                                                      \
+    "  -o file     write results to file, replacing its contents\n"                                   \
+    "  -j threads  number of threads, 0 for one per processor (default 0)\n"
+
+static const char *error_descriptions[] = {
+    [MX_SUCCESS] = "success",
+    [MX_ERR_ILLEGAL_NAME] = "illegal name",
+    [MX_ERR_ALREADY_DEF] = "already defined",
+    [MX_ERR_NO_MEMORY] = "out of memory",
+    [MX_ERR_DIV_ZERO] = "division by zero",
+    [MX_ERR_SYNTAX] = "syntax error",
+    [MX_ERR_UNDEFINED] = "undefined name",
+    [MX_ERR_INVALID_ARGS] = "invalid column files",
+    [MX_ERR_ARGS_NUM] = "wrong number of arguments",
+    [MX_ERR_NOT_SUPPORTED] = "not supported",
+    [MX_ERR_FROZEN] = "config is frozen",
+    [MX_ERR_IO] = "cannot read or write file",
+    [MX_ERR_CYCLE] = "cyclic formulas",
+};
+
+static const char *describe_error(mx_error error_code) {
+    if ((size_t)error_code < sizeof(error_descriptions) / sizeof(*error_descriptions) && error_descriptions[error_code] != NULL) {
+        return error_descriptions[error_code];
+    }
+
+    return "unknown error";
+}
+
+int main(int argc, char **argv) {
+    const char *output = NULL;
+    unsigned long n_threads = 0;
+    int option;
+
+    while ((option = getopt(argc, argv, "o:j:h")) != -1) {
+        switch (option) {
+        case 'o': {
+            output = optarg;
+        } break;
+
+        case 'j': {
+            char *end;
+            n_threads = strtoul(optarg, &end, 10);
+
+            if (*optarg == '\0' || *optarg == '-' || *end != '\0') {
+                fprintf(stderr, "mx_columns: invalid number of threads: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+        } break;
+
+        case 'h': {
+            fputs(USAGE, stdout);
+            return EXIT_SUCCESS;
+        }
+
+        default: {
+            fputs(USAGE, stderr);
+            return EXIT_FAILURE;
+        }
+        }
+    }
+
+    if (output == NULL || argc - optind < 2) {
+        fputs(USAGE, stderr);
+        return EXIT_FAILURE;
+    }
+
+    const char *expression = argv[optind];
+    size_t n_files = (size_t)(argc - optind - 1);
+    mx_column_file *files = malloc(sizeof(mx_column_file) * n_files);
+    mx_config *config = mx_create(MX_DEFAULT | MX_ENABLE_POW | MX_ENABLE_MOD);
+    mx_program *program = NULL;
+    mx_pool *pool = NULL;
+    mx_error error_code;
+    int exit_code = EXIT_FAILURE;
+
+    if (files == NULL || config == NULL) {
+        fprintf(stderr, "mx_columns: out of memory\n");
+        goto cleanup;
+    }
+
+    // Variables are read from the frame, so that they have no value outside of their files
+    for (size_t i = 0; i < n_files; i++) {
+        char *argument = argv[optind + 1 + (int)i];
+        char *separator = strchr(argument, '=');
+
+        if (separator == NULL) {
+            fprintf(stderr, "mx_columns: expected `name=file`: %s\n", argument);
+            goto cleanup;
+        }
+
+        *separator = '\0';
+        files[i].name = argument;
+        files[i].path = separator + 1;
+
+        if ((error_code = mx_add_frame_variable(config, files[i].name, i)) != MX_SUCCESS) {
+            fprintf(stderr, "mx_columns: %s: %s\n", files[i].name, describe_error(error_code));
+            goto cleanup;
+        }
+    }
+
+    if ((error_code = mx_compile(config, expression, &program)) != MX_SUCCESS) {
+        fprintf(stderr, "mx_columns: %s\n", describe_error(error_code));
+        goto cleanup;
+    }
+
+    if ((pool = mx_pool_create((size_t)n_threads)) == NULL) {
+        fprintf(stderr, "mx_columns: out of memory\n");
+        goto cleanup;
+    }
+
+    if ((error_code = mx_program_eval_files(program, pool, files, n_files, output)) != MX_SUCCESS) {
+        fprintf(stderr, "mx_columns: %s\n", describe_error(error_code));
+        goto cleanup;
+    }
+
+    exit_code = EXIT_SUCCESS;
+
+cleanup:
+    if (pool != NULL) {
+        mx_pool_free(pool);
+    }
+
+    if (program != NULL) {
+        mx_program_free(program);
+    }
+
+    if (config != NULL) {
+        mx_free(config);
+    }
+
+    free(files);
+
+    return exit_code;
+}
@@ -0,0 +1,587 @@
+/*
+  Copyright (c) 2023 Caps Lock
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in
+  all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+  THE SOFTWARE.
+*/
+
+// Required for `mmap`, `madvise` and `getopt` in strict C99 mode
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <mathex.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Evaluates expressions from a file, one per line, and writes their results in the same order.
+// Input is memory-mapped if possible, otherwise it is read in large blocks. Lines are evaluated right
+// where they are stored, split into batches which are evaluated and formatted by multiple threads.
+
+#define USAGE                                                                                          \
+    "usage: mx_eval [options] [input]\n"                                                               \
+    "\n"                                                                                               \
+    "Evaluates expressions from the input file, one per line, and writes their results in the\n"       \
+    "same order. Reads standard input if no file is given. Lines that failed to evaluate are\n"        \
+    "written as `error <code>: <description>` and do not stop the evaluation.\n"                       \
+    "\n"                                                                                               \
+    "options:\n"                                                                                       \
+    "  -d file     load constants and variables from definitions file\n"                               \
+    "  -o file     write results to file instead of standard output\n"                                 \
+    "  -j threads  number of threads, 0 for one per processor (default 0)\n"                           \
+    "  -b lines    number of lines evaluated at once (default 65536)\n"                                \
+    "  -p digits   number of significant digits of results (default 17)\n"                             \
+    "\n"                                                                                               \
+    "Each line of definitions file is `name = expression` for a constant or `var name = expression`\n" \
+    "for a variable. Expressions can use definitions above them. Empty lines and lines starting\n"     \
+    "with `#` are ignored.\n"
+
+// Size of the first block read from streams that cannot be memory-mapped. Grows to fit the longest line.
+#define BLOCK_SIZE (16 * 1024 * 1024)
+
+// Maximum number of characters written for a single result, including newline.
+#define MAX_RESULT_LENGTH 64
+
+static const char *error_descriptions[] = {
+    [MX_SUCCESS] = "success",
+    [MX_ERR_ILLEGAL_NAME] = "illegal name",
+    [MX_ERR_ALREADY_DEF] = "already defined",
+    [MX_ERR_NO_MEMORY] = "out of memory",
+    [MX_ERR_DIV_ZERO] = "division by zero",
+    [MX_ERR_SYNTAX] = "syntax error",
+    [MX_ERR_UNDEFINED] = "undefined name",
+    [MX_ERR_INVALID_ARGS] = "invalid arguments",
+    [MX_ERR_ARGS_NUM] = "wrong number of arguments",
+    [MX_ERR_NOT_SUPPORTED] = "not supported",
+    [MX_ERR_FROZEN] = "config is frozen",
+    [MX_ERR_IO] = "input or output error",
+    [MX_ERR_CYCLE] = "cyclic formulas",
+};
+
+static const char *describe_error(mx_error error_code) {
+    if ((size_t)error_code < sizeof(error_descriptions) / sizeof(*error_descriptions) && error_descriptions[error_code] != NULL) {
+        return error_descriptions[error_code];
+    }
+
+    return "unknown error";
+}
+
+typedef struct line {
+    const char *text;
+    size_t length;
+} line;
+
+typedef struct input {
+    FILE *file; // stream to read from, or NULL if the whole input is memory-mapped
+    char *data;
+    size_t length;
+    size_t position; // start of the first line that was not returned yet
+    size_t capacity;
+    bool eof;
+} input;
+
+// Thread evaluating a contiguous part of the batch.
+typedef struct worker {
+    pthread_t thread;
+    const mx_config *config;
+    mx_workspace *workspace;
+    int precision;
+
+    const line *lines;
+    size_t n_lines;
+
+    char *output; // formatted results of the lines
+    size_t length;
+    size_t capacity;
+    size_t errors;
+    bool failed; // ran out of memory for the output
+} worker;
+
+static bool open_input(input *in, const char *path) {
+    memset(in, 0, sizeof(input));
+
+    if (path != NULL) {
+        int fd = open(path, O_RDONLY);
+        struct stat info;
+
+        if (fd < 0) {
+            return false;
+        }
+
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (data != MAP_FAILED) {
+                // Pages are read once from start to end, so they can be read ahead and dropped early
+                madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+                close(fd);
+
+                in->data = data;
+                in->length = (size_t)info.st_size;
+                in->eof = true;
+                return true;
+            }
+        }
+
+        in->file = fdopen(fd, "rb");
+
+        if (in->file == NULL) {
+            close(fd);
+            return false;
+        }
+    } else {
+        in->file = stdin;
+    }
+
+    in->capacity = BLOCK_SIZE;
+    in->data = malloc(in->capacity);
+
+    return in->data != NULL;
+}
+
+static void close_input(input *in) {
+    if (in->file == NULL) {
+        munmap(in->data, in->length);
+        return;
+    }
+
+    if (in->file != stdin) {
+        fclose(in->file);
+    }
+
+    free(in->data);
+}
+
+// Moves unfinished line to the start of the buffer and reads next block after it.
+static bool refill_input(input *in) {
+    memmove(in->data, in->data + in->position, in->length - in->position);
+    in->length -= in->position;
+    in->position = 0;
+
+    if (in->length == in->capacity) {
+        char *data = realloc(in->data, 2 * in->capacity);
+
+        if (data == NULL) {
+            return false;
+        }
+
+        in->data = data;
+        in->capacity *= 2;
+    }
+
+    size_t n_read = fread(in->data + in->length, 1, in->capacity - in->length, in->file);
+    in->length += n_read;
+
+    if (n_read == 0) {
+        in->eof = true;
+        return !ferror(in->file);
+    }
+
+    return true;
+}
+
+// Splits up to `max_lines` next lines of the input. Lines stay valid until the next call.
+// Returns number of lines, which is zero at the end of the input, or SIZE_MAX if reading failed.
+static size_t read_lines(input *in, line lines[], size_t max_lines) {
+    size_t n_lines = 0;
+
+    while (n_lines < max_lines) {
+        const char *start = in->data + in->position;
+        const char *newline = in->length > in->position ? memchr(start, '\n', in->length - in->position) : NULL;
+        size_t length;
+
+        if (newline != NULL) {
+            length = (size_t)(newline - start);
+            in->position += length + 1;
+        } else if (in->eof) {
+            if (in->position == in->length) {
+                break;
+            }
+
+            // Last line without newline
+            length = in->length - in->position;
+            in->position = in->length;
+        } else if (n_lines > 0) {
+            // Reading would move lines that were already returned
+            break;
+        } else {
+            if (!refill_input(in)) {
+                return SIZE_MAX;
+            }
+
+            continue;
+        }
+
+        if (length > 0 && start[length - 1] == '\r') {
+            length--;
+        }
+
+        lines[n_lines].text = start;
+        lines[n_lines].length = length;
+        n_lines++;
+    }
+
+    return n_lines;
+}
+
+static void *evaluate_lines(void *argument) {
+    worker *self = argument;
+    size_t required = self->n_lines * MAX_RESULT_LENGTH;
+
+    self->length = 0;
+    self->errors = 0;
+
+    if (required > self->capacity) {
+        char *output = realloc(self->output, required);
+
+        if (output == NULL) {
+            self->failed = true;
+            return NULL;
+        }
+
+        self->output = output;
+        self->capacity = required;
+    }
+
+    for (size_t i = 0; i < self->n_lines; i++) {
+        char *text = self->output + self->length;
+        int written;
+
+        if (self->lines[i].length == 0) {
+            // Empty lines are kept, so that results stay aligned with input
+            written = snprintf(text, MAX_RESULT_LENGTH, "\n");
+        } else {
+            double result;
+            mx_error error_code = mx_evaluate_ws_n(self->config, self->workspace, self->lines[i].text, self->lines[i].length, &result);
+
+            if (error_code == MX_SUCCESS) {
+                written = snprintf(text, MAX_RESULT_LENGTH, "%.*g\n", self->precision, result);
+            } else {
+                written = snprintf(text, MAX_RESULT_LENGTH, "error %d: %s\n", (int)error_code, describe_error(error_code));
+                self->errors++;
+            }
+        }
+
+        self->length += (size_t)written;
+    }
+
+    return NULL;
+}
+
+// Removes whitespace at both ends of the string in place.
+static char *trim(char *string) {
+    while (*string == ' ' || *string == '\t') {
+        string++;
+    }
+
+    size_t length = strlen(string);
+
+    while (length > 0 && strchr(" \t\r\n", string[length - 1]) != NULL) {
+        string[--length] = '\0';
+    }
+
+    return string;
+}
+
+// Storage of values of variables loaded from definitions.
+typedef struct variables {
+    double **values;
+    size_t count;
+} variables;
+
+static bool load_definitions(mx_config *config, variables *vars, const char *path) {
+    FILE *file = fopen(path, "r");
+    char buffer[4096];
+    size_t line_number = 0;
+
+    if (file == NULL) {
+        fprintf(stderr, "mx_eval: cannot open %s\n", path);
+        return false;
+    }
+
+    while (fgets(buffer, sizeof(buffer), file) != NULL) {
+        char *definition = trim(buffer);
+        char *separator = strchr(definition, '=');
+        bool variable = strncmp(definition, "var ", 4) == 0 || strncmp(definition, "var\t", 4) == 0;
+        double value;
+        mx_error error_code;
+
+        line_number++;
+
+        if (*definition == '\0' || *definition == '#') {
+            continue;
+        }
+
+        if (separator == NULL) {
+            fprintf(stderr, "mx_eval: %s:%zu: expected `name = expression`\n", path, line_number);
+            fclose(file);
+            return false;
+        }
+
+        *separator = '\0';
+        char *name = trim(variable ? definition + 4 : definition);
+        char *expression = trim(separator + 1);
+
+        error_code = mx_evaluate(config, expression, &value);
+
+        if (error_code == MX_SUCCESS && variable) {
+            double **values = realloc(vars->values, sizeof(double *) * (vars->count + 1));
+            double *storage = malloc(sizeof(double));
+
+            if (values != NULL) {
+                vars->values = values;
+            }
+
+            if (values == NULL || storage == NULL) {
+                free(storage);
+                error_code = MX_ERR_NO_MEMORY;
+            } else {
+                *storage = value;
+                vars->values[vars->count++] = storage;
+                error_code = mx_add_variable(config, name, storage);
+            }
+        } else if (error_code == MX_SUCCESS) {
+            error_code = mx_add_constant(config, name, value);
+        }
+
+        if (error_code != MX_SUCCESS) {
+            fprintf(stderr, "mx_eval: %s:%zu: %s: %s\n", path, line_number, name, describe_error(error_code));
+            fclose(file);
+            return false;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool parse_count(const char *text, size_t *count) {
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+
+    if (*text == '\0' || *end != '\0' || *text == '-') {
+        return false;
+    }
+
+    *count = (size_t)value;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const char *definitions = NULL;
+    const char *output_path = NULL;
+    size_t n_threads = 0;
+    size_t batch_size = 65536;
+    size_t precision = 17;
+    int option;
+
+    while ((option = getopt(argc, argv, "d:o:j:b:p:h")) != -1) {
+        switch (option) {
+        case 'd': {
+            definitions = optarg;
+        } break;
+
+        case 'o': {
+            output_path = optarg;
+        } break;
+
+        case 'j': {
+            if (!parse_count(optarg, &n_threads)) {
+                fprintf(stderr, "mx_eval: invalid number of threads: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+        } break;
+
+        case 'b': {
+            if (!parse_count(optarg, &batch_size) || batch_size == 0) {
+                fprintf(stderr, "mx_eval: invalid batch size: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+        } break;
+
+        case 'p': {
+            if (!parse_count(optarg, &precision) || precision == 0 || precision > 17) {
+                fprintf(stderr, "mx_eval: precision has to be between 1 and 17: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+        } break;
+
+        case 'h': {
+            fputs(USAGE, stdout);
+            return EXIT_SUCCESS;
+        }
+
+        default: {
+            fputs(USAGE, stderr);
+            return EXIT_FAILURE;
+        }
+        }
+    }
+
+    if (argc - optind > 1) {
+        fputs(USAGE, stderr);
+        return EXIT_FAILURE;
+    }
+
+    if (n_threads == 0) {
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = count > 0 ? (size_t)count : 1;
+    }
+
+    int exit_code = EXIT_SUCCESS;
+    mx_config *config = mx_create(MX_DEFAULT | MX_ENABLE_POW | MX_ENABLE_MOD);
+    variables vars = {.values = NULL, .count = 0};
+    worker *workers = calloc(n_threads, sizeof(worker));
+    line *lines = malloc(sizeof(line) * batch_size);
+    FILE *output = output_path != NULL ? fopen(output_path, "w") : stdout;
+    input in;
+    bool opened = false;
+    size_t n_lines, total_lines = 0, total_errors = 0;
+
+    if (config == NULL || workers == NULL || lines == NULL) {
+        fprintf(stderr, "mx_eval: out of memory\n");
+        exit_code = EXIT_FAILURE;
+        goto cleanup;
+    }
+
+    if (output == NULL) {
+        fprintf(stderr, "mx_eval: cannot open %s\n", output_path);
+        exit_code = EXIT_FAILURE;
+        goto cleanup;
+    }
+
+    if (definitions != NULL && !load_definitions(config, &vars, definitions)) {
+        exit_code = EXIT_FAILURE;
+        goto cleanup;
+    }
+
+    if (!(opened = open_input(&in, optind < argc ? argv[optind] : NULL))) {
+        fprintf(stderr, "mx_eval: cannot read %s\n", optind < argc ? argv[optind] : "standard input");
+        exit_code = EXIT_FAILURE;
+        goto cleanup;
+    }
+
+    // Config is only read from now on, so it can be shared by all threads
+    mx_freeze(config);
+    setvbuf(output, NULL, _IOFBF, 1 << 20);
+
+    for (size_t i = 0; i < n_threads; i++) {
+        workers[i].config = config;
+        workers[i].precision = (int)precision;
+        workers[i].workspace = mx_workspace_create();
+
+        if (workers[i].workspace == NULL) {
+            fprintf(stderr, "mx_eval: out of memory\n");
+            exit_code = EXIT_FAILURE;
+            goto cleanup;
+        }
+    }
+
+    while ((n_lines = read_lines(&in, lines, batch_size)) > 0) {
+        if (n_lines == SIZE_MAX) {
+            fprintf(stderr, "mx_eval: failed to read input\n");
+            exit_code = EXIT_FAILURE;
+            goto cleanup;
+        }
+
+        size_t n_workers = n_lines < n_threads ? n_lines : n_threads;
+
+        for (size_t i = 0; i < n_workers; i++) {
+            size_t begin = i * n_lines / n_workers;
+            size_t end = (i + 1) * n_lines / n_workers;
+
+            workers[i].lines = lines + begin;
+            workers[i].n_lines = end - begin;
+        }
+
+        // Calling thread evaluates the first part itself, and any part whose thread failed to start
+        size_t started = 1;
+
+        while (started < n_workers && pthread_create(&workers[started].thread, NULL, evaluate_lines, &workers[started]) == 0) {
+            started++;
+        }
+
+        for (size_t i = started; i < n_workers; i++) {
+            evaluate_lines(&workers[i]);
+        }
+
+        evaluate_lines(&workers[0]);
+
+        for (size_t i = 1; i < started; i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+
+        for (size_t i = 0; i < n_workers; i++) {
+            if (workers[i].failed) {
+                fprintf(stderr, "mx_eval: out of memory\n");
+                exit_code = EXIT_FAILURE;
+                goto cleanup;
+            }
+
+            fwrite(workers[i].output, 1, workers[i].length, output);
+            total_errors += workers[i].errors;
+        }
+
+        total_lines += n_lines;
+    }
+
+    if (fflush(output) != 0 || ferror(output)) {
+        fprintf(stderr, "mx_eval: failed to write output\n");
+        exit_code = EXIT_FAILURE;
+    } else if (total_errors > 0) {
+        fprintf(stderr, "mx_eval: %zu of %zu lines failed\n", total_errors, total_lines);
+        exit_code = EXIT_FAILURE;
+    }
+
+cleanup:
+    if (opened) {
+        close_input(&in);
+    }
+
+    if (output != NULL && output != stdout) {
+        fclose(output);
+    }
+
+    for (size_t i = 0; workers != NULL && i < n_threads; i++) {
+        if (workers[i].workspace != NULL) {
+            mx_workspace_free(workers[i].workspace);
+        }
+
+        free(workers[i].output);
+    }
+
+    for (size_t i = 0; i < vars.count; i++) {
+        free(vars.values[i]);
+    }
+
+    if (config != NULL) {
+        mx_free(config);
+    }
+
+    free(vars.values);
+    free(workers);
+    free(lines);
+
+    return exit_code;
+}